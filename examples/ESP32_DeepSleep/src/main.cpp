@@ -0,0 +1,72 @@
+/**
+ * @file main.cpp
+ * @brief Deep sleep sensor example for ESP32 with BThome V2
+ *
+ * This example wakes up every minute, reads a (simulated) temperature,
+ * advertises it encrypted in a short burst and goes back to deep sleep.
+ *
+ * The encryption counter and packet id are kept in RTC memory, so a wake-up
+ * needs no flash access. The packet is built and encrypted before the BLE
+ * stack starts, which keeps the radio on only for the burst itself.
+ *
+ * Hardware: ESP32 (any variant), e.g. on a coin cell
+ */
+
+#include <Arduino.h>
+#include <BThomeV2.h>
+#include <BtHomeSleep.h>
+#include <CounterStorage.h>
+
+const uint64_t SLEEP_US = 60ULL * 1000000ULL;  // 1 minute between readings
+const uint16_t BURST_EVENTS = 3;               // Advertising events per wake
+
+// Bind key as configured in Home Assistant (32 hex digits)
+const uint8_t KEY[BIND_KEY_LEN] = {0x23, 0x1d, 0x39, 0xc1, 0xd7, 0xcc,
+                                   0x1a, 0xb1, 0xae, 0xe2, 0x24, 0xcd,
+                                   0x09, 0x6d, 0xb9, 0x32};
+
+// Encoder state across deep sleep
+RTC_DATA_ATTR BtHomeRetainedState retained;
+
+// Counter blocks in NVS, only written after power loss or every 1024 packets
+NvsCounterStorage counterStorage;
+PersistentCounter counter(counterStorage);
+
+/// Bluetooth MAC without starting the BLE stack (base MAC + 2), least
+/// significant byte first as BtHomeV2Device expects it.
+static void readBluetoothMac(uint8_t mac[BLE_MAC_ADDRESS_LENGTH]) {
+  // getEfuseMac() holds the most significant byte (OUI) in its low byte
+  uint64_t efuse = ESP.getEfuseMac();
+  for (size_t i = 0; i < BLE_MAC_ADDRESS_LENGTH; i++) {
+    mac[5 - i] = (efuse >> (8 * i)) & 0xFF;
+  }
+  mac[0] += 2;
+}
+
+void setup() {
+  uint8_t mac[BLE_MAC_ADDRESS_LENGTH];
+  readBluetoothMac(mac);
+
+  BtHomeV2Device device("Sleepy", "ESP32-Sleepy", false, KEY, mac);
+  BtHomeSleepCycle cycle(retained);
+  cycle.restore(device, &counter);
+  device.setPacketIdEnabled(true);
+
+  // Read the sensor and build the packet while the radio is still off
+  float temperature = 20.0f + (esp_random() % 100) / 10.0f;
+  device.addTemperature_neg327_to_327_Resolution_0_01(temperature);
+  if (cycle.prepare(device) > 0 && BLE.begin()) {
+    ArduinoBleRadio radio;
+    if (cycle.startBurst(radio, millis(), BURST_EVENTS)) {
+      delay(cycle.remainingMs(millis()));
+      cycle.finish(radio);
+    }
+  }
+
+  esp_sleep_enable_timer_wakeup(SLEEP_US);
+  esp_deep_sleep_start();
+}
+
+void loop() {
+  // Not reached, every wake-up starts in setup()
+}
@@ -56,6 +56,9 @@ void setup() {
 }
 
 void loop() {
+  // Rotate advertisement frames if the measurements need more than one
+  bthome.poll();
+
   // Check if it's time to update
   if (millis() - lastUpdate >= UPDATE_INTERVAL) {
     updateSensors();
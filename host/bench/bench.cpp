@@ -0,0 +1,34 @@
+/**
+ * @file bench.cpp
+ * @brief Allocation counting for the host benchmarks.
+ */
+
+#include "bench.h"
+
+#include <new>
+
+static size_t allocations = 0;
+static volatile size_t sink = 0;
+
+size_t bench::allocationCount() { return allocations; }
+
+void bench::doNotOptimize(size_t value) { sink = value; }
+
+void* operator new(size_t size) {
+  allocations++;
+  void* memory = malloc(size ? size : 1);
+  if (!memory) {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+
+void operator delete(void* memory) noexcept { free(memory); }
+
+void operator delete[](void* memory) noexcept { free(memory); }
+
+void operator delete(void* memory, size_t) noexcept { free(memory); }
+
+void operator delete[](void* memory, size_t) noexcept { free(memory); }
@@ -0,0 +1,163 @@
+/**
+ * @file bench.h
+ * @brief Tiny timing harness shared by the host benchmarks.
+ *
+ * Every benchmark reports nanoseconds, CPU cycles (x86 time stamp counter, 0
+ * on other hosts) and heap allocations per operation, operations per second
+ * and the bytes produced per operation, printed as one JSON document so
+ * results can be diffed between commits.
+ */
+
+#ifndef BTHOME_BENCH_H
+#define BTHOME_BENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+/// Number of operator new calls since program start (see bench.cpp).
+size_t allocationCount();
+
+/// Keeps the optimizer from discarding a computed value.
+void doNotOptimize(size_t value);
+
+/// Time stamp counter, or 0 where the host has none.
+inline uint64_t cycleCount() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+struct Result {
+  std::string name;
+  size_t iterations;
+  double nsPerOp;
+  double cyclesPerOp;
+  double allocsPerOp;
+  size_t bytesPerOp;
+};
+
+class Suite {
+ public:
+  Suite(const char* name, int argc, char** argv) : _name(name) {
+    for (int i = 1; i + 1 < argc; i++) {
+      if (strcmp(argv[i], "--iterations") == 0) {
+        _iterations = strtoul(argv[i + 1], nullptr, 10);
+      }
+    }
+  }
+
+  /// @brief Times body, which returns the number of bytes it produced.
+  template <typename Body>
+  void run(const char* name, Body body) {
+    run(name, _iterations, body);
+  }
+
+  template <typename Body>
+  void run(const char* name, size_t iterations, Body body) {
+    size_t bytes = 0;
+    for (size_t i = 0; i < iterations / 10 + 1; i++) {
+      bytes = body();
+    }
+
+    size_t allocations = allocationCount();
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    uint64_t startCycles = cycleCount();
+    for (size_t i = 0; i < iterations; i++) {
+      bytes = body();
+      doNotOptimize(bytes);
+    }
+    uint64_t stopCycles = cycleCount();
+    std::chrono::steady_clock::time_point stop =
+        std::chrono::steady_clock::now();
+    allocations = allocationCount() - allocations;
+
+    record(name, iterations,
+           std::chrono::duration<double, std::nano>(stop - start).count(),
+           stopCycles - startCycles, allocations, bytes);
+  }
+
+  /// @brief Times body only, running setup untimed before every call (e.g.
+  /// to prepare state that an idle period would). Each call is timed on its
+  /// own, so results include a few ns of clock overhead.
+  template <typename Setup, typename Body>
+  void runWithSetup(const char* name, Setup setup, Body body) {
+    size_t bytes = 0;
+    for (size_t i = 0; i < _iterations / 10 + 1; i++) {
+      setup();
+      bytes = body();
+    }
+
+    double ns = 0;
+    uint64_t cycles = 0;
+    size_t allocations = 0;
+    for (size_t i = 0; i < _iterations; i++) {
+      setup();
+      size_t startAllocations = allocationCount();
+      std::chrono::steady_clock::time_point start =
+          std::chrono::steady_clock::now();
+      uint64_t startCycles = cycleCount();
+      bytes = body();
+      doNotOptimize(bytes);
+      uint64_t stopCycles = cycleCount();
+      std::chrono::steady_clock::time_point stop =
+          std::chrono::steady_clock::now();
+      ns += std::chrono::duration<double, std::nano>(stop - start).count();
+      cycles += stopCycles - startCycles;
+      allocations += allocationCount() - startAllocations;
+    }
+    record(name, _iterations, ns, cycles, allocations, bytes);
+  }
+
+  /// @brief Prints all results as JSON to stdout.
+  void print() const {
+    printf("{\"suite\": \"%s\", \"results\": [\n", _name);
+    for (size_t i = 0; i < _results.size(); i++) {
+      const Result& r = _results[i];
+      printf(
+          "  {\"name\": \"%s\", \"iterations\": %zu, \"ns_per_op\": %.2f, "
+          "\"cycles_per_op\": %.0f, \"ops_per_second\": %.0f, "
+          "\"allocs_per_op\": %.2f, \"bytes_per_op\": %zu}%s\n",
+          r.name.c_str(), r.iterations, r.nsPerOp, r.cyclesPerOp,
+          r.nsPerOp > 0 ? 1e9 / r.nsPerOp : 0.0, r.allocsPerOp, r.bytesPerOp,
+          i + 1 < _results.size() ? "," : "");
+    }
+    printf("]}\n");
+  }
+
+ private:
+  void record(const char* name, size_t iterations, double ns, uint64_t cycles,
+              size_t allocations, size_t bytes) {
+    Result result;
+    result.name = name;
+    result.iterations = iterations;
+    result.nsPerOp = ns / iterations;
+    result.cyclesPerOp = static_cast<double>(cycles) / iterations;
+    result.allocsPerOp = static_cast<double>(allocations) / iterations;
+    result.bytesPerOp = bytes;
+    _results.push_back(result);
+  }
+
+  const char* _name;
+  size_t _iterations = 200000;
+  std::vector<Result> _results;
+};
+
+}  // namespace bench
+
+#endif  // BTHOME_BENCH_H
@@ -0,0 +1,202 @@
+/**
+ * @file bench_batch.cpp
+ * @brief Host benchmarks and checks for the bulk service data decoder.
+ *
+ * An archive of encoded packets (small sensors, meters, text/command objects,
+ * encrypted and truncated packets) is decoded by BtHomeBatchDecoder and by
+ * the per-packet BtHomeServiceData iterator. Both must produce the same
+ * columns; any mismatch exits with status 1 before results are printed.
+ *
+ * Every case decodes one batch of 256 packets into per-id columns, so
+ * ops_per_second times 256 is packets per second; bytes_per_op is the
+ * service data decoded.
+ *
+ * Usage: bthome_bench_batch [--iterations N] > results.json
+ */
+
+#include <BaseDevice.h>
+#include <BtHomeBatchDecoder.h>
+#include <BtHomeDecoder.h>
+
+#include "bench.h"
+
+static const size_t BATCH_SIZE = 256;
+static const size_t BATCH_COUNT = 16;
+
+static bool failed = false;
+
+static void expect(bool condition, const char* name) {
+  if (!condition) {
+    fprintf(stderr, "batch mismatch: %s\n", name);
+    failed = true;
+  }
+}
+
+/// Service data of many packets, back to back.
+struct Archive {
+  std::vector<uint8_t> data;
+  std::vector<uint32_t> offsets;
+
+  size_t count() const { return offsets.size() - 1; }
+
+  void add(const uint8_t* serviceData, size_t length) {
+    data.insert(data.end(), serviceData, serviceData + length);
+    offsets.push_back(data.size());
+  }
+};
+
+static void addPacket(Archive& archive, uint32_t seed) {
+  ExtendedBaseDevice device("archive", "archive", false);
+  switch (seed % 8) {
+    case 0:
+    case 1:
+    case 2:
+      device.addFixedPoint(temperature_int16_scale_0_01,
+                           -1500 + static_cast<int32_t>(seed % 5000), 100);
+      device.addFixedPoint(humidity_uint16, 3000 + seed % 5000, 100);
+      device.addUnsignedInteger(battery_percentage, seed % 101);
+      break;
+    case 3:
+      device.addState(door, seed & 1);
+      device.addState(motion, (seed >> 1) & 1);
+      device.addState(dimmer, Dimmer_Event_Status_RotateLeft, seed % 8);
+      break;
+    case 4:
+      for (uint8_t phase = 0; phase < 3; phase++) {
+        device.addFixedPoint(voltage_0_1, 2300 + seed % 20, 10);
+        device.addSignedInteger(power_int32,
+                                -50000 + static_cast<int32_t>(seed % 100000));
+        device.addFixedPoint(energy_uint32, 4000000000u - seed, 1000);
+      }
+      device.addSignedInteger(count_int16, -static_cast<int32_t>(seed % 30000));
+      device.addFixedPoint(temperature_int8_scale_0_35, -700, 100);
+      break;
+    case 5: {
+      uint8_t text[] = {'o', 'k'};
+      device.addRaw(TEXT_OBJECT_ID, text, sizeof(text));
+      device.addUnsignedInteger(count_uint8, seed % 256);
+      device.addFixedPoint(pressure, 100000 + seed % 400, 100);
+      break;
+    }
+    case 6:
+      device.addUnsignedInteger(co2, 400 + seed % 2000);
+      device.addFixedPoint(illuminance, seed % 10000000, 100);
+      device.addSignedInteger(acceleration, seed % 60);
+      break;
+    default:
+      device.addUnsignedInteger(battery_percentage, seed % 101);
+      break;
+  }
+  uint8_t advertisement[MAX_EXTENDED_ADVERTISEMENT_SIZE];
+  size_t length = device.getAdvertisementData(advertisement);
+  BtHomeServiceData serviceData;
+  BtHomeServiceData::fromAdvertisement(advertisement, length, serviceData);
+  size_t size = serviceData.payloadLength() + 1;
+  const uint8_t* bytes = serviceData.payload() - 1;
+  if (seed % 97 == 0) {
+    size--;  // truncated last object
+  }
+  archive.add(bytes, size);
+  if (seed % 61 == 0) {
+    static const uint8_t encrypted[] = {0x41, 0xa4, 0x72, 0x66, 0xc9, 0x5f,
+                                        0x73, 0x00, 0x11, 0x22, 0x33, 0x78,
+                                        0x23, 0x72, 0x14};
+    archive.add(encrypted, sizeof(encrypted));
+  }
+}
+
+/// Reference: the per-packet iterator into the same column layout.
+struct ReferenceColumns {
+  std::vector<uint32_t> packets[256];
+  std::vector<int64_t> values[256];
+
+  void clear() {
+    for (size_t id = 0; id < 256; id++) {
+      packets[id].clear();
+      values[id].clear();
+    }
+  }
+
+  void decode(const Archive& archive, size_t first, size_t count) {
+    for (size_t packet = first; packet < first + count; packet++) {
+      BtHomeServiceData serviceData(
+          &archive.data[archive.offsets[packet]],
+          archive.offsets[packet + 1] - archive.offsets[packet]);
+      for (const BtHomeObject& object : serviceData) {
+        if (!object.isVariableLength()) {
+          packets[object.id].push_back(packet);
+          values[object.id].push_back(object.rawValue());
+        }
+      }
+    }
+  }
+};
+
+static void checkDecoder(const Archive& archive,
+                         const ReferenceColumns& reference) {
+  static BtHomeBatchDecoder decoder;
+  // Uneven batches so packets straddle flushes and batch ends
+  size_t first = 0;
+  while (first < archive.count()) {
+    size_t count = first % 3 == 0 ? 1 : 733;
+    count = first + count > archive.count() ? archive.count() - first : count;
+    decoder.decode(&archive.data[0], &archive.offsets[first], count, first);
+    first += count;
+  }
+  bool same = decoder.getPacketCount() == archive.count();
+  for (size_t id = 0; id < 256; id++) {
+    const BtHomeColumn& column = decoder.column(id);
+    same &= column.size() == reference.values[id].size();
+    for (size_t i = 0; same && i < column.size(); i++) {
+      same &= column.packets[i] == reference.packets[id][i] &&
+              column.rawValue(i) == reference.values[id][i];
+    }
+  }
+  expect(same, "columns");
+  expect(decoder.getSkippedCount() > 0 && decoder.getMalformedCount() > 0 &&
+             decoder.getVariableLengthCount() > 0,
+         "skipped, malformed and variable length packets counted");
+}
+
+int main(int argc, char** argv) {
+  Archive archive;
+  archive.offsets.push_back(0);
+  for (uint32_t seed = 0; archive.count() < BATCH_SIZE * BATCH_COUNT;
+       seed++) {
+    addPacket(archive, seed * 7919);
+  }
+  archive.offsets.resize(BATCH_SIZE * BATCH_COUNT + 1);
+
+  ReferenceColumns reference;
+  reference.decode(archive, 0, archive.count());
+  checkDecoder(archive, reference);
+  if (failed) {
+    return 1;
+  }
+
+  bench::Suite suite("batch", argc, argv);
+
+  size_t batch = 0;
+  auto batchBytes = [&](size_t first) {
+    return (size_t)(archive.offsets[first + BATCH_SIZE] -
+                    archive.offsets[first]);
+  };
+  suite.run("decode_256/iterator", [&]() {
+    size_t first = (batch++ % BATCH_COUNT) * BATCH_SIZE;
+    reference.clear();
+    reference.decode(archive, first, BATCH_SIZE);
+    return batchBytes(first);
+  });
+
+  static BtHomeBatchDecoder decoder;
+  suite.run("decode_256/batch", [&]() {
+    size_t first = (batch++ % BATCH_COUNT) * BATCH_SIZE;
+    decoder.clear();
+    decoder.decode(&archive.data[0], &archive.offsets[first], BATCH_SIZE,
+                   first);
+    return batchBytes(first);
+  });
+
+  suite.print();
+  return 0;
+}
@@ -0,0 +1,246 @@
+/**
+ * @file bench_crypto.cpp
+ * @brief Host benchmarks and reference checks for the AES-128-CCM backends.
+ *
+ * Before timing, SoftwareCcm is checked against the FIPS-197 AES-128 block
+ * vector, the encrypted example from the BTHome specification and a 40 byte
+ * multi-block vector computed with OpenSSL AES-128-ECB following RFC 3610.
+ * The same BTHome example is then run through BaseDevice to cover the nonce
+ * layout, and precomputed keystreams must give the same packets as the
+ * normal path. Any mismatch exits with status 1 before results are printed.
+ *
+ * The trigger/ cases measure the latency from a sensor event to an encrypted
+ * advertisement in the buffer, with and without precomputeEncryption() in
+ * the (untimed) idle period before the event.
+ *
+ * Usage: bthome_bench_crypto [--iterations N] > results.json
+ */
+
+#include <BaseDevice.h>
+#include <BtHomeV2Device.h>
+#include <CcmBackend.h>
+
+#include "bench.h"
+
+static const uint8_t KEY[CCM_KEY_LENGTH] = {0x23, 0x1d, 0x39, 0xc1, 0xd7, 0xcc,
+                                            0x1a, 0xb1, 0xae, 0xe2, 0x24, 0xcd,
+                                            0x09, 0x6d, 0xb9, 0x32};
+// BTHome example: MAC 54:48:E6:8F:80:A5, indicator 0x41, counter 0x33221100.
+static const uint8_t NONCE[CCM_NONCE_LENGTH] = {0x54, 0x48, 0xe6, 0x8f, 0x80,
+                                                0xa5, 0xd2, 0xfc, 0x41, 0x00,
+                                                0x11, 0x22, 0x33};
+// Temperature 25.06 °C and humidity 50.55 %.
+static const uint8_t PLAINTEXT[6] = {0x02, 0xca, 0x09, 0x03, 0xbf, 0x13};
+static const uint8_t CIPHERTEXT[6] = {0xa4, 0x72, 0x66, 0xc9, 0x5f, 0x73};
+static const uint8_t TAG[CCM_TAG_LENGTH] = {0x78, 0x23, 0x72, 0x14};
+
+static bool failed = false;
+
+static void expect(const char* name, const uint8_t* actual,
+                   const uint8_t* expected, size_t length) {
+  if (memcmp(actual, expected, length) != 0) {
+    fprintf(stderr, "reference mismatch: %s\n", name);
+    failed = true;
+  }
+}
+
+static void checkAesBlock() {
+  static const uint8_t key[CCM_KEY_LENGTH] = {
+      0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+      0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f};
+  static const uint8_t input[AES_BLOCK_SIZE] = {
+      0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+      0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff};
+  static const uint8_t expected[AES_BLOCK_SIZE] = {
+      0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30,
+      0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a};
+  SoftwareCcm aes;
+  aes.setKey(key);
+  uint8_t output[AES_BLOCK_SIZE];
+  aes.encryptBlock(input, output);
+  expect("FIPS-197 AES-128", output, expected, AES_BLOCK_SIZE);
+}
+
+static void checkBtHomeExample() {
+  SoftwareCcm ccm;
+  ccm.setKey(KEY);
+  uint8_t ciphertext[sizeof(PLAINTEXT)];
+  uint8_t tag[CCM_TAG_LENGTH];
+  ccm.encrypt(NONCE, PLAINTEXT, sizeof(PLAINTEXT), ciphertext, tag);
+  expect("BTHome ciphertext", ciphertext, CIPHERTEXT, sizeof(CIPHERTEXT));
+  expect("BTHome MIC", tag, TAG, CCM_TAG_LENGTH);
+
+  // In place, as the radio buffers are reused
+  memcpy(ciphertext, PLAINTEXT, sizeof(PLAINTEXT));
+  ccm.encrypt(NONCE, ciphertext, sizeof(ciphertext), ciphertext, tag);
+  expect("BTHome in place", ciphertext, CIPHERTEXT, sizeof(CIPHERTEXT));
+}
+
+static void checkMultiBlock() {
+  // Indicator 0x45: encrypted trigger device
+  static const uint8_t nonce[CCM_NONCE_LENGTH] = {0x54, 0x48, 0xe6, 0x8f, 0x80,
+                                                  0xa5, 0xd2, 0xfc, 0x45, 0x00,
+                                                  0x11, 0x22, 0x33};
+  static const uint8_t expected[40] = {
+      0x55, 0x15, 0xc2, 0x1d, 0xad, 0x90, 0xe0, 0x2e, 0xe2, 0xf1,
+      0xb9, 0xe2, 0xa9, 0x3e, 0x53, 0x43, 0x07, 0x2a, 0x93, 0x57,
+      0x41, 0x62, 0x8e, 0x14, 0xc9, 0xb7, 0xdd, 0x5a, 0xe4, 0x0e,
+      0xdf, 0x0e, 0x49, 0x4a, 0xa9, 0xbb, 0x0d, 0x0c, 0xc9, 0x3e};
+  static const uint8_t expectedTag[CCM_TAG_LENGTH] = {0x0f, 0xa5, 0xca, 0xed};
+  uint8_t plaintext[sizeof(expected)];
+  for (uint8_t i = 0; i < sizeof(plaintext); i++) {
+    plaintext[i] = i;
+  }
+  SoftwareCcm ccm;
+  ccm.setKey(KEY);
+  uint8_t ciphertext[sizeof(expected)];
+  uint8_t tag[CCM_TAG_LENGTH];
+  ccm.encrypt(nonce, plaintext, sizeof(plaintext), ciphertext, tag);
+  expect("40 byte ciphertext", ciphertext, expected, sizeof(expected));
+  expect("40 byte MIC", tag, expectedTag, CCM_TAG_LENGTH);
+}
+
+static void checkBaseDevice() {
+  // BaseDevice takes the MAC least significant byte first
+  static const uint8_t mac[BLE_MAC_ADDRESS_LENGTH] = {0xa5, 0x80, 0x8f,
+                                                      0xe6, 0x48, 0x54};
+  uint32_t counter;
+  memcpy(&counter, &NONCE[9], COUNTER_LEN);
+  BaseDevice device("bench", "bench", false, KEY, mac, counter);
+  uint8_t output[sizeof(PLAINTEXT) + ENCRYPTION_TRAILER_SIZE];
+  size_t length =
+      device.encryptMeasurements(PLAINTEXT, sizeof(PLAINTEXT), output);
+  uint8_t expected[sizeof(output)];
+  memcpy(expected, CIPHERTEXT, sizeof(CIPHERTEXT));
+  memcpy(&expected[sizeof(CIPHERTEXT)], &NONCE[9], COUNTER_LEN);
+  memcpy(&expected[sizeof(CIPHERTEXT) + COUNTER_LEN], TAG, MIC_LEN);
+  if (length != sizeof(output)) {
+    fprintf(stderr, "reference mismatch: BaseDevice length\n");
+    failed = true;
+  }
+  expect("BaseDevice payload", output, expected, sizeof(output));
+}
+
+static void setDoor(BtHomeV2Device& device, bool open) {
+  device.clearMeasurementData();
+  device.setDoorState(open ? Door_Sensor_Status_Open
+                           : Door_Sensor_Status_Closed);
+  device.addBatteryPercentage(87);
+}
+
+static void checkPrecomputed() {
+  BtHomeV2Device normal("bench", "bench", true, KEY, NONCE);
+  BtHomeV2Device precomputed("bench", "bench", true, KEY, NONCE);
+  uint8_t expected[MAX_ADVERTISEMENT_SIZE];
+  uint8_t actual[MAX_ADVERTISEMENT_SIZE];
+  for (uint8_t i = 0; i < 4; i++) {
+    setDoor(normal, i & 1);
+    setDoor(precomputed, i & 1);
+    // The last round precomputes for a shorter packet and falls back
+    if (i == 3) {
+      precomputed.clearMeasurementData();
+    }
+    precomputed.precomputeEncryption();
+    setDoor(precomputed, i & 1);
+    size_t length = normal.getAdvertisementData(expected);
+    if (precomputed.getAdvertisementData(actual) != length ||
+        memcmp(actual, expected, length) != 0) {
+      fprintf(stderr, "reference mismatch: precomputed packet %u\n", i);
+      failed = true;
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  checkAesBlock();
+  checkBtHomeExample();
+  checkMultiBlock();
+  checkBaseDevice();
+  checkPrecomputed();
+  if (failed) {
+    return 1;
+  }
+
+  bench::Suite suite("crypto", argc, argv);
+  static uint32_t tick = 0;
+
+  SoftwareCcm software;
+  suite.run("software/set_key", [&]() {
+    software.setKey(KEY);
+    return (size_t)CCM_KEY_LENGTH;
+  });
+
+  uint8_t block[AES_BLOCK_SIZE] = {0};
+  suite.run("software/aes_block", [&]() {
+    software.encryptBlock(block, block);
+    return (size_t)AES_BLOCK_SIZE;
+  });
+
+  // Payloads of a small legacy packet, a full legacy packet and a full
+  // extended packet
+  static const size_t LEGACY_PAYLOAD =
+      MAX_ADVERTISEMENT_SIZE - MEASUREMENT_OFFSET - ENCRYPTION_TRAILER_SIZE;
+  static const size_t EXTENDED_PAYLOAD = MAX_EXTENDED_ADVERTISEMENT_SIZE -
+                                         MEASUREMENT_OFFSET -
+                                         ENCRYPTION_TRAILER_SIZE;
+  static const size_t LENGTHS[] = {sizeof(PLAINTEXT), LEGACY_PAYLOAD,
+                                   EXTENDED_PAYLOAD};
+  static const char* NAMES[] = {"software/packet_6_bytes",
+                                "software/packet_15_bytes",
+                                "software/packet_239_bytes"};
+  uint8_t payload[MAX_EXTENDED_ADVERTISEMENT_SIZE] = {0};
+  uint8_t nonce[CCM_NONCE_LENGTH];
+  memcpy(nonce, NONCE, sizeof(nonce));
+  uint8_t tag[CCM_TAG_LENGTH];
+  for (size_t i = 0; i < sizeof(LENGTHS) / sizeof(LENGTHS[0]); i++) {
+    size_t length = LENGTHS[i];
+    suite.run(NAMES[i], [&]() {
+      tick++;
+      memcpy(&nonce[9], &tick, COUNTER_LEN);
+      payload[0] = tick;
+      software.encrypt(nonce, payload, length, payload, tag);
+      return length + CCM_TAG_LENGTH;
+    });
+  }
+
+  uint8_t state[AES_BLOCK_SIZE];
+  uint8_t keystream[CCM_TAG_LENGTH + sizeof(PLAINTEXT)];
+  suite.runWithSetup(
+      "software/packet_6_bytes_precomputed",
+      [&]() {
+        tick++;
+        memcpy(&nonce[9], &tick, COUNTER_LEN);
+        software.precompute(nonce, sizeof(PLAINTEXT), state, keystream);
+      },
+      [&]() {
+        payload[0] = tick;
+        software.encryptPrecomputed(state, keystream, payload,
+                                    sizeof(PLAINTEXT), payload, tag);
+        return sizeof(PLAINTEXT) + CCM_TAG_LENGTH;
+      });
+
+  BtHomeV2Device door("bench", "bench", true, KEY, NONCE);
+  uint8_t packet[MAX_ADVERTISEMENT_SIZE];
+  suite.runWithSetup(
+      "trigger/door/event_to_buffer", [&]() {},
+      [&]() {
+        setDoor(door, ++tick & 1);
+        return door.getAdvertisementData(packet);
+      });
+  suite.runWithSetup(
+      "trigger/door/event_to_buffer_precomputed",
+      [&]() { door.precomputeEncryption(); },
+      [&]() {
+        setDoor(door, ++tick & 1);
+        return door.getAdvertisementData(packet);
+      });
+
+  BaseDevice device("bench", "bench", false, KEY, NONCE, 1);
+  uint8_t output[MAX_ADVERTISEMENT_SIZE];
+  suite.run("base_device/encrypt_6_bytes", [&]() {
+    return device.encryptMeasurements(PLAINTEXT, sizeof(PLAINTEXT), output);
+  });
+
+  suite.print();
+  return 0;
+}
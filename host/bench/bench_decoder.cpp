@@ -0,0 +1,250 @@
+/**
+ * @file bench_decoder.cpp
+ * @brief Host benchmarks and round-trip checks for the BTHome decoder.
+ *
+ * Packets built by the encoder are decoded again and compared with the
+ * encoded values; hand-made packets cover text, raw and command objects,
+ * truncated and unknown objects. Any mismatch exits with status 1 before
+ * results are printed.
+ *
+ * Every case decodes whole advertisements (locating the service data, then
+ * visiting every object) and reports packets per second as ops_per_second.
+ *
+ * Usage: bthome_bench_decoder [--iterations N] > results.json
+ */
+
+#include <BaseDevice.h>
+#include <BtHomeDecoder.h>
+
+#include "bench.h"
+
+static bool failed = false;
+
+static void expect(bool condition, const char* name) {
+  if (!condition) {
+    fprintf(stderr, "decoder mismatch: %s\n", name);
+    failed = true;
+  }
+}
+
+static void checkRoundTrip() {
+  ExtendedBaseDevice device("bench", "bench", false);
+  device.addFixedPoint(temperature_int16_scale_0_01, -1234, 100);
+  device.addFixedPoint(humidity_uint16, 5055, 100);
+  device.addUnsignedInteger(battery_percentage, 87);
+  device.addFixedPoint(pressure, 101325, 100);
+  device.addSignedInteger(power_int32, -2500);
+  device.addUnsignedInteger(count_uint32, 4000000000u);
+  device.addFixedPoint(temperature_int8_scale_0_35, -700, 100);
+  device.addState(dimmer, Dimmer_Event_Status_RotateLeft, 3);
+  uint8_t advertisement[MAX_EXTENDED_ADVERTISEMENT_SIZE];
+  size_t length = device.getAdvertisementData(advertisement);
+
+  BtHomeServiceData serviceData;
+  expect(BtHomeServiceData::fromAdvertisement(advertisement, length,
+                                              serviceData),
+         "service data found");
+  expect(serviceData.isValid() && !serviceData.isEncrypted() &&
+             serviceData.isWellFormed(),
+         "valid unencrypted packet");
+
+  BtHomeObject object;
+  expect(serviceData.find(temperature_int16_scale_0_01.id, object) &&
+             object.fixedPoint(100) == -1234,
+         "signed temperature");
+  expect(serviceData.find(humidity_uint16.id, object) &&
+             object.fixedPoint(100) == 5055 && object.value() > 50.54f &&
+             object.value() < 50.56f,
+         "humidity");
+  expect(serviceData.find(battery_percentage.id, object) &&
+             object.rawValue() == 87,
+         "battery");
+  expect(serviceData.find(pressure.id, object) &&
+             object.fixedPoint(100) == 101325,
+         "pressure");
+  expect(serviceData.find(power_int32.id, object) &&
+             object.fixedPoint(1) == -2500,
+         "signed 32 bit power");
+  expect(serviceData.find(count_uint32.id, object) &&
+             object.rawValue() == 4000000000LL,
+         "unsigned 32 bit count");
+  expect(serviceData.find(temperature_int8_scale_0_35.id, object) &&
+             object.fixedPoint(100) == -700,
+         "0.35 step temperature");
+  expect(serviceData.find(dimmer.id, object) && object.length == 2 &&
+             object.data[0] == Dimmer_Event_Status_RotateLeft &&
+             object.data[1] == 3,
+         "dimmer");
+
+  // Objects arrive ordered by id
+  uint8_t previous = 0;
+  size_t count = 0;
+  for (const BtHomeObject& each : serviceData) {
+    expect(each.id >= previous, "object order");
+    previous = each.id;
+    count++;
+  }
+  expect(count == 8, "object count");
+}
+
+static const uint8_t VARIABLE[] = {
+    0x40,                          // version 2, unencrypted
+    0x01, 0x50,                    // battery 80 %
+    0x3B, 0x02, 0x10, 0xAA, 0xBB,  // command 0x10 with two arguments
+    0x53, 0x03, 'a',  'b',  'c',   // text "abc"
+    0x54, 0x02, 0x01, 0x02};       // raw 01 02
+
+static void checkVariableLength() {
+  BtHomeServiceData serviceData(VARIABLE, sizeof(VARIABLE));
+  expect(serviceData.isWellFormed(), "variable length well formed");
+  BtHomeObject object;
+  expect(serviceData.find(COMMAND_OBJECT_ID, object) && object.length == 3 &&
+             object.data[0] == 0x10 && object.data[2] == 0xBB &&
+             object.isVariableLength(),
+         "command");
+  expect(serviceData.find(TEXT_OBJECT_ID, object) && object.length == 3 &&
+             memcmp(object.data, "abc", 3) == 0,
+         "text");
+  expect(serviceData.find(RAW_OBJECT_ID, object) && object.length == 2 &&
+             object.data[1] == 0x02,
+         "raw");
+
+  // Cut inside the text object
+  BtHomeServiceData truncated(VARIABLE, 11);
+  expect(!truncated.isWellFormed(), "truncated text");
+  BtHomeObjectIterator it = truncated.begin();
+  ++it;
+  ++it;
+  expect(it == truncated.end() && it.malformed(), "stops at truncation");
+
+  static const uint8_t unknown[] = {0x40, 0x01, 0x50, 0xFF, 0x01};
+  BtHomeServiceData unknownId(unknown, sizeof(unknown));
+  expect(!unknownId.isWellFormed() && unknownId.find(0x01, object),
+         "unknown id stops after known objects");
+
+  static const uint8_t encrypted[] = {0x41, 0xa4, 0x72, 0x66, 0xc9, 0x5f};
+  BtHomeServiceData encryptedData(encrypted, sizeof(encrypted));
+  expect(encryptedData.begin() == encryptedData.end(),
+         "encrypted packets have no objects");
+}
+
+/// Encoded advertisement kept for the decode loops.
+struct Packet {
+  uint8_t data[MAX_EXTENDED_ADVERTISEMENT_SIZE];
+  size_t length;
+};
+
+template <typename Fill>
+static Packet encode(Fill fill) {
+  ExtendedBaseDevice device("bench", "bench", false);
+  fill(device);
+  Packet packet;
+  packet.length = device.getAdvertisementData(packet.data);
+  return packet;
+}
+
+static void addClimate(ExtendedBaseDevice& device, uint32_t seed) {
+  device.addFixedPoint(temperature_int16_scale_0_01, 2000 + seed % 500, 100);
+  device.addFixedPoint(humidity_uint16, 4000 + seed % 300, 100);
+  device.addUnsignedInteger(battery_percentage, seed % 101);
+}
+
+static void addStation(ExtendedBaseDevice& device, uint32_t seed) {
+  addClimate(device, seed);
+  device.addFixedPoint(pressure, 100000 + seed % 400, 100);
+  device.addUnsignedInteger(co2, 400 + seed % 200);
+  device.addFixedPoint(illuminance, 10000 + seed % 5000, 100);
+}
+
+static void addBinary(ExtendedBaseDevice& device, uint32_t seed) {
+  device.addState(door, seed & 1);
+  device.addState(motion, (seed >> 1) & 1);
+  device.addUnsignedInteger(battery_percentage, seed % 101);
+  device.addState(button, Button_Event_Status_Press);
+}
+
+static void addMeter(ExtendedBaseDevice& device, uint32_t seed) {
+  addStation(device, seed);
+  for (uint8_t phase = 0; phase < 3; phase++) {
+    device.addFixedPoint(voltage_0_1, 2300 + seed % 20, 10);
+    device.addFixedPoint(current_uint16, 1000 + seed % 500, 1000);
+    device.addSignedInteger(power_int32, 23000 + seed % 100);
+    device.addFixedPoint(energy_uint32, 1234500 + seed % 1000, 1000);
+  }
+}
+
+/// Decodes every object of the advertisement and folds the values.
+static size_t decode(const Packet& packet) {
+  BtHomeServiceData serviceData;
+  if (!BtHomeServiceData::fromAdvertisement(packet.data, packet.length,
+                                            serviceData)) {
+    return 0;
+  }
+  int64_t sum = 0;
+  for (const BtHomeObject& object : serviceData) {
+    sum += object.isVariableLength() ? object.length : object.fixedPoint(1000);
+  }
+  bench::doNotOptimize(static_cast<size_t>(sum));
+  return packet.length;
+}
+
+int main(int argc, char** argv) {
+  checkRoundTrip();
+  checkVariableLength();
+  if (failed) {
+    return 1;
+  }
+
+  bench::Suite suite("decoder", argc, argv);
+
+  static const size_t CORPUS_SIZE = 64;
+  std::vector<Packet> climate, station, binary, meter, corpus;
+  for (uint32_t seed = 0; seed < CORPUS_SIZE; seed++) {
+    climate.push_back(encode([&](ExtendedBaseDevice& device) {
+      addClimate(device, seed * 7919);
+    }));
+    station.push_back(encode([&](ExtendedBaseDevice& device) {
+      addStation(device, seed * 7919);
+    }));
+    binary.push_back(encode([&](ExtendedBaseDevice& device) {
+      addBinary(device, seed * 7919);
+    }));
+    meter.push_back(encode([&](ExtendedBaseDevice& device) {
+      addMeter(device, seed * 7919);
+    }));
+  }
+  // Gateway mix: mostly small sensors, some meters
+  for (size_t i = 0; i < CORPUS_SIZE; i++) {
+    corpus.push_back(i % 8 == 7   ? meter[i]
+                     : i % 3 == 0 ? station[i]
+                     : i % 2 == 0 ? binary[i]
+                                  : climate[i]);
+  }
+  Packet variable;
+  variable.data[0] = sizeof(VARIABLE) + 3;
+  variable.data[1] = SERVICE_DATA;
+  variable.data[2] = UUID1;
+  variable.data[3] = UUID2;
+  memcpy(&variable.data[4], VARIABLE, sizeof(VARIABLE));
+  variable.length = sizeof(VARIABLE) + 4;
+
+  struct Case {
+    const char* name;
+    const std::vector<Packet>* packets;
+  };
+  const Case cases[] = {{"decode/climate", &climate},
+                        {"decode/station", &station},
+                        {"decode/binary", &binary},
+                        {"decode/meter_extended", &meter},
+                        {"decode/gateway_mix", &corpus}};
+  for (const Case& each : cases) {
+    size_t index = 0;
+    const std::vector<Packet>& packets = *each.packets;
+    suite.run(each.name,
+              [&]() { return decode(packets[index++ % CORPUS_SIZE]); });
+  }
+  suite.run("decode/variable_length", [&]() { return decode(variable); });
+
+  suite.print();
+  return 0;
+}
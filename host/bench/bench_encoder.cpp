@@ -0,0 +1,492 @@
+/**
+ * @file bench_encoder.cpp
+ * @brief Host micro-benchmarks for the BTHome encoder stack.
+ *
+ * Measures single add* calls and whole station packets (float against
+ * fixed-point readings), complete packets for representative sensor mixes
+ * with and without encryption, legacy (31 byte) and extended (255 byte)
+ * advertisements, block-reserved persistent counters, the high-level
+ * BThomeV2 measurement API, compile-time schemas and the trace ring. The
+ * high-level API is first checked to advertise the same bytes as the device
+ * API, for every object in data_types.h, and to count and advertise its
+ * runtime statistics, and fixed-point packets to match float ones; a
+ * mismatch exits with status 1.
+ *
+ * Usage: bthome_bench_encoder [--iterations N] > results.json
+ */
+
+#include <BThomeV2.h>
+#include <BtHomeDecoder.h>
+#include <BtHomeObjects.h>
+#include <BtHomeSchema.h>
+#include <BtHomeTrace.h>
+#include <BtHomeV2Device.h>
+#include <CounterStorage.h>
+#include <math.h>
+
+#include "bench.h"
+
+static const uint8_t KEY[BIND_KEY_LEN] = {
+    0x23, 0x1d, 0x39, 0xc1, 0xd7, 0xcc, 0x1a, 0xb1,
+    0xae, 0xe2, 0x24, 0xcd, 0x09, 0x6d, 0xb9, 0x32};
+static const uint8_t MAC[BLE_MAC_ADDRESS_LENGTH] = {0x54, 0x48, 0xE6,
+                                                    0x8F, 0x80, 0xA5};
+
+/// Exposes the protected advertising path of the high-level API.
+class HostBThome : public BThomeV2 {
+ public:
+  bool begin(const char*) override { return true; }
+  void end() override {}
+  bool startAdvertising() override { return true; }
+  void stopAdvertising() override {}
+  bool setMAC(const uint8_t[6]) override { return false; }
+
+  /// First frame as the platform backends advertise it.
+  template <typename Device>
+  size_t advertise(Device& device, uint8_t* buffer) {
+    planFrames(frameCapacity(Device::MEASUREMENT_CAPACITY));
+    return encodeFrame(device, 0, buffer, false);
+  }
+
+  /// Takes the measurements as advertised if updateAdvertising() would.
+  bool publish(uint32_t now) {
+    if (!publishDue(now)) {
+      return false;
+    }
+    markAdvertised(now);
+    return true;
+  }
+};
+
+/// The high-level API must advertise the same bytes as the device API.
+static bool checkHighLevelApi() {
+  HostBThome api;
+  api.addTemperature(21.5f);
+  api.addHumidity(45.25f);
+  api.addPressure(1013.25f);
+  api.addBinarySensor(DOOR, true);
+  api.addBattery(80);
+  api.addCO2(420);
+  BtHomeV2Device device("bench", "bench", false);
+  uint8_t expected[MAX_ADVERTISEMENT_SIZE];
+  device.addTemperature_neg327_to_327_Resolution_0_01(21.5f);
+  device.addHumidityPercent_Resolution_0_01(45.25f);
+  device.addPressureHpa(1013.25f);
+  device.setDoorState(Door_Sensor_Status_Open);
+  device.addBatteryPercentage(80);
+  device.addCo2Ppm(420);
+  size_t length = device.getAdvertisementData(expected);
+
+  uint8_t buffer[MAX_ADVERTISEMENT_SIZE];
+  BtHomeV2Device target("bench", "bench", false);
+  if (api.advertise(target, buffer) != length ||
+      memcmp(buffer, expected, length) != 0) {
+    fprintf(stderr, "encoder mismatch: high-level API\n");
+    return false;
+  }
+  return true;
+}
+
+/// Compares the service data of two advertisements.
+static bool sameServiceData(const uint8_t* advertisement, size_t size,
+                            const uint8_t* expectedAdvertisement,
+                            size_t length) {
+  BtHomeServiceData actual;
+  BtHomeServiceData expected;
+  return BtHomeServiceData::fromAdvertisement(advertisement, size, actual) &&
+         BtHomeServiceData::fromAdvertisement(expectedAdvertisement, length,
+                                              expected) &&
+         actual.payloadLength() == expected.payloadLength() &&
+         memcmp(actual.payload() - 1, expected.payload() - 1,
+                actual.payloadLength() + 1) == 0;
+}
+
+/// addObject() must encode every object in data_types.h like BaseDevice.
+static bool checkObjectTable() {
+  static const float VALUES[] = {0.0f, 1.5f, -2.25f, 123.456f, 1e12f, -1e12f,
+                                 NAN};
+  HostBThome api;
+  ExtendedBtHomeV2Device target("bench", "bench", false);
+  ExtendedBaseDevice base("bench", "bench", false);
+  uint8_t actual[MAX_EXTENDED_ADVERTISEMENT_SIZE];
+  uint8_t advertisement[MAX_EXTENDED_ADVERTISEMENT_SIZE];
+  bool same = true;
+  for (const BtHomeType& type : bthome_objects::TYPES) {
+    for (float value : VALUES) {
+      api.clearMeasurements();
+      api.addObject(type.id, value);
+      size_t size = api.advertise(target, actual);
+      base.resetMeasurement();
+      base.addFloat(type, value);
+      size_t length = base.getAdvertisementData(advertisement);
+      same &= sameServiceData(actual, size, advertisement, length);
+    }
+  }
+  for (const BtHomeState& state : bthome_objects::STATES) {
+    api.clearMeasurements();
+    api.addObject(state.id, 1);
+    size_t size = api.advertise(target, actual);
+    base.resetMeasurement();
+    base.addState(state, 1);
+    size_t length = base.getAdvertisementData(advertisement);
+    same &= sameServiceData(actual, size, advertisement, length);
+  }
+  uint8_t wrongSize[] = {0x01, 0x02, 0x03};
+  same &= !api.addObject(0xFF, 1.0f) && !api.addObject(TEXT_OBJECT_ID, 1.0f) &&
+          !api.addMeasurement(TEMPERATURE, wrongSize, sizeof(wrongSize)) &&
+          api.addMeasurement(PRESSURE, wrongSize, sizeof(wrongSize));
+  if (!same) {
+    fprintf(stderr, "encoder mismatch: object table\n");
+  }
+  return same;
+}
+
+/// Deadbands, minimum publish interval and heartbeat.
+static bool checkPublishFilter() {
+  struct Step {
+    uint32_t time;
+    float temperature;
+    bool door;
+    bool published;
+  };
+  static const Step STEPS[] = {
+      {0, 21.00f, false, true},       // First set
+      {1000, 21.05f, false, false},   // Jitter
+      {2000, 20.85f, false, false},   // Within the deadband
+      {3000, 21.25f, false, false},   // Deadband passed, too early
+      {5000, 21.25f, false, true},    // Minimum interval over
+      {6000, 21.35f, false, false},   // Drift below the deadband
+      {7000, 21.40f, false, false},   // Too early again
+      {10000, 21.46f, false, true},   // Drift added up
+      {10500, 21.46f, true, true},    // Door: published at once
+      {60000, 21.46f, true, false},   // Unchanged
+      {70500, 21.46f, true, true},    // Heartbeat
+  };
+  HostBThome api;
+  api.setDeadband(TEMPERATURE, 0.2f);
+  api.setPublishIntervals(5000, 60000);
+  bool same = true;
+  for (const Step& step : STEPS) {
+    api.clearMeasurements();
+    api.addTemperature(step.temperature);
+    api.addBinarySensor(DOOR, step.door);
+    same &= api.publish(step.time) == step.published;
+  }
+  same &= !api.setDeadband(TEXT_OBJECT_ID, 1.0f);
+  if (!same) {
+    fprintf(stderr, "encoder mismatch: publish filter\n");
+  }
+  return same;
+}
+
+/// The trace ring keeps the newest entries in order when it wraps.
+static bool checkTrace() {
+  BasicBtHomeTrace<4> trace;
+  for (uint16_t i = 0; i < 6; i++) {
+    trace.record(BtHome_Trace_User, i);
+  }
+  BtHomeTraceEntry entries[8];
+  size_t count = trace.snapshot(entries, 8);
+  bool same = trace.recorded() == 6 && count == 4;
+  for (size_t i = 0; i < count; i++) {
+    same &= entries[i].value == i + 2;
+  }
+  same &= trace.snapshot(entries, 1) == 1 && entries[0].value == 5;
+  if (!same) {
+    fprintf(stderr, "trace ring mismatch\n");
+  }
+  return same;
+}
+
+/// Encoder counters and the diagnostic raw object at the end of a frame.
+static bool checkStats() {
+  HostBThome api;
+  BtHomeV2Device device("bench", "bench", false);
+  uint8_t buffer[MAX_ADVERTISEMENT_SIZE];
+  api.setStatsAdvertised(true);
+  api.addTemperature(21.5f);
+  size_t first = api.advertise(device, buffer);
+  api.clearMeasurements();
+  for (int i = 0; i < 100; i++) {
+    api.addTemperature(21.5f);  // Overflows the measurement buffer
+  }
+  size_t second = api.advertise(device, buffer);
+  const BtHomeEncoderStats& stats = device.getStats();
+  BThomeV2Stats pipeline = api.getStats();
+  const uint8_t* object = buffer + second - BThomeV2::DIAGNOSTIC_OBJECT_SIZE;
+  bool same = stats.packetsBuilt == 2 &&
+              stats.bytesBuilt == first + second &&
+              stats.lastPacketSize == second && second <= sizeof(buffer) &&
+              pipeline.droppedMeasurements > 0 && object[0] == RAW_OBJECT_ID &&
+              object[1] == 8 && object[2] == 1 && object[3] == 0 &&
+              object[4] == pipeline.droppedMeasurements + stats.droppedObjects;
+  api.resetStats();
+  device.resetStats();
+  same &= api.getStats().droppedMeasurements == 0 &&
+          device.getStats().packetsBuilt == 0;
+  if (!same) {
+    fprintf(stderr, "encoder mismatch: stats\n");
+  }
+  return same;
+}
+
+static uint32_t tick = 0;
+
+template <typename Device>
+static void addClimate(Device& device) {
+  tick++;
+  device.addTemperature_neg327_to_327_Resolution_0_01(20.0f +
+                                                      (tick % 50) / 10.0f);
+  device.addHumidityPercent_Resolution_0_01(40.0f + (tick % 30) / 10.0f);
+  device.addBatteryPercentage(tick % 101);
+}
+
+template <typename Device>
+static void addStation(Device& device) {
+  addClimate(device);
+  device.addPressureHpa(1000.0f + (tick % 40) / 10.0f);
+  device.addCo2Ppm(400 + tick % 200);
+  device.addIlluminanceLux(100.0f + tick % 500);
+}
+
+template <typename Device>
+static void addBinary(Device& device) {
+  tick++;
+  device.setDoorState(tick & 1 ? Door_Sensor_Status_Open
+                               : Door_Sensor_Status_Closed);
+  device.setMotionState(tick & 2 ? Motion_Sensor_Status_Detected
+                                 : Motion_Sensor_Status_Clear);
+  device.addBatteryPercentage(tick % 101);
+  device.setButtonEvent(Button_Event_Status_Press);
+}
+
+/// Station readings through the float API, see addStationFixedPoint().
+template <typename Device>
+static void addStationFloat(Device& device) {
+  tick++;
+  device.addTemperature_neg327_to_327_Resolution_0_01(20.0f +
+                                                      (tick % 50) / 10.0f);
+  device.addHumidityPercent_Resolution_0_01(40.0f + (tick % 30) / 10.0f);
+  device.addPressureHpa(1000.0f + (tick % 40) / 10.0f);
+  device.addIlluminanceLux(100.0f + tick % 500);
+  device.addVoltage_0_to_65_resolution_0_001(3.0f + (tick % 100) / 1000.0f);
+  device.addBatteryPercentage(tick % 101);
+}
+
+/// The same readings as integers, as a sensor driver delivers them.
+template <typename Device>
+static void addStationFixedPoint(Device& device) {
+  tick++;
+  device.addTemperatureCentiDegrees(2000 + (tick % 50) * 10);
+  device.addHumidityCentiPercent(4000 + (tick % 30) * 10);
+  device.addPressurePascal(100000 + (tick % 40) * 10);
+  device.addIlluminanceCentiLux(10000 + (tick % 500) * 100);
+  device.addVoltageMillivolts(3000 + tick % 100);
+  device.addBatteryPercentage(tick % 101);
+}
+
+/// Float and fixed-point station packets must be the same bytes.
+static bool checkFixedPointPacket() {
+  BtHomeV2Device floats("bench", "bench", false);
+  BtHomeV2Device integers("bench", "bench", false);
+  uint8_t expected[MAX_ADVERTISEMENT_SIZE];
+  uint8_t actual[MAX_ADVERTISEMENT_SIZE];
+  bool same = true;
+  for (int i = 0; i < 1000; i++) {
+    uint32_t start = tick;
+    floats.clearMeasurementData();
+    addStationFloat(floats);
+    tick = start;
+    integers.clearMeasurementData();
+    addStationFixedPoint(integers);
+    size_t length = floats.getAdvertisementData(expected);
+    same &= integers.getAdvertisementData(actual) == length &&
+            memcmp(expected, actual, length) == 0;
+  }
+  if (!same) {
+    fprintf(stderr, "encoder mismatch: fixed-point packet\n");
+  }
+  return same;
+}
+
+/// Station plus energy metering; needs an extended advertisement.
+template <typename Device>
+static void addMeter(Device& device) {
+  addStation(device);
+  addBinary(device);
+  for (uint8_t phase = 0; phase < 3; phase++) {
+    device.addVoltage_0_to_6550_resolution_0_1(230.0f + (tick % 20) / 10.0f);
+    device.addCurrentAmps_0_65_Resolution_0_001(1.0f + (tick % 500) / 1000.0f);
+    device.addPower_0_to_167772_resolution_0_01(230.0f + tick % 100);
+    device.addEnergyKwh_0_to_4294967(1234.5f + tick % 1000);
+  }
+}
+
+template <size_t MaxSize, typename Fill>
+static void benchPacket(bench::Suite& suite, const char* name,
+                        BasicBtHomeV2Device<MaxSize>& device, Fill fill) {
+  uint8_t buffer[MaxSize];
+  suite.run(name, [&]() {
+    device.clearMeasurementData();
+    fill(device);
+    return device.getAdvertisementData(buffer);
+  });
+}
+
+int main(int argc, char** argv) {
+  if (!checkHighLevelApi() || !checkObjectTable() || !checkPublishFilter() ||
+      !checkTrace() || !checkStats() || !checkFixedPointPacket()) {
+    return 1;
+  }
+
+  bench::Suite suite("encoder", argc, argv);
+
+  BaseDevice base("bench", "bench", false);
+  suite.run("add/temperature_float", [&]() {
+    base.resetMeasurement();
+    base.addFloat(temperature_int16_scale_0_01, 20.0f + (++tick % 50) / 10.0f);
+    return (size_t)3;
+  });
+  suite.run("add/temperature_fixed_point", [&]() {
+    base.resetMeasurement();
+    base.addFixedPoint(temperature_int16_scale_0_01, 2000 + (++tick % 50) * 10,
+                       100);
+    return (size_t)3;
+  });
+  suite.run("add/pressure_float", [&]() {
+    base.resetMeasurement();
+    base.addFloat(pressure, 1000.0f + (++tick % 40) / 10.0f);
+    return (size_t)4;
+  });
+  suite.run("add/pressure_fixed_point", [&]() {
+    base.resetMeasurement();
+    base.addFixedPoint(pressure, 100000 + (++tick % 40) * 10, 100);
+    return (size_t)4;
+  });
+  suite.run("add/temperature_0_35_fixed_point", [&]() {
+    base.resetMeasurement();
+    base.addFixedPoint(temperature_int8_scale_0_35, 2000 + (++tick % 50) * 10,
+                       100);
+    return (size_t)2;
+  });
+  suite.run("add/battery_integer", [&]() {
+    base.resetMeasurement();
+    base.addUnsignedInteger(battery_percentage, ++tick % 101);
+    return (size_t)2;
+  });
+
+  BtHomeV2Device plain("bench", "bench", false);
+  BtHomeV2Device encrypted("bench", "bench", false, KEY, MAC);
+  benchPacket(suite, "packet/climate/plain", plain,
+              addClimate<BtHomeV2Device>);
+  benchPacket(suite, "packet/climate/encrypted", encrypted,
+              addClimate<BtHomeV2Device>);
+  benchPacket(suite, "packet/station/plain", plain,
+              addStation<BtHomeV2Device>);
+  benchPacket(suite, "packet/binary/plain", plain, addBinary<BtHomeV2Device>);
+  // Whole packets from float and from integer readings
+  benchPacket(suite, "packet/station/float", plain,
+              addStationFloat<BtHomeV2Device>);
+  benchPacket(suite, "packet/station/fixed_point", plain,
+              addStationFixedPoint<BtHomeV2Device>);
+  benchPacket(suite, "packet/binary/encrypted", encrypted,
+              addBinary<BtHomeV2Device>);
+
+  RamCounterStorage counterStorage;
+  PersistentCounter counter(counterStorage);
+  counter.begin();
+  BtHomeV2Device persistent("bench", "bench", false, KEY, MAC);
+  persistent.setPersistentCounter(&counter);
+  benchPacket(suite, "packet/climate/encrypted_persistent", persistent,
+              addClimate<BtHomeV2Device>);
+
+  ExtendedBtHomeV2Device extended("bench", "bench", false);
+  ExtendedBtHomeV2Device extendedEncrypted("bench", "bench", false, KEY, MAC);
+  benchPacket(suite, "packet/station/extended", extended,
+              addStation<ExtendedBtHomeV2Device>);
+  benchPacket(suite, "packet/meter/extended", extended,
+              addMeter<ExtendedBtHomeV2Device>);
+  benchPacket(suite, "packet/meter/extended_encrypted", extendedEncrypted,
+              addMeter<ExtendedBtHomeV2Device>);
+
+  uint8_t buffer[MAX_ADVERTISEMENT_SIZE];
+  plain.clearMeasurementData();
+  addStation(plain);
+  suite.run("build/station/unchanged",
+            [&]() { return plain.getAdvertisementData(buffer); });
+  encrypted.clearMeasurementData();
+  addClimate(encrypted);
+  suite.run("build/climate/encrypted",
+            [&]() { return encrypted.getAdvertisementData(buffer); });
+
+  HostBThome api;
+  BtHomeV2Device target("bench", "bench", false);
+  suite.run("bthomev2/climate", [&]() {
+    tick++;
+    api.clearMeasurements();
+    api.addTemperature(20.0f + (tick % 50) / 10.0f);
+    api.addHumidity(40.0f + (tick % 30) / 10.0f);
+    api.addBattery(tick % 101);
+    return api.advertise(target, buffer);
+  });
+  suite.run("bthomev2/station_frame", [&]() {
+    tick++;
+    api.clearMeasurements();
+    api.addTemperature(20.0f + (tick % 50) / 10.0f);
+    api.addHumidity(40.0f + (tick % 30) / 10.0f);
+    api.addBattery(tick % 101);
+    api.addPressure(1000.0f + (tick % 40) / 10.0f);
+    api.addCO2(400 + tick % 200);
+    api.addIlluminance(100.0f + tick % 500);
+    return api.advertise(target, buffer);
+  });
+  // Sensor noise of +-0.05 around a reading inside a 0.2 deadband
+  HostBThome filtered;
+  filtered.setDeadband(TEMPERATURE, 0.2f);
+  filtered.setDeadband(HUMIDITY, 1.0f);
+  filtered.addTemperature(21.0f);
+  filtered.addHumidity(50.0f);
+  filtered.publish(0);
+  suite.run("bthomev2/jitter_filtered", [&]() {
+    tick++;
+    filtered.clearMeasurements();
+    filtered.addTemperature(21.0f + (tick % 11) / 100.0f - 0.05f);
+    filtered.addHumidity(50.0f + (tick % 7) / 10.0f - 0.3f);
+    return (size_t)filtered.publish(tick);
+  });
+
+  uint8_t extendedBuffer[MAX_EXTENDED_ADVERTISEMENT_SIZE];
+  ExtendedBtHomeV2Device meter("bench", "bench", false);
+  suite.run("bthomev2/meter_objects", [&]() {
+    tick++;
+    api.clearMeasurements();
+    for (uint8_t phase = 0; phase < 3; phase++) {
+      api.addObject(voltage_0_1.id, 230.0f + (tick % 20) / 10.0f);
+      api.addObject(power_int32.id, -50.0f + tick % 100);
+      api.addObject(energy_uint32.id, 1234.5f + tick % 1000);
+    }
+    return api.advertise(meter, extendedBuffer);
+  });
+
+  typedef BtHomeSchema<false, BTHOME_FIELD(temperature_int16_scale_0_01),
+                       BTHOME_FIELD(humidity_uint16),
+                       BTHOME_FIELD(battery_percentage)>
+      ClimateSchema;
+  ClimateSchema schema;
+  suite.run("schema/climate", [&]() {
+    tick++;
+    schema.set<0>(2000 + tick % 500);
+    schema.set<1>(4000 + tick % 300);
+    schema.set<2>(tick % 101);
+    return schema.size();
+  });
+
+  BtHomeTrace trace;
+  suite.run("trace/record", [&]() {
+    trace.record(BtHome_Trace_RadioUpdate, ++tick);
+    return sizeof(BtHomeTraceEntry);
+  });
+
+  suite.print();
+  return 0;
+}
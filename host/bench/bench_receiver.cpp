@@ -0,0 +1,220 @@
+/**
+ * @file bench_receiver.cpp
+ * @brief Host benchmarks and checks for the gateway receive pipeline.
+ *
+ * A fleet of 200 simulated sensors (plain, with packet id and encrypted)
+ * sends every packet three times, as BLE advertisers repeat them. The stream
+ * is fed through BtHomeReceiver and every packet must be stored exactly once.
+ * Replayed counters, table overflow and expiry are checked as well; any
+ * mismatch exits with status 1 before results are printed.
+ *
+ * ops_per_second is received advertisements per second.
+ *
+ * Usage: bthome_bench_receiver [--iterations N] > results.json
+ */
+
+#include <BaseDevice.h>
+#include <BtHomeReceiver.h>
+
+#include "bench.h"
+
+static const uint8_t KEY[16] = {0x23, 0x1d, 0x39, 0xc1, 0xd7, 0xcc,
+                                0x1a, 0xb1, 0xae, 0xe2, 0x24, 0xcd,
+                                0x09, 0x6d, 0xb9, 0x32};
+static const size_t FLEET_SIZE = 200;
+static const size_t ROUNDS = 8;
+static const size_t REPEATS = 3;
+
+static bool failed = false;
+
+static void expect(bool condition, const char* name) {
+  if (!condition) {
+    fprintf(stderr, "receiver mismatch: %s\n", name);
+    failed = true;
+  }
+}
+
+/// One received advertisement.
+struct Record {
+  uint8_t mac[BLE_ADDRESS_LENGTH];
+  uint8_t data[MAX_ADVERTISEMENT_SIZE];
+  uint8_t length;
+  int8_t rssi;
+  uint32_t time;
+};
+
+static void fleetMac(size_t index, uint8_t mac[BLE_ADDRESS_LENGTH]) {
+  // Shared vendor prefix, like a batch of identical sensors
+  static const uint8_t PREFIX[3] = {0xA4, 0xC1, 0x38};
+  memcpy(mac, PREFIX, sizeof(PREFIX));
+  mac[3] = 0x00;
+  mac[4] = index >> 8;
+  mac[5] = index;
+}
+
+/// Every third sensor is plain, with packet id or encrypted; each round
+/// changes the temperature.
+static std::vector<Record> recordFleet() {
+  std::vector<BaseDevice*> devices;
+  for (size_t i = 0; i < FLEET_SIZE; i++) {
+    uint8_t mac[BLE_ADDRESS_LENGTH];
+    fleetMac(i, mac);
+    BaseDevice* device;
+    if (i % 3 == 2) {
+      uint8_t reversed[BLE_MAC_ADDRESS_LENGTH];
+      for (uint8_t b = 0; b < BLE_ADDRESS_LENGTH; b++) {
+        reversed[b] = mac[BLE_ADDRESS_LENGTH - 1 - b];
+      }
+      device = new BaseDevice("fleet", "fleet", false, KEY, reversed, 1);
+    } else {
+      device = new BaseDevice("fleet", "fleet", false);
+      device->setPacketIdEnabled(i % 3 == 1);
+    }
+    devices.push_back(device);
+  }
+
+  std::vector<Record> stream;
+  uint32_t time = 0;
+  for (size_t round = 0; round < ROUNDS; round++) {
+    for (size_t i = 0; i < FLEET_SIZE; i++) {
+      BaseDevice& device = *devices[i];
+      device.resetMeasurement();
+      device.addFixedPoint(temperature_int16_scale_0_01,
+                           2000 + 10 * round + i % 7, 100);
+      device.addUnsignedInteger(battery_percentage, 90);
+      Record record;
+      fleetMac(i, record.mac);
+      record.length = device.getAdvertisementData(record.data);
+      record.rssi = -40 - i % 50;
+      for (size_t repeat = 0; repeat < REPEATS; repeat++) {
+        record.time = time++;
+        stream.push_back(record);
+      }
+    }
+  }
+  for (BaseDevice* device : devices) {
+    delete device;
+  }
+  return stream;
+}
+
+static void checkFleet(const std::vector<Record>& stream) {
+  static BtHomeReceiver receiver;
+  size_t results[BtHome_Receive_Table_Full + 1] = {0};
+  for (const Record& record : stream) {
+    results[receiver.process(record.mac, record.data, record.length,
+                             record.rssi, record.time)]++;
+  }
+  expect(receiver.size() == FLEET_SIZE, "fleet size");
+  expect(results[BtHome_Receive_New] == FLEET_SIZE, "new devices");
+  expect(results[BtHome_Receive_Updated] == FLEET_SIZE * (ROUNDS - 1),
+         "one update per round");
+  expect(results[BtHome_Receive_Duplicate] ==
+             FLEET_SIZE * ROUNDS * (REPEATS - 1),
+         "repeats dropped");
+
+  uint8_t mac[BLE_ADDRESS_LENGTH];
+  fleetMac(2, mac);
+  const BtHomeReceiver::Entry* entry = receiver.find(mac);
+  BtHomeObject object;
+  expect(entry && entry->packets == ROUNDS && entry->hasCounter &&
+             entry->counter == ROUNDS,
+         "encrypted device");
+  fleetMac(1, mac);
+  entry = receiver.find(mac);
+  expect(entry && entry->hasPacketId &&
+             entry->serviceData().find(temperature_int16_scale_0_01.id,
+                                       object) &&
+             object.fixedPoint(100) == 2000 + 10 * (ROUNDS - 1) + 1,
+         "latest packet stored");
+
+  // An old encrypted packet sent again must not be accepted
+  const Record& old = stream[2 * REPEATS];
+  expect(receiver.process(old.mac, old.data, old.length, old.rssi,
+                          stream.back().time) == BtHome_Receive_Duplicate,
+         "replayed counter");
+}
+
+static void checkCapacityAndExpiry(const std::vector<Record>& stream) {
+  BasicBtHomeReceiver<16> small;
+  size_t full = 0;
+  for (size_t i = 0; i < 20; i++) {
+    const Record& record = stream[i * REPEATS];
+    if (small.process(record.mac, record.data, record.length, record.rssi,
+                      0) == BtHome_Receive_Table_Full) {
+      full++;
+    }
+  }
+  expect(small.size() == BasicBtHomeReceiver<16>::MAX_DEVICES && full == 6,
+         "table full");
+
+  // Drop every second device; the others must stay reachable after the
+  // backward shifts
+  static BtHomeReceiver receiver;
+  for (size_t i = 0; i < FLEET_SIZE; i++) {
+    const Record& record = stream[i * REPEATS];
+    receiver.process(record.mac, record.data, record.length, record.rssi,
+                     i % 2 ? 1000 : 0);
+  }
+  expect(receiver.expire(1500, 1000) == FLEET_SIZE / 2, "expired count");
+  bool reachable = true;
+  for (size_t i = 0; i < FLEET_SIZE; i++) {
+    uint8_t mac[BLE_ADDRESS_LENGTH];
+    fleetMac(i, mac);
+    reachable &= (receiver.find(mac) != nullptr) == (i % 2 == 1);
+  }
+  expect(reachable && receiver.size() == FLEET_SIZE / 2, "expiry");
+
+  static const uint8_t other[] = {0x02, 0x01, 0x06, 0x03, 0x03, 0x0F, 0x18};
+  expect(receiver.process(stream[0].mac, other, sizeof(other), 0, 0) ==
+             BtHome_Receive_Ignored,
+         "other advertisements ignored");
+}
+
+int main(int argc, char** argv) {
+  std::vector<Record> stream = recordFleet();
+  checkFleet(stream);
+  checkCapacityAndExpiry(stream);
+  if (failed) {
+    return 1;
+  }
+
+  bench::Suite suite("receiver", argc, argv);
+
+  // Starts from an empty table for every pass over the stream
+  static BtHomeReceiver receiver;
+  size_t index = 0;
+  suite.runWithSetup(
+      "receive/fleet_200_first_pass",
+      [&]() {
+        if (index == stream.size()) {
+          receiver.clear();
+          index = 0;
+        }
+      },
+      [&]() {
+        const Record& record = stream[index++];
+        receiver.process(record.mac, record.data, record.length,
+                         record.rssi, record.time);
+        return (size_t)record.length;
+      });
+
+  // Known devices only: repeats, updates and replayed counters
+  index = 0;
+  suite.run("receive/fleet_200_known", [&]() {
+    const Record& record = stream[index++ % stream.size()];
+    receiver.process(record.mac, record.data, record.length, record.rssi,
+                     record.time);
+    return (size_t)record.length;
+  });
+
+  index = 0;
+  suite.run("lookup/fleet_200", [&]() {
+    const Record& record = stream[index++ % stream.size()];
+    bench::doNotOptimize(receiver.find(record.mac)->packets);
+    return (size_t)0;
+  });
+
+  suite.print();
+  return 0;
+}
@@ -0,0 +1,45 @@
+/**
+ * @file Arduino.h
+ * @brief Minimal Arduino API for building the encoder on a host machine.
+ *
+ * Only what the library sources use is provided: fixed-width types, the
+ * string functions, timing and a Serial object that writes to stdout.
+ */
+
+#ifndef BTHOME_HOST_ARDUINO_H
+#define BTHOME_HOST_ARDUINO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef uint8_t byte;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+
+class HostSerial {
+ public:
+  void begin(unsigned long) {}
+  void flush() { fflush(stdout); }
+  void print(const char* text) { fputs(text, stdout); }
+  void print(long value) { printf("%ld", value); }
+  void print(unsigned long value) { printf("%lu", value); }
+  void print(int value) { printf("%d", value); }
+  void print(unsigned int value) { printf("%u", value); }
+  void print(double value) { printf("%.2f", value); }
+  void println() { fputs("\n", stdout); }
+  template <typename T>
+  void println(T value) {
+    print(value);
+    println();
+  }
+  int printf(const char* format, ...)
+      __attribute__((format(printf, 2, 3)));
+};
+
+extern HostSerial Serial;
+
+#endif  // BTHOME_HOST_ARDUINO_H
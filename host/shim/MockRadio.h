@@ -0,0 +1,182 @@
+/**
+ * @file MockRadio.h
+ * @brief Simulated advertiser to measure the BtHomeRadio paths on host.
+ *
+ * Models a controller that sends one advertising event per interval while
+ * enabled (without the random advDelay) and a stack that needs one round
+ * trip of commandUs for every command: start() stops a running set and sends
+ * parameters, data and enable, update() sends the data only. Time moves with
+ * the commands and advanceTo(), in microseconds. From the events sent it
+ * counts the time off air during restarts, the longest silence between two
+ * events and the latency from a call until the first event with its data.
+ * setAddress() applies from the next start(), like on a controller; a
+ * listener sees every event with its address.
+ */
+
+#ifndef BTHOME_HOST_MOCK_RADIO_H
+#define BTHOME_HOST_MOCK_RADIO_H
+
+#include <BaseDevice.h>
+#include <BtHomeRadio.h>
+
+class MockRadio : public BtHomeRadio {
+ public:
+  struct Stats {
+    uint32_t starts;
+    uint32_t updates;
+    uint32_t commands;
+    uint32_t events;
+    uint32_t delivered;   // Payloads that made it on air
+    uint32_t superseded;  // Payloads replaced before their first event
+    uint64_t offAirUs;
+    uint64_t maxSilenceUs;
+    uint64_t latencyUs;  // Sum over the delivered payloads
+    uint64_t maxLatencyUs;
+  };
+
+  /// @brief Called for every advertising event.
+  typedef void (*Listener)(void* context, uint64_t time,
+                           const uint8_t address[6], const uint8_t* data,
+                           size_t size);
+
+  /// @param canUpdate false for a stack that has to restart for new data
+  /// @param commandUs Round trip of one command into the stack
+  /// @param firstEventUs Time from enabling to the first event
+  explicit MockRadio(bool canUpdate = true, uint32_t commandUs = 500,
+                     uint32_t firstEventUs = 5000)
+      : _canUpdate(canUpdate),
+        _commandUs(commandUs),
+        _firstEventUs(firstEventUs) {
+    memset(&_stats, 0, sizeof(_stats));
+  }
+
+  bool start(const uint8_t* data, size_t size, uint16_t interval) override {
+    uint64_t requested = _now;
+    _stats.starts++;
+    bool restart = _running;
+    if (restart) {
+      command();  // Disable
+      _running = false;
+    }
+    uint64_t offSince = _now;
+    memcpy(_address, _nextAddress, sizeof(_address));
+    command();  // Parameters
+    command();  // Data
+    setPending(data, size, requested);
+    command();  // Enable
+    if (restart) {
+      _stats.offAirUs += _now - offSince;
+    }
+    _running = true;
+    _intervalUs = interval * 625ull;
+    _nextEventUs = _now + _firstEventUs;
+    return true;
+  }
+
+  bool update(const uint8_t* data, size_t size) override {
+    if (!_canUpdate || !_running) {
+      return false;
+    }
+    uint64_t requested = _now;
+    _stats.updates++;
+    // Events during the round trip still carry the old data
+    command();
+    setPending(data, size, requested);
+    return true;
+  }
+
+  void stop() override {
+    if (_running) {
+      command();
+      _running = false;
+    }
+  }
+
+  bool setAddress(const uint8_t address[6]) override {
+    memcpy(_nextAddress, address, sizeof(_nextAddress));
+    return true;
+  }
+
+  void setListener(Listener listener, void* context) {
+    _listener = listener;
+    _context = context;
+  }
+
+  /// @brief Send the advertising events due until time us.
+  void advanceTo(uint64_t us) {
+    while (_running && _nextEventUs <= us) {
+      sendEvent(_nextEventUs);
+      _nextEventUs += _intervalUs;
+    }
+    if (us > _now) {
+      _now = us;
+    }
+  }
+
+  uint64_t now() const { return _now; }
+  const Stats& stats() const { return _stats; }
+
+  /// @brief Data of the last advertising event.
+  const uint8_t* airData() const { return _air; }
+  size_t airSize() const { return _airSize; }
+
+ private:
+  void command() {
+    _stats.commands++;
+    advanceTo(_now + _commandUs);
+  }
+
+  void setPending(const uint8_t* data, size_t size, uint64_t requested) {
+    if (_pending) {
+      _stats.superseded++;
+    }
+    memcpy(_data, data, size);
+    _size = size;
+    _requested = requested;
+    _pending = true;
+  }
+
+  void sendEvent(uint64_t time) {
+    if (_stats.events > 0 && time - _lastEventUs > _stats.maxSilenceUs) {
+      _stats.maxSilenceUs = time - _lastEventUs;
+    }
+    _stats.events++;
+    _lastEventUs = time;
+    memcpy(_air, _data, _size);
+    _airSize = _size;
+    if (_listener) {
+      _listener(_context, time, _address, _air, _airSize);
+    }
+    if (_pending) {
+      uint64_t latency = time - _requested;
+      _stats.latencyUs += latency;
+      if (latency > _stats.maxLatencyUs) {
+        _stats.maxLatencyUs = latency;
+      }
+      _stats.delivered++;
+      _pending = false;
+    }
+  }
+
+  bool _canUpdate;
+  uint32_t _commandUs;
+  uint32_t _firstEventUs;
+  bool _running = false;
+  uint64_t _now = 0;
+  uint64_t _intervalUs = 0;
+  uint64_t _nextEventUs = 0;
+  uint64_t _lastEventUs = 0;
+  uint8_t _data[MAX_EXTENDED_ADVERTISEMENT_SIZE];
+  size_t _size = 0;
+  uint64_t _requested = 0;
+  bool _pending = false;
+  uint8_t _air[MAX_EXTENDED_ADVERTISEMENT_SIZE];
+  size_t _airSize = 0;
+  uint8_t _address[6] = {0};
+  uint8_t _nextAddress[6] = {0};
+  Listener _listener = nullptr;
+  void* _context = nullptr;
+  Stats _stats;
+};
+
+#endif  // BTHOME_HOST_MOCK_RADIO_H
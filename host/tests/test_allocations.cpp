@@ -0,0 +1,97 @@
+/**
+ * @file test_allocations.cpp
+ * @brief Steady-state encoding must never touch the heap.
+ *
+ * Counts operator new calls (bench.cpp) across repeated add* and
+ * getAdvertisementData() calls on plain, encrypted and extended encoders and
+ * the high-level BThomeV2 API on the advertising path of the radios
+ * (encodeFrame()), after one warm-up round. Exits with status 1
+ * if any of them allocates. Run by ctest.
+ */
+
+#include <BThomeV2.h>
+#include <BtHomeV2Device.h>
+
+#include "bench.h"
+
+static const uint8_t KEY[BIND_KEY_LEN] = {
+    0x23, 0x1d, 0x39, 0xc1, 0xd7, 0xcc, 0x1a, 0xb1,
+    0xae, 0xe2, 0x24, 0xcd, 0x09, 0x6d, 0xb9, 0x32};
+static const uint8_t MAC[BLE_MAC_ADDRESS_LENGTH] = {0x54, 0x48, 0xE6,
+                                                    0x8F, 0x80, 0xA5};
+static const int ROUNDS = 1000;
+
+/// Exposes the protected advertising path of the high-level API.
+class HostBThome : public BThomeV2 {
+ public:
+  bool begin(const char*) override { return true; }
+  void end() override {}
+  bool startAdvertising() override { return true; }
+  void stopAdvertising() override {}
+  bool setMAC(const uint8_t[6]) override { return false; }
+
+  /// First frame as the platform backends advertise it.
+  size_t advertise(BtHomeV2Device& device, uint8_t* buffer) {
+    planFrames(frameCapacity(BtHomeV2Device::MEASUREMENT_CAPACITY));
+    return encodeFrame(device, 0, buffer, false);
+  }
+};
+
+template <typename Device>
+static size_t encode(Device& device, uint8_t* buffer, int round) {
+  device.clearMeasurementData();
+  device.addTemperature_neg327_to_327_Resolution_0_01(20.0f + round % 50);
+  device.addHumidityPercent_Resolution_0_01(40.0f + round % 30);
+  device.setDoorState(round & 1 ? Door_Sensor_Status_Open
+                                : Door_Sensor_Status_Closed);
+  device.addBatteryPercentage(round % 101);
+  return device.getAdvertisementData(buffer);
+}
+
+/// @brief Runs body once to warm up, then ROUNDS times counting allocations.
+template <typename Body>
+static bool noAllocations(const char* name, Body body) {
+  body(0);
+  size_t before = bench::allocationCount();
+  for (int round = 1; round <= ROUNDS; round++) {
+    bench::doNotOptimize(body(round));
+  }
+  size_t allocations = bench::allocationCount() - before;
+  if (allocations != 0) {
+    fprintf(stderr, "%s: %zu allocations in %d rounds\n", name, allocations,
+            ROUNDS);
+  }
+  return allocations == 0;
+}
+
+int main() {
+  BtHomeV2Device plain("test", "test", false);
+  plain.setPacketIdEnabled(true);
+  BtHomeV2Device encrypted("test", "test", false, KEY, MAC);
+  ExtendedBtHomeV2Device extended("test", "test", false, KEY, MAC);
+  HostBThome api;
+  BtHomeV2Device target("test", "test", false);
+  uint8_t buffer[MAX_EXTENDED_ADVERTISEMENT_SIZE];
+
+  bool ok = true;
+  ok &= noAllocations("plain", [&](int round) {
+    return encode(plain, buffer, round);
+  });
+  ok &= noAllocations("encrypted", [&](int round) {
+    return encode(encrypted, buffer, round);
+  });
+  ok &= noAllocations("extended", [&](int round) {
+    return encode(extended, buffer, round);
+  });
+  ok &= noAllocations("unchanged", [&](int) {
+    return plain.getAdvertisementData(buffer);
+  });
+  ok &= noAllocations("bthomev2", [&](int round) {
+    api.clearMeasurements();
+    api.addTemperature(20.0f + round % 50);
+    api.addHumidity(40.0f + round % 30);
+    api.addBattery(round % 101);
+    return api.advertise(target, buffer);
+  });
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,100 @@
+/**
+ * @file test_binary_sensors.cpp
+ * @brief BThomeV2::addBinarySensor() must send the object id of the spec.
+ *
+ * Encodes every binary sensor of BThomeObjectID through the advertising
+ * path of the radios (BThomeV2::encodeFrame()) and decodes the service data
+ * again. The object must carry the id and size of its data_types.h
+ * descriptor, e.g. WINDOW 0x2D, and the state as value. Exits with status 1
+ * on a mismatch. Run by ctest.
+ */
+
+#include <BThomeV2.h>
+#include <BtHomeDecoder.h>
+#include <BtHomeV2Device.h>
+
+class HostBThome : public BThomeV2 {
+ public:
+  bool begin(const char*) override { return true; }
+  void end() override {}
+  bool startAdvertising() override { return true; }
+  void stopAdvertising() override {}
+  bool setMAC(const uint8_t[6]) override { return false; }
+
+  using BThomeV2::encodeFrame;
+  using BThomeV2::planFrames;
+
+  size_t plan() {
+    return planFrames(frameCapacity(BtHomeV2Device::MEASUREMENT_CAPACITY));
+  }
+};
+
+struct BinarySensor {
+  const char* name;
+  BThomeObjectID id;
+  BtHomeState state;
+};
+
+static const BinarySensor SENSORS[] = {
+    {"GENERIC_BOOLEAN", GENERIC_BOOLEAN, generic_boolean},
+    {"BATTERY_LOW", BATTERY_LOW, battery_state},
+    {"BATTERY_CHARGING", BATTERY_CHARGING, battery_charging},
+    {"CO", CO, carbon_monoxide},
+    {"COLD", COLD, cold},
+    {"CONNECTIVITY", CONNECTIVITY, connectivity},
+    {"DOOR", DOOR, door},
+    {"GARAGE_DOOR", GARAGE_DOOR, garage_door},
+    {"GAS", GAS, gas},
+    {"HEAT", HEAT, heat},
+    {"LIGHT", LIGHT, light},
+    {"LOCK", LOCK, lock},
+    {"MOISTURE_BINARY", MOISTURE_BINARY, moisture},
+    {"MOTION", MOTION, motion},
+    {"MOVING", MOVING, moving},
+    {"OCCUPANCY", OCCUPANCY, occupancy},
+    {"OPENING", OPENING, opening},
+    {"PLUG", PLUG, plug},
+    {"POWER_BINARY", POWER_BINARY, power},
+    {"PRESENCE", PRESENCE, presence},
+    {"PROBLEM", PROBLEM, problem},
+    {"RUNNING", RUNNING, running},
+    {"SAFETY", SAFETY, safety},
+    {"SMOKE", SMOKE, smoke},
+    {"SOUND", SOUND, sound},
+    {"TAMPER", TAMPER, tamper},
+    {"VIBRATION", VIBRATION, vibration},
+    {"WINDOW", WINDOW, window},
+};
+
+static bool checkSensor(const BinarySensor& sensor, bool state) {
+  HostBThome api;
+  api.addBinarySensor(sensor.id, state);
+  api.plan();
+  BtHomeV2Device device("test", "test", false);
+  uint8_t buffer[MAX_ADVERTISEMENT_SIZE];
+  size_t length = api.encodeFrame(device, 0, buffer, false);
+
+  BtHomeServiceData serviceData;
+  bool ok = BtHomeServiceData::fromAdvertisement(buffer, length, serviceData);
+  size_t objects = 0;
+  for (BtHomeObjectIterator it = serviceData.begin();
+       ok && it != serviceData.end(); ++it, objects++) {
+    ok = it->id == sensor.state.id &&
+         it->info.byteCount == sensor.state.byteCount &&
+         it->rawValue() == (state ? 1 : 0);
+  }
+  ok &= objects == 1;
+  if (!ok) {
+    fprintf(stderr, "%s is not sent as object 0x%02X\n", sensor.name,
+            sensor.state.id);
+  }
+  return ok;
+}
+
+int main() {
+  bool ok = true;
+  for (const BinarySensor& sensor : SENSORS) {
+    ok &= checkSensor(sensor, true) && checkSensor(sensor, false);
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,63 @@
+/**
+ * @file test_counter_storage.cpp
+ * @brief FileCounterStorage must never leave a truncated counter behind.
+ *
+ * Stores counters in the file given as argument, leaves a half-written
+ * temporary file behind like a crash during store() would, and checks that
+ * the previous counter still loads and the next store() replaces both.
+ * Exits with status 1 on a mismatch. Run by ctest.
+ */
+
+#include <CounterStorage.h>
+#include <stdio.h>
+#include <string.h>
+
+static bool exists(const char* path) {
+  FILE* file = fopen(path, "rb");
+  if (file) {
+    fclose(file);
+  }
+  return file != nullptr;
+}
+
+static bool expect(bool condition, const char* what) {
+  if (!condition) {
+    fprintf(stderr, "%s\n", what);
+  }
+  return condition;
+}
+
+int main(int argc, char** argv) {
+  const char* path = argc > 1 ? argv[1] : "counter_storage.bin";
+  char temporary[FILENAME_MAX];
+  snprintf(temporary, sizeof(temporary), "%s.tmp", path);
+  remove(path);
+  remove(temporary);
+
+  FileCounterStorage storage(path);
+  uint32_t value = 0;
+  bool ok = expect(!storage.load(value), "loaded a missing file");
+  ok &= expect(storage.store(0x12345678) && storage.load(value) &&
+                   value == 0x12345678,
+               "stored counter does not load");
+  ok &= expect(!exists(temporary), "temporary file left behind");
+
+  // A crash during store() leaves at most a partial temporary file
+  FILE* partial = fopen(temporary, "wb");
+  ok &= expect(partial && fwrite("\x01\x02", 1, 2, partial) == 2 &&
+                   fclose(partial) == 0,
+               "cannot write the partial file");
+  ok &= expect(storage.load(value) && value == 0x12345678,
+               "partial write lost the previous counter");
+  ok &= expect(storage.store(0x12345679) && storage.load(value) &&
+                   value == 0x12345679 && !exists(temporary),
+               "store after a crash failed");
+
+  // A store that cannot write leaves nothing behind
+  FileCounterStorage missing("no_such_directory/counter.bin");
+  ok &= expect(!missing.store(1) && !missing.load(value),
+               "stored into a missing directory");
+
+  remove(path);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,131 @@
+/**
+ * @file test_patching.cpp
+ * @brief Patched advertisements must equal ones built from scratch.
+ *
+ * Encodes a sequence of changing readings with one long-lived encoder,
+ * which patches the changed values into its last advertisement, and with a
+ * new encoder for every reading, which builds the advertisement from
+ * scratch. Covers BtHomeV2Device with and without packet id and
+ * BThomeV2::encodeFrame() with rotating frames and layout changes. Exits
+ * with status 1 on the first difference. Run by ctest.
+ */
+
+#include <BThomeV2.h>
+#include <BtHomeV2Device.h>
+
+static const int ROUNDS = 500;
+
+class HostBThome : public BThomeV2 {
+ public:
+  bool begin(const char*) override { return true; }
+  void end() override {}
+  bool startAdvertising() override { return true; }
+  void stopAdvertising() override {}
+  bool setMAC(const uint8_t[6]) override { return false; }
+
+  using BThomeV2::encodeFrame;
+  using BThomeV2::planFrames;
+
+  size_t plan() {
+    return planFrames(frameCapacity(BtHomeV2Device::MEASUREMENT_CAPACITY));
+  }
+};
+
+static bool same(const char* name, int round, const uint8_t* expected,
+                 size_t expectedSize, const uint8_t* actual,
+                 size_t actualSize) {
+  if (expectedSize == actualSize &&
+      memcmp(expected, actual, actualSize) == 0) {
+    return true;
+  }
+  fprintf(stderr, "%s: round %d differs from a fresh build\n", name, round);
+  return false;
+}
+
+template <typename Device>
+static void addReadings(Device& device, int round) {
+  device.addTemperature_neg327_to_327_Resolution_0_01(20.0f + round % 37);
+  device.addHumidityPercent_Resolution_0_01(40.0f + round % 13);
+  device.addBatteryPercentage(round % 3 == 0 ? 90 : 80);  // Often unchanged
+  device.setDoorState(round & 4 ? Door_Sensor_Status_Open
+                                : Door_Sensor_Status_Closed);
+}
+
+static bool checkDevice(bool packetId) {
+  const char* name = packetId ? "device/packet_id" : "device";
+  BtHomeV2Device patched("test", "test", false);
+  patched.setPacketIdEnabled(packetId);
+  uint8_t expected[MAX_ADVERTISEMENT_SIZE];
+  uint8_t actual[MAX_ADVERTISEMENT_SIZE];
+  for (int round = 0; round < ROUNDS; round++) {
+    patched.clearMeasurementData();
+    addReadings(patched, round);
+    if (round % 50 == 49) {
+      patched.addCo2Ppm(400 + round);  // Another layout now and then
+    }
+    size_t actualSize = patched.getAdvertisementData(actual);
+
+    BtHomeV2Device fresh("test", "test", false);
+    fresh.setPacketIdEnabled(packetId);
+    fresh.setPacketId(patched.getPacketId() - 1);
+    addReadings(fresh, round);
+    if (round % 50 == 49) {
+      fresh.addCo2Ppm(400 + round);
+    }
+    size_t expectedSize = fresh.getAdvertisementData(expected);
+    if (!same(name, round, expected, expectedSize, actual, actualSize)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// Three frames of legacy advertisements, rotated like poll() does.
+static void addStation(HostBThome& api, int round) {
+  api.clearMeasurements();
+  api.addTemperature(20.0f + round % 37);
+  api.addHumidity(40.0f + round % 13);
+  api.addPressure(1000.0f + round % 7);
+  api.addIlluminance(100.0f + round % 11);
+  api.addCO2(400 + round % 5);
+  api.addBattery(80);
+  api.addBinarySensor(DOOR, round & 1);
+  api.addObject(0x0C, 3.0f + round % 3 / 10.0f);  // Voltage
+  if (round % 40 >= 20) {
+    api.addBinarySensor(MOTION, true);  // Changes the frame layout
+  }
+}
+
+static bool checkFrames(bool packetId) {
+  const char* name = packetId ? "frames/packet_id" : "frames";
+  HostBThome api;
+  api.setPacketId(packetId);
+  BtHomeV2Device patched("test", "test", false);
+  uint8_t expected[MAX_ADVERTISEMENT_SIZE];
+  uint8_t actual[MAX_ADVERTISEMENT_SIZE];
+  for (int round = 0; round < ROUNDS; round++) {
+    addStation(api, round);
+    size_t frames = api.plan();
+    size_t frame = round / 5 % frames;  // A few updates per frame
+    size_t actualSize = api.encodeFrame(patched, frame, actual, false);
+
+    HostBThome reference;
+    reference.setPacketId(packetId);
+    addStation(reference, round);
+    reference.plan();
+    BtHomeV2Device fresh("test", "test", false);
+    fresh.setPacketIdEnabled(packetId);
+    fresh.setPacketId(patched.getPacketId() - 1);
+    size_t expectedSize = reference.encodeFrame(fresh, frame, expected, false);
+    if (!same(name, round, expected, expectedSize, actual, actualSize)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int main() {
+  bool ok = checkDevice(false) && checkDevice(true) && checkFrames(false) &&
+            checkFrames(true);
+  return ok ? 0 : 1;
+}
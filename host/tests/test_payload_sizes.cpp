@@ -0,0 +1,122 @@
+/**
+ * @file test_payload_sizes.cpp
+ * @brief Encoders and schemas at 31, 191 and 255 byte advertisements.
+ *
+ * Fills BasicBtHomeV2Device<Size> with temperatures until it refuses more,
+ * with and without encryption, and checks that the advertisement fits into
+ * Size bytes, the measurement arena was used up, only the refused object
+ * counts as dropped and every value decodes in order. A BasicBtHomeSchema
+ * that only fits from 191 bytes on must build the same service data as the
+ * device. Exits with status 1 on a mismatch. Run by ctest.
+ */
+
+#include <BtHomeDecoder.h>
+#include <BtHomeSchema.h>
+#include <BtHomeV2Device.h>
+
+static const uint8_t KEY[BIND_KEY_LEN] = {
+    0x23, 0x1d, 0x39, 0xc1, 0xd7, 0xcc, 0x1a, 0xb1,
+    0xae, 0xe2, 0x24, 0xcd, 0x09, 0x6d, 0xb9, 0x32};
+static const uint8_t MAC[BLE_MAC_ADDRESS_LENGTH] = {0x54, 0x48, 0xE6,
+                                                    0x8F, 0x80, 0xA5};
+/// Object id and value bytes of a 0.01 °C temperature.
+static const size_t TEMPERATURE_SIZE = 3;
+
+template <size_t Size>
+static bool checkDevice(bool encrypted) {
+  typedef BasicBtHomeV2Device<Size> Device;
+  Device plain("test", "test", false);
+  Device secure("test", "test", false, KEY, MAC);
+  Device& device = encrypted ? secure : plain;
+  size_t added = 0;
+  while (device.addTemperature_neg327_to_327_Resolution_0_01(added * 0.07f)) {
+    added++;
+  }
+  uint8_t buffer[Size];
+  size_t length = device.getAdvertisementData(buffer);
+
+  size_t room = Device::MEASUREMENT_CAPACITY -
+                (encrypted ? ENCRYPTION_ADDITIONAL_BYTES : 0);
+  // Only the refused temperature counts as dropped, not a packet id probe
+  bool idFits = room - added * TEMPERATURE_SIZE >= PACKET_ID_SIZE;
+  bool dropsOk = device.getStats().droppedObjects == 1 &&
+                 device.setPacketIdEnabled(true) == idFits &&
+                 device.getStats().droppedObjects == 1;
+  device.setPacketIdEnabled(false);
+
+  BtHomeServiceData serviceData;
+  bool ok = dropsOk && length > 0 && length <= Size &&
+            added == room / TEMPERATURE_SIZE &&
+            BtHomeServiceData::fromAdvertisement(buffer, length, serviceData) &&
+            serviceData.isEncrypted() == encrypted;
+  if (ok && encrypted) {
+    ok = serviceData.payloadLength() ==
+         added * TEMPERATURE_SIZE + ENCRYPTION_TRAILER_SIZE;
+  } else if (ok) {
+    size_t index = 0;
+    for (BtHomeObjectIterator it = serviceData.begin();
+         it != serviceData.end(); ++it, index++) {
+      ok &= it->id == temperature_int16_scale_0_01.id &&
+            it->rawValue() == static_cast<int64_t>(index * 7);
+    }
+    ok &= index == added;
+  }
+  if (!ok) {
+    fprintf(stderr, "%zu byte %s device: %zu objects in %zu bytes\n", Size,
+            encrypted ? "encrypted" : "plain", added, length);
+  }
+  return ok;
+}
+
+/// Eight energy readings: 56 bytes, too large for a legacy advertisement.
+typedef BasicBtHomeSchema<
+    191, false, BTHOME_FIELD(energy_uint32), BTHOME_FIELD(energy_uint32),
+    BTHOME_FIELD(energy_uint32), BTHOME_FIELD(energy_uint32),
+    BTHOME_FIELD(energy_uint32), BTHOME_FIELD(energy_uint32),
+    BTHOME_FIELD(energy_uint32), BTHOME_FIELD(energy_uint32)>
+    MeterSchema;
+
+template <size_t Index>
+static void setMeter(MeterSchema& schema, BasicBtHomeV2Device<191>& device) {
+  uint32_t value = 100000 * (Index + 1) + 17;
+  uint8_t bytes[4] = {static_cast<uint8_t>(value),
+                      static_cast<uint8_t>(value >> 8),
+                      static_cast<uint8_t>(value >> 16),
+                      static_cast<uint8_t>(value >> 24)};
+  schema.set<Index>(value);
+  device.addEncoded(energy_uint32.id, bytes, sizeof(bytes));
+}
+
+static bool checkSchema() {
+  static_assert(MeterSchema::PACKET_SIZE > MAX_ADVERTISEMENT_SIZE,
+                "The meter schema must need more than a legacy packet");
+  MeterSchema schema;
+  BasicBtHomeV2Device<191> device("test", "test", false);
+  setMeter<0>(schema, device);
+  setMeter<1>(schema, device);
+  setMeter<2>(schema, device);
+  setMeter<3>(schema, device);
+  setMeter<4>(schema, device);
+  setMeter<5>(schema, device);
+  setMeter<6>(schema, device);
+  setMeter<7>(schema, device);
+  uint8_t buffer[191];
+  size_t length = device.getAdvertisementData(buffer);
+  // The device appends the names behind the service data of the schema
+  bool ok = length > schema.size() &&
+            memcmp(buffer, schema.data(), schema.size()) == 0;
+  if (!ok) {
+    fprintf(stderr, "191 byte schema differs from the device\n");
+  }
+  return ok;
+}
+
+int main() {
+  bool ok = checkDevice<MAX_ADVERTISEMENT_SIZE>(false) &&
+            checkDevice<MAX_ADVERTISEMENT_SIZE>(true) &&
+            checkDevice<191>(false) && checkDevice<191>(true) &&
+            checkDevice<MAX_EXTENDED_ADVERTISEMENT_SIZE>(false) &&
+            checkDevice<MAX_EXTENDED_ADVERTISEMENT_SIZE>(true) &&
+            checkSchema();
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,243 @@
+/**
+ * @file backlog.cpp
+ * @brief Simulates a gateway outage and the backfill from the backlog.
+ *
+ * Runs a sensor with a new temperature every --period ms through the
+ * updateRadio() and pollRadio() of BThomeV2Device, with a
+ * BtHomeBacklog of --bytes that takes a snapshot every --history ms. A
+ * gateway listens on the MockRadio except between --outage-start and
+ * --outage-end. The tool prints how many snapshots were taken during the
+ * outage and how many of them the gateway received afterwards, the
+ * snapshots overwritten, the share of live advertising events and the
+ * longest time from a new reading until it was on air:
+ *
+ *   bthome_backlog --bytes 512 --history 60000 --outage-start 600000
+ *                  --outage-end 1800000
+ *
+ * It exits with status 1 if a replayed snapshot does not carry the reading
+ * of its timestamp, a new reading waits for a replay slot, or, with
+ * unlimited replays, a snapshot of the outage is missing although the ring
+ * holds the outage and the replays catch up with the new snapshots.
+ *
+ * Usage: bthome_backlog [--period MS] [--history MS] [--bytes N]
+ *                       [--replays N] [--duration MS] [--outage-start MS]
+ *                       [--outage-end MS]
+ */
+
+#include <BThomeV2.h>
+#include <BtHomeDecoder.h>
+#include <BtHomeV2Device.h>
+#include <MockRadio.h>
+#include <stdlib.h>
+
+#include <set>
+
+static const uint32_t EPOCH = 1700000000;
+static const uint32_t LOOP_MS = 10;
+static const size_t MAX_BYTES = 8192;
+
+/// BThomeV2Device on a MockRadio: the shared updateRadio() and pollRadio()
+/// with the time passed in.
+class SimulatedSensor : public BThomeV2 {
+ public:
+  explicit SimulatedSensor(MockRadio& radio) : _radio(radio) {
+    createEncoder("sim");
+  }
+
+  bool begin(const char*) override { return true; }
+  void end() override {}
+  bool startAdvertising() override { return true; }
+  void stopAdvertising() override { stopRadio(_radio); }
+  bool setMAC(const uint8_t[6]) override { return false; }
+
+  using BThomeV2::setClock;
+
+  void update(uint32_t now) { updateRadio(_radio, now); }
+  void poll(uint32_t now) { pollRadio(_radio, now); }
+
+ private:
+  MockRadio& _radio;
+};
+
+struct Options {
+  uint32_t period = 5000;
+  uint32_t history = 60000;
+  uint32_t bytes = DEFAULT_BACKLOG_BYTES;
+  uint32_t replays = BtHomeBacklog::DEFAULT_REPLAYS;
+  uint32_t duration = 3600000;
+  uint32_t outageStart = 600000;
+  uint32_t outageEnd = 1800000;
+};
+
+/// What the gateway saw.
+struct Gateway {
+  const Options* options;
+  std::set<uint32_t> recovered;  // Outage snapshots received afterwards
+  uint32_t liveEvents;
+  uint32_t replayEvents;
+  uint32_t mismatches;
+  uint32_t lastReading;  // Newest live reading received, plus one
+  uint64_t maxLatencyUs;
+};
+
+/// @brief Temperature of reading k: k hundredths of a degree.
+static int64_t readingValue(uint32_t reading) { return reading % 30000; }
+
+static void onEvent(void* context, uint64_t time, const uint8_t[6],
+                    const uint8_t* data, size_t size) {
+  Gateway& gateway = *static_cast<Gateway*>(context);
+  const Options& options = *gateway.options;
+  BtHomeServiceData serviceData;
+  BtHomeObject temperature;
+  if (!BtHomeServiceData::fromAdvertisement(data, size, serviceData) ||
+      !serviceData.find(0x02, temperature)) {
+    gateway.mismatches++;
+    return;
+  }
+  BtHomeObject timestamp;
+  bool replay = serviceData.find(TIMESTAMP_OBJECT_ID, timestamp);
+  gateway.replayEvents += replay ? 1 : 0;
+  gateway.liveEvents += replay ? 0 : 1;
+
+  uint32_t now = static_cast<uint32_t>(time / 1000);
+  if (replay) {
+    // The snapshot holds the reading of the time in its timestamp
+    uint32_t taken = static_cast<uint32_t>(timestamp.rawValue()) - EPOCH;
+    uint32_t reading = taken * 1000 / options.period;
+    if (temperature.rawValue() != readingValue(reading)) {
+      gateway.mismatches++;
+    }
+    bool inOutage = now >= options.outageStart && now < options.outageEnd;
+    bool takenInOutage = taken * 1000 >= options.outageStart &&
+                         taken * 1000 < options.outageEnd;
+    if (!inOutage && takenInOutage) {
+      gateway.recovered.insert(taken);
+    }
+    return;
+  }
+  // First event of a new reading
+  uint32_t reading = now / options.period;
+  if (temperature.rawValue() == readingValue(reading) &&
+      reading + 1 > gateway.lastReading) {
+    gateway.lastReading = reading + 1;
+    uint64_t latency = time - static_cast<uint64_t>(reading) *
+                                  options.period * 1000;
+    if (latency > gateway.maxLatencyUs) {
+      gateway.maxLatencyUs = latency;
+    }
+  }
+}
+
+static bool parse(int argc, char** argv, Options& options) {
+  for (int i = 1; i < argc; i++) {
+    bool hasValue = i + 1 < argc;
+    uint32_t* target = nullptr;
+    if (strcmp(argv[i], "--period") == 0) {
+      target = &options.period;
+    } else if (strcmp(argv[i], "--history") == 0) {
+      target = &options.history;
+    } else if (strcmp(argv[i], "--bytes") == 0) {
+      target = &options.bytes;
+    } else if (strcmp(argv[i], "--replays") == 0) {
+      target = &options.replays;
+    } else if (strcmp(argv[i], "--duration") == 0) {
+      target = &options.duration;
+    } else if (strcmp(argv[i], "--outage-start") == 0) {
+      target = &options.outageStart;
+    } else if (strcmp(argv[i], "--outage-end") == 0) {
+      target = &options.outageEnd;
+    }
+    if (!target || !hasValue) {
+      return false;
+    }
+    *target = strtoul(argv[++i], nullptr, 10);
+  }
+  // Timestamps have whole seconds: readings must not share one
+  return options.period >= 1000 && options.period % 1000 == 0 &&
+         options.history % LOOP_MS == 0 && options.history > 0 &&
+         options.bytes > BtHomeBacklog::ENTRY_HEADER_SIZE &&
+         options.bytes <= MAX_BYTES && options.replays <= UINT8_MAX &&
+         options.outageStart <= options.outageEnd;
+}
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!parse(argc, argv, options)) {
+    fprintf(stderr,
+            "usage: %s [--period MS (n * 1000)] [--history MS] "
+            "[--bytes N (max %u)] [--replays N] [--duration MS] "
+            "[--outage-start MS] [--outage-end MS]\n",
+            argv[0], static_cast<unsigned>(MAX_BYTES));
+    return 1;
+  }
+
+  static uint8_t storage[MAX_BYTES];
+  BtHomeBacklog backlog(storage, options.bytes);
+  backlog.setReplays(static_cast<uint8_t>(options.replays));
+  Gateway gateway = {};
+  gateway.options = &options;
+  MockRadio radio;
+  radio.setListener(onEvent, &gateway);
+  SimulatedSensor sensor(radio);
+  sensor.setClock(EPOCH, 0);
+  sensor.setBacklog(&backlog, options.history);
+
+  size_t snapshotBytes = 0;
+  for (uint32_t now = 0; now < options.duration; now += LOOP_MS) {
+    radio.advanceTo(static_cast<uint64_t>(now) * 1000);
+    if (now % options.period == 0) {
+      sensor.clearMeasurements();
+      sensor.addObject(0x02, readingValue(now / options.period) / 100.0f);
+      sensor.addHumidity(50.0f);
+      sensor.update(now);
+    }
+    sensor.poll(now);
+    if (snapshotBytes == 0 && backlog.size() == 1) {
+      snapshotBytes = backlog.bytesUsed();
+    }
+  }
+
+  // Snapshots are taken at every multiple of --history
+  uint32_t outageSnapshots = 0;
+  for (uint32_t t = options.history; t < options.duration;
+       t += options.history) {
+    outageSnapshots += t >= options.outageStart && t < options.outageEnd;
+  }
+  // A round of replays, and the snapshots taken meanwhile
+  size_t ringSnapshots = snapshotBytes ? options.bytes / snapshotBytes : 0;
+  uint32_t slowMs = DEFAULT_ADVERTISING_POLICY.slowIntervalMs;
+  uint32_t roundMs = ringSnapshots * 2 * BThomeV2::REPLAY_EVENTS * slowMs;
+  uint32_t catchUp = roundMs / options.history + 1;
+  bool backfillExpected =
+      options.replays == 0 && outageSnapshots + catchUp <= ringSnapshots &&
+      options.outageEnd + 2 * roundMs <= options.duration;
+
+  uint32_t events = gateway.liveEvents + gateway.replayEvents;
+  printf(
+      "# ring_bytes snapshots outage recovered overwritten live_share "
+      "max_latency_ms\n");
+  printf("%12u %9u %6u %9u %11u %10.2f %14.1f\n", options.bytes,
+         static_cast<unsigned>(ringSnapshots), outageSnapshots,
+         static_cast<unsigned>(gateway.recovered.size()),
+         backlog.getOverwritten(),
+         events ? static_cast<double>(gateway.liveEvents) / events : 0.0,
+         gateway.maxLatencyUs / 1000.0);
+
+  bool ok = true;
+  if (gateway.mismatches > 0) {
+    fprintf(stderr, "%u events with a wrong or missing reading\n",
+            gateway.mismatches);
+    ok = false;
+  }
+  // A change starts a fast burst at once, replay slot or not
+  if (gateway.maxLatencyUs > DEFAULT_ADVERTISING_POLICY.fastIntervalMs * 1000) {
+    fprintf(stderr, "a new reading waited for a replay slot\n");
+    ok = false;
+  }
+  if (backfillExpected && gateway.recovered.size() != outageSnapshots) {
+    fprintf(stderr, "%u of %u outage snapshots recovered\n",
+            static_cast<unsigned>(gateway.recovered.size()), outageSnapshots);
+    ok = false;
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,611 @@
+/**
+ * @file fleet.cpp
+ * @brief Generates the advertising traffic of a virtual BTHome fleet.
+ *
+ * Simulates N sensors, each a BtHomeV2Device with a sensor mix (profile), a
+ * measurement interval with jitter, optional encryption and repeated
+ * advertising events, and writes their advertisements in time order as
+ * fast as the host can encode them, to load test gateways and loggers:
+ *
+ *   bthome_fleet --devices 100000 --duration 3600000 fleet.bin
+ *   bthome_fleet --devices 5000 --format btsnoop fleet.btsnoop
+ *   bthome_fleet --devices 1000000 --threads 16 --no-check
+ *
+ * Profiles (--mix name:weight[:interval_ms],...):
+ *   climate  temperature, humidity, battery          every 10 s
+ *   door     opening state, battery                  every 60 s
+ *   power    power, energy, voltage                  every 5 s
+ *   air      CO2, PM2.5, PM10, temperature           every 30 s
+ *
+ * Packet k of a device goes out at phase + k * interval plus up to --jitter
+ * ms, then --repeats times every --adv-interval ms plus an advDelay of up to
+ * 10 ms. Sensor i has the address A4:C1:38:xx:xx:xx with i in the low bytes
+ * and --encrypted percent of the sensors use a key derived from i.
+ *
+ * Simulated time is cut into batches. Every thread encodes the packets of
+ * its range of sensors for the next batch in time order (a heap of next
+ * events) while the main thread merges the previous batch of all threads,
+ * feeds it through a BtHomeReceiver (every first event must be a new
+ * packet, every repeat a duplicate) and writes it. The output is the same
+ * for any number of threads. Formats:
+ *
+ *   stream   "BTHFLEET" then per advertisement: time (us, uint64 LE),
+ *            address (6 bytes, most significant first), rssi (int8),
+ *            length (uint8), advertising data
+ *   btsnoop  H4 HCI LE Advertising Report events (Wireshark, btmon)
+ *
+ * Without an output file the traffic is only generated and checked. It
+ * exits with status 1 if the receiver check fails.
+ *
+ * Usage: bthome_fleet [--devices N] [--duration MS] [--mix SPEC]
+ *                     [--encrypted PERCENT] [--jitter MS] [--repeats N]
+ *                     [--adv-interval MS] [--threads N] [--seed N]
+ *                     [--format stream|btsnoop] [--no-check] [output]
+ */
+
+#include <BtHomeReceiver.h>
+#include <BtHomeV2Device.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <queue>
+#include <thread>
+#include <vector>
+
+static const uint32_t MAX_DEVICES = 1u << 20;
+static const uint32_t MAX_PROFILES = 8;
+static const uint32_t ADV_DELAY_US = 10000;
+/// Advertisements a batch aims for, to keep the threads busy.
+static const uint64_t BATCH_EVENTS = 65536;
+/// Unix time of the first event in btsnoop files.
+static const uint64_t START_SECONDS = 1700000000;
+/// Microseconds from 0 AD to the unix epoch, as btsnoop counts.
+static const uint64_t BTSNOOP_EPOCH_DELTA_US = 0x00dcddb30f2f8000ull;
+
+typedef BasicBtHomeReceiver<65536> FleetReceiver;
+
+struct Profile {
+  const char* name;
+  uint32_t intervalMs;
+  void (*fill)(BtHomeV2Device& device, uint32_t sequence);
+};
+
+// Every profile changes its first object with every packet, so receivers
+// see a new packet each time
+
+static void fillClimate(BtHomeV2Device& device, uint32_t sequence) {
+  device.addTemperature_neg327_to_327_Resolution_0_01(18.0f +
+                                                      sequence % 500 / 100.0f);
+  device.addHumidityPercent_Resolution_0_01(40.0f + sequence % 30);
+  device.addBatteryPercentage(100 - sequence / 1000 % 100);
+}
+
+static void fillDoor(BtHomeV2Device& device, uint32_t sequence) {
+  device.setOpeningState(sequence % 2 ? Opening_Sensor_Status_Open
+                                      : Opening_Sensor_Status_Closed);
+  device.addBatteryPercentage(100 - sequence / 1000 % 100);
+}
+
+static void fillPower(BtHomeV2Device& device, uint32_t sequence) {
+  device.addPower_0_to_167772_resolution_0_01(100.0f + sequence % 1000 / 10.0f);
+  device.addEnergyKwh_0_to_16777(sequence % 10000000 / 1000.0f);
+  device.addVoltage_0_to_6550_resolution_0_1(230.0f + sequence % 20 / 10.0f);
+}
+
+static void fillAir(BtHomeV2Device& device, uint32_t sequence) {
+  device.addCo2Ppm(400 + sequence % 1000);
+  device.addPm2_5UgM3(sequence % 50);
+  device.addPm10UgM3(sequence % 80);
+  device.addTemperature_neg327_to_327_Resolution_0_01(21.0f);
+}
+
+static const Profile PROFILES[] = {{"climate", 10000, fillClimate},
+                                   {"door", 60000, fillDoor},
+                                   {"power", 5000, fillPower},
+                                   {"air", 30000, fillAir}};
+
+struct MixEntry {
+  const Profile* profile;
+  uint32_t weight;
+  uint32_t intervalMs;
+};
+
+struct Options {
+  uint32_t devices = 1000;
+  uint32_t duration = 600000;
+  MixEntry mix[MAX_PROFILES];
+  uint32_t mixCount = 0;
+  uint32_t encrypted = 50;
+  uint32_t jitter = 1000;
+  uint32_t repeats = 1;
+  uint32_t advInterval = 100;
+  uint32_t threads = 0;
+  uint32_t seed = 1;
+  bool btsnoop = false;
+  bool check = true;
+  const char* output = nullptr;
+};
+
+/// @brief splitmix64: per-sensor random numbers, the same for any thread
+/// count.
+static uint64_t nextRandom(uint64_t& state) {
+  uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return z ^ (z >> 31);
+}
+
+struct Sensor {
+  BtHomeV2Device* device;
+  const MixEntry* mix;
+  uint64_t random;
+  uint64_t phaseUs;
+  uint64_t packetUs;  // First event of the current packet
+  uint32_t sequence;
+  uint8_t repeat;
+  int8_t rssi;
+  bool encrypted;
+  uint8_t length;
+  uint8_t data[MAX_ADVERTISEMENT_SIZE];
+};
+
+/// One advertising event.
+struct Record {
+  uint64_t timeUs;
+  uint32_t sensor;
+  uint8_t repeat;
+  int8_t rssi;
+  uint8_t length;
+  uint8_t data[MAX_ADVERTISEMENT_SIZE];
+};
+
+struct Event {
+  uint64_t timeUs;
+  uint32_t sensor;
+  bool operator>(const Event& other) const {
+    return timeUs != other.timeUs ? timeUs > other.timeUs
+                                  : sensor > other.sensor;
+  }
+};
+
+typedef std::priority_queue<Event, std::vector<Event>, std::greater<Event> >
+    EventQueue;
+
+/// Sensors [first, last) and their pending events, owned by one thread.
+struct Worker {
+  uint32_t first;
+  uint32_t last;
+  EventQueue events;
+  std::vector<Record> batches[2];
+};
+
+static void fleetAddress(uint32_t index, uint8_t address[6]) {
+  // Shared vendor prefix, like a batch of identical sensors
+  address[0] = 0xA4;
+  address[1] = 0xC1;
+  address[2] = 0x38;
+  address[3] = (index >> 16) & 0xFF;
+  address[4] = (index >> 8) & 0xFF;
+  address[5] = index & 0xFF;
+}
+
+static uint64_t packetTime(Sensor& sensor, const Options& options) {
+  uint64_t jitterUs =
+      options.jitter ? nextRandom(sensor.random) % (options.jitter * 1000ull)
+                     : 0;
+  return sensor.phaseUs +
+         static_cast<uint64_t>(sensor.sequence) * sensor.mix->intervalMs *
+             1000 +
+         jitterUs;
+}
+
+static void createSensor(Sensor& sensor, uint32_t index,
+                         const Options& options) {
+  sensor.random = (static_cast<uint64_t>(options.seed) << 32) ^ index;
+  uint32_t totalWeight = 0;
+  for (uint32_t m = 0; m < options.mixCount; m++) {
+    totalWeight += options.mix[m].weight;
+  }
+  uint32_t pick = nextRandom(sensor.random) % totalWeight;
+  sensor.mix = &options.mix[0];
+  for (uint32_t m = 0; m < options.mixCount; m++) {
+    if (pick < options.mix[m].weight) {
+      sensor.mix = &options.mix[m];
+      break;
+    }
+    pick -= options.mix[m].weight;
+  }
+  sensor.encrypted = nextRandom(sensor.random) % 100 < options.encrypted;
+  sensor.rssi = -40 - static_cast<int8_t>(nextRandom(sensor.random) % 55);
+
+  char name[12];
+  snprintf(name, sizeof(name), "s%05u", index % 100000);
+  if (sensor.encrypted) {
+    uint8_t key[BIND_KEY_LEN];
+    for (size_t k = 0; k < BIND_KEY_LEN; k++) {
+      key[k] = static_cast<uint8_t>(index * 131 + k);
+    }
+    uint8_t address[6];
+    uint8_t reversed[BLE_MAC_ADDRESS_LENGTH];
+    fleetAddress(index, address);
+    for (size_t b = 0; b < BLE_MAC_ADDRESS_LENGTH; b++) {
+      reversed[b] = address[BLE_MAC_ADDRESS_LENGTH - 1 - b];
+    }
+    sensor.device = new BtHomeV2Device(name, name, false, key, reversed);
+  } else {
+    sensor.device = new BtHomeV2Device(name, name, false);
+    sensor.device->setPacketIdEnabled(true);
+  }
+  sensor.phaseUs =
+      nextRandom(sensor.random) % (sensor.mix->intervalMs * 1000ull);
+  sensor.sequence = 0;
+  sensor.repeat = 0;
+  sensor.packetUs = packetTime(sensor, options);
+}
+
+/// @brief Encodes the events of worker before endUs into batch, in time
+/// order.
+static void runBatch(Worker& worker, std::vector<Sensor>& sensors,
+                     const Options& options, uint64_t endUs,
+                     std::vector<Record>& batch) {
+  batch.clear();
+  while (!worker.events.empty() && worker.events.top().timeUs < endUs) {
+    Event event = worker.events.top();
+    worker.events.pop();
+    Sensor& sensor = sensors[event.sensor];
+    if (sensor.repeat == 0) {
+      sensor.device->clearMeasurementData();
+      sensor.mix->profile->fill(*sensor.device, sensor.sequence);
+      sensor.length = static_cast<uint8_t>(
+          sensor.device->getAdvertisementData(sensor.data));
+    }
+    batch.resize(batch.size() + 1);
+    Record& record = batch.back();
+    record.timeUs = event.timeUs;
+    record.sensor = event.sensor;
+    record.repeat = sensor.repeat;
+    record.rssi = static_cast<int8_t>(sensor.rssi -
+                                      nextRandom(sensor.random) % 6);
+    record.length = sensor.length;
+    memcpy(record.data, sensor.data, sensor.length);
+
+    if (++sensor.repeat < options.repeats) {
+      event.timeUs = sensor.packetUs +
+                     sensor.repeat * options.advInterval * 1000ull +
+                     nextRandom(sensor.random) % ADV_DELAY_US;
+    } else {
+      sensor.repeat = 0;
+      sensor.sequence++;
+      sensor.packetUs = packetTime(sensor, options);
+      event.timeUs = sensor.packetUs;
+    }
+    worker.events.push(event);
+  }
+}
+
+static void putBigEndian(std::vector<uint8_t>& out, uint64_t value,
+                         int bytes) {
+  for (int i = bytes - 1; i >= 0; i--) {
+    out.push_back((value >> (8 * i)) & 0xFF);
+  }
+}
+
+static void appendStream(std::vector<uint8_t>& out, const Record& record) {
+  for (int i = 0; i < 8; i++) {
+    out.push_back((record.timeUs >> (8 * i)) & 0xFF);
+  }
+  uint8_t address[6];
+  fleetAddress(record.sensor, address);
+  out.insert(out.end(), address, address + 6);
+  out.push_back(static_cast<uint8_t>(record.rssi));
+  out.push_back(record.length);
+  out.insert(out.end(), record.data, record.data + record.length);
+}
+
+/// @brief One HCI LE Advertising Report event (ADV_NONCONN_IND) as a
+/// received btsnoop record.
+static void appendBtsnoop(std::vector<uint8_t>& out, const Record& record) {
+  uint32_t parameters = 12 + record.length;
+  uint32_t packetLength = 3 + parameters;  // H4 type and event header
+  putBigEndian(out, packetLength, 4);      // Original length
+  putBigEndian(out, packetLength, 4);      // Included length
+  putBigEndian(out, 3, 4);                 // Received event
+  putBigEndian(out, 0, 4);                 // Cumulative drops
+  putBigEndian(out,
+               BTSNOOP_EPOCH_DELTA_US + START_SECONDS * 1000000 +
+                   record.timeUs,
+               8);
+  out.push_back(0x04);  // H4 event
+  out.push_back(0x3E);  // LE Meta
+  out.push_back(static_cast<uint8_t>(parameters));
+  out.push_back(0x02);  // LE Advertising Report
+  out.push_back(0x01);  // One report
+  out.push_back(0x03);  // ADV_NONCONN_IND
+  out.push_back(0x00);  // Public address
+  uint8_t address[6];
+  fleetAddress(record.sensor, address);
+  for (int i = 5; i >= 0; i--) {
+    out.push_back(address[i]);  // Least significant byte first
+  }
+  out.push_back(record.length);
+  out.insert(out.end(), record.data, record.data + record.length);
+  out.push_back(static_cast<uint8_t>(record.rssi));
+}
+
+static bool parseMix(const char* text, Options& options) {
+  options.mixCount = 0;
+  while (*text) {
+    const char* end = strchr(text, ',');
+    size_t length = end ? static_cast<size_t>(end - text) : strlen(text);
+    char item[32];
+    if (length >= sizeof(item) || options.mixCount == MAX_PROFILES) {
+      return false;
+    }
+    memcpy(item, text, length);
+    item[length] = '\0';
+    char* weight = strchr(item, ':');
+    char* interval = weight ? strchr(weight + 1, ':') : nullptr;
+    if (weight) {
+      *weight++ = '\0';
+    }
+    if (interval) {
+      *interval++ = '\0';
+    }
+    MixEntry& entry = options.mix[options.mixCount];
+    entry.profile = nullptr;
+    for (const Profile& profile : PROFILES) {
+      if (strcmp(item, profile.name) == 0) {
+        entry.profile = &profile;
+      }
+    }
+    if (!entry.profile) {
+      return false;
+    }
+    entry.weight = weight ? strtoul(weight, nullptr, 10) : 1;
+    entry.intervalMs =
+        interval ? strtoul(interval, nullptr, 10) : entry.profile->intervalMs;
+    if (entry.weight == 0 || entry.intervalMs == 0) {
+      return false;
+    }
+    options.mixCount++;
+    text += length;
+    if (*text == ',') {
+      text++;
+    }
+  }
+  return options.mixCount > 0;
+}
+
+static bool parse(int argc, char** argv, Options& options) {
+  parseMix("climate:4,door:2,power:1,air:1", options);
+  for (int i = 1; i < argc; i++) {
+    bool hasValue = i + 1 < argc;
+    uint32_t* target = nullptr;
+    if (strcmp(argv[i], "--devices") == 0) {
+      target = &options.devices;
+    } else if (strcmp(argv[i], "--duration") == 0) {
+      target = &options.duration;
+    } else if (strcmp(argv[i], "--encrypted") == 0) {
+      target = &options.encrypted;
+    } else if (strcmp(argv[i], "--jitter") == 0) {
+      target = &options.jitter;
+    } else if (strcmp(argv[i], "--repeats") == 0) {
+      target = &options.repeats;
+    } else if (strcmp(argv[i], "--adv-interval") == 0) {
+      target = &options.advInterval;
+    } else if (strcmp(argv[i], "--threads") == 0) {
+      target = &options.threads;
+    } else if (strcmp(argv[i], "--seed") == 0) {
+      target = &options.seed;
+    } else if (strcmp(argv[i], "--mix") == 0 && hasValue) {
+      if (!parseMix(argv[++i], options)) {
+        return false;
+      }
+      continue;
+    } else if (strcmp(argv[i], "--format") == 0 && hasValue) {
+      i++;
+      options.btsnoop = strcmp(argv[i], "btsnoop") == 0;
+      if (!options.btsnoop && strcmp(argv[i], "stream") != 0) {
+        return false;
+      }
+      continue;
+    } else if (strcmp(argv[i], "--no-check") == 0) {
+      options.check = false;
+      continue;
+    } else if (argv[i][0] != '-' && !options.output) {
+      options.output = argv[i];
+      continue;
+    }
+    if (!target || !hasValue) {
+      return false;
+    }
+    *target = strtoul(argv[++i], nullptr, 10);
+  }
+  if (options.threads == 0) {
+    options.threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  // A packet and its repeats are out before the next one
+  for (uint32_t m = 0; m < options.mixCount; m++) {
+    uint64_t busyUs = options.jitter * 1000ull +
+                      options.repeats * (options.advInterval * 1000ull +
+                                         ADV_DELAY_US);
+    if (busyUs >= options.mix[m].intervalMs * 1000ull) {
+      return false;
+    }
+  }
+  return options.devices > 0 && options.devices <= MAX_DEVICES &&
+         options.encrypted <= 100 && options.repeats > 0 &&
+         options.repeats <= UINT8_MAX && options.threads <= 256;
+}
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!parse(argc, argv, options)) {
+    fprintf(stderr,
+            "usage: %s [--devices 1-%u] [--duration MS] "
+            "[--mix name:weight[:interval_ms],...] [--encrypted PERCENT] "
+            "[--jitter MS] [--repeats N] [--adv-interval MS] [--threads N] "
+            "[--seed N] [--format stream|btsnoop] [--no-check] [output]\n"
+            "jitter + repeats * (adv-interval + 10) must be below every "
+            "interval; profiles: climate door power air\n",
+            argv[0], MAX_DEVICES);
+    return 1;
+  }
+  if (options.check && options.devices > FleetReceiver::MAX_DEVICES) {
+    fprintf(stderr, "check needs at most %u devices, use --no-check\n",
+            static_cast<unsigned>(FleetReceiver::MAX_DEVICES));
+    return 1;
+  }
+  FILE* output = nullptr;
+  if (options.output) {
+    output = fopen(options.output, "wb");
+    if (!output) {
+      perror(options.output);
+      return 1;
+    }
+  }
+
+  std::vector<Sensor> sensors(options.devices);
+  double eventsPerMs = 0;
+  uint32_t encryptedSensors = 0;
+  for (uint32_t i = 0; i < options.devices; i++) {
+    createSensor(sensors[i], i, options);
+    eventsPerMs +=
+        static_cast<double>(options.repeats) / sensors[i].mix->intervalMs;
+    encryptedSensors += sensors[i].encrypted ? 1 : 0;
+  }
+  uint32_t threadCount = std::min(options.threads, options.devices);
+  std::vector<Worker> workers(threadCount);
+  for (uint32_t t = 0; t < threadCount; t++) {
+    Worker& worker = workers[t];
+    worker.first = static_cast<uint64_t>(options.devices) * t / threadCount;
+    worker.last =
+        static_cast<uint64_t>(options.devices) * (t + 1) / threadCount;
+    for (uint32_t i = worker.first; i < worker.last; i++) {
+      worker.events.push(Event{sensors[i].packetUs, i});
+    }
+  }
+  uint64_t batchUs = static_cast<uint64_t>(
+      std::max(100.0, BATCH_EVENTS / std::max(eventsPerMs, 1e-9)) * 1000);
+  uint64_t durationUs = options.duration * 1000ull;
+
+  std::vector<uint8_t> bytes;
+  if (output && options.btsnoop) {
+    static const uint8_t HEADER[16] = {'b', 't', 's', 'n', 'o', 'o', 'p', 0,
+                                       0,   0,   0,   1,   0,   0,   0x03,
+                                       0xEA};  // Version 1, H4 (1002)
+    fwrite(HEADER, 1, sizeof(HEADER), output);
+  } else if (output) {
+    fwrite("BTHFLEET", 1, 8, output);
+  }
+
+  FleetReceiver* receiver = options.check ? new FleetReceiver() : nullptr;
+  // Generation only, without creating the sensors
+  auto start = std::chrono::steady_clock::now();
+  uint64_t advertisements = 0;
+  uint64_t written = 0;
+  uint64_t lastTimeUs = 0;
+  uint32_t failures = 0;
+  // Merges the batch of all workers in time order, checks and writes it
+  auto drain = [&](int slot) {
+    std::vector<size_t> next(threadCount, 0);
+    bytes.clear();
+    while (true) {
+      const Record* earliest = nullptr;
+      uint32_t from = 0;
+      for (uint32_t t = 0; t < threadCount; t++) {
+        const std::vector<Record>& batch = workers[t].batches[slot];
+        if (next[t] < batch.size() &&
+            (!earliest || batch[next[t]].timeUs < earliest->timeUs)) {
+          earliest = &batch[next[t]];
+          from = t;
+        }
+      }
+      if (!earliest) {
+        break;
+      }
+      next[from]++;
+      const Record& record = *earliest;
+      advertisements++;
+      if (record.timeUs < lastTimeUs) {
+        failures++;
+      }
+      lastTimeUs = record.timeUs;
+      if (receiver) {
+        uint8_t address[6];
+        fleetAddress(record.sensor, address);
+        BtHomeReceiveResult result = receiver->process(
+            address, record.data, record.length, record.rssi,
+            static_cast<uint32_t>(record.timeUs / 1000));
+        bool expected = record.repeat == 0
+                            ? result == BtHome_Receive_New ||
+                                  result == BtHome_Receive_Updated
+                            : result == BtHome_Receive_Duplicate;
+        failures += expected ? 0 : 1;
+      }
+      if (output && options.btsnoop) {
+        appendBtsnoop(bytes, record);
+      } else if (output) {
+        appendStream(bytes, record);
+      }
+    }
+    if (output) {
+      fwrite(bytes.data(), 1, bytes.size(), output);
+      written += bytes.size();
+    }
+  };
+
+  // Workers encode batch n + 1 while the main thread drains batch n
+  int slot = 0;
+  bool pending = false;
+  for (uint64_t batchStart = 0; batchStart < durationUs;
+       batchStart += batchUs) {
+    uint64_t endUs = std::min(batchStart + batchUs, durationUs);
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < threadCount; t++) {
+      threads.push_back(std::thread(runBatch, std::ref(workers[t]),
+                                    std::ref(sensors), std::cref(options),
+                                    endUs,
+                                    std::ref(workers[t].batches[slot])));
+    }
+    if (pending) {
+      drain(1 - slot);
+    }
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+    pending = true;
+    slot = 1 - slot;
+  }
+  if (pending) {
+    drain(1 - slot);
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+
+  printf(
+      "# devices encrypted threads simulated_s advertisements bytes "
+      "wall_s adv_per_s realtime_x\n");
+  printf("%9u %9u %7u %11.1f %14llu %5llu %6.2f %9.0f %10.0f\n",
+         options.devices, encryptedSensors, threadCount,
+         options.duration / 1000.0,
+         static_cast<unsigned long long>(advertisements),
+         static_cast<unsigned long long>(written), seconds,
+         advertisements / seconds, options.duration / 1000.0 / seconds);
+
+  if (output) {
+    fclose(output);
+  }
+  delete receiver;
+  for (Sensor& sensor : sensors) {
+    delete sensor.device;
+  }
+  if (failures > 0) {
+    fprintf(stderr, "%u advertisements out of order or not new\n", failures);
+    return 1;
+  }
+  return 0;
+}
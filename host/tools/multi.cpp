@@ -0,0 +1,273 @@
+/**
+ * @file multi.cpp
+ * @brief Simulates a bridge advertising many identities on shared radios.
+ *
+ * Runs BtHomeMultiAdvertiser with N encrypted identities (own name, address,
+ * key and counter) on R MockRadios and prints per identity how often it went
+ * on air, the advertising events it got, the longest gap between two of its
+ * events, its deadline misses and the longest wait of a change:
+ *
+ *   bthome_multi --identities 12 --period 1500 --dwell 100
+ *   bthome_multi --identities 12 --radios 3 --spread 3 --change 700
+ *
+ * Identity i has the period --period * (1 + i % --spread) and new data
+ * every --change ms. It exits with status 1 if an event carries the payload
+ * of another identity than its address or a MIC that does not verify with
+ * the nonce of that address, if a deadline is missed by more than
+ * one dwell (the longest a running dwell blocks) although the radios have
+ * the time (sum of dwell / period and dwell / change per radio <= 1), or,
+ * without changes, if identities with the same period went on air more than
+ * once apart from each other.
+ *
+ * Usage: bthome_multi [--identities N] [--radios N] [--period MS]
+ *                     [--spread N] [--dwell MS] [--duration MS]
+ *                     [--change MS] [--interval UNITS]
+ */
+
+#include <BtHomeDecoder.h>
+#include <CcmBackend.h>
+#include <BtHomeMultiAdvertiser.h>
+#include <MockRadio.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+struct Options {
+  uint32_t identities = 12;
+  uint32_t radios = 1;
+  uint32_t period = 1500;
+  uint32_t spread = 1;
+  uint32_t dwell = BtHomeMultiAdvertiser::DEFAULT_DWELL_MS;
+  uint32_t duration = 60000;
+  uint32_t change = 0;
+  uint32_t interval = MIN_ADVERTISING_INTERVAL_UNITS;
+};
+
+struct Identity {
+  char name[12];
+  uint8_t key[BIND_KEY_LEN];
+  uint8_t address[6];
+  uint32_t period;
+  uint32_t events;
+  uint64_t lastEventUs;
+  uint64_t maxGapUs;
+};
+
+struct Simulation {
+  Identity identities[BtHomeIdentityScheduler::MAX_IDENTITIES];
+  size_t count;
+  uint32_t mismatches;
+};
+
+/// @brief Complete local name of an advertisement, nullptr if none.
+static const uint8_t* localName(const uint8_t* data, size_t size,
+                                size_t* length) {
+  for (size_t i = 0; i + 1 < size && data[i] != 0; i += data[i] + 1) {
+    if (data[i + 1] == COMPLETE_NAME && i + 1 + data[i] <= size) {
+      *length = data[i] - 1;
+      return data + i + 2;
+    }
+  }
+  return nullptr;
+}
+
+/// @brief MIC check of a receiver, whose nonce holds the address the packet
+/// came from. Encrypting the ciphertext again yields the plaintext (CTR
+/// mode), and encrypting that must reproduce the MIC.
+static bool validMic(const Identity& identity, const uint8_t address[6],
+                     const BtHomeServiceData& serviceData) {
+  if (serviceData.payloadLength() < ENCRYPTION_TRAILER_SIZE) {
+    return false;
+  }
+  size_t length = serviceData.payloadLength() - ENCRYPTION_TRAILER_SIZE;
+  const uint8_t* ciphertext = serviceData.payload();
+  const uint8_t* counter = ciphertext + length;
+  uint8_t nonce[CCM_NONCE_LENGTH];
+  memcpy(nonce, address, 6);
+  nonce[6] = UUID1;
+  nonce[7] = UUID2;
+  nonce[8] = ciphertext[-1];  // Device information byte
+  memcpy(&nonce[9], counter, COUNTER_LEN);
+
+  SoftwareCcm ccm;
+  ccm.setKey(identity.key);
+  uint8_t plaintext[MAX_EXTENDED_ADVERTISEMENT_SIZE];
+  uint8_t tag[CCM_TAG_LENGTH];
+  ccm.encrypt(nonce, ciphertext, length, plaintext, tag);
+  ccm.encrypt(nonce, plaintext, length, plaintext, tag);
+  return memcmp(tag, counter + COUNTER_LEN, CCM_TAG_LENGTH) == 0;
+}
+
+/// @brief Every event must carry the name of the identity its address
+/// belongs to, encrypted for that address.
+static void onEvent(void* context, uint64_t time, const uint8_t address[6],
+                    const uint8_t* data, size_t size) {
+  Simulation& simulation = *static_cast<Simulation*>(context);
+  for (size_t i = 0; i < simulation.count; i++) {
+    Identity& identity = simulation.identities[i];
+    if (memcmp(identity.address, address, 6) != 0) {
+      continue;
+    }
+    size_t length = 0;
+    const uint8_t* name = localName(data, size, &length);
+    BtHomeServiceData serviceData;
+    if (!name || length != strlen(identity.name) ||
+        memcmp(name, identity.name, length) != 0 ||
+        !BtHomeServiceData::fromAdvertisement(data, size, serviceData) ||
+        !serviceData.isEncrypted() ||
+        !validMic(identity, address, serviceData)) {
+      simulation.mismatches++;
+    }
+    uint64_t gap = time - identity.lastEventUs;
+    if (identity.events > 0 && gap > identity.maxGapUs) {
+      identity.maxGapUs = gap;
+    }
+    identity.events++;
+    identity.lastEventUs = time;
+    return;
+  }
+  simulation.mismatches++;
+}
+
+static bool parse(int argc, char** argv, Options& options) {
+  for (int i = 1; i < argc; i++) {
+    bool hasValue = i + 1 < argc;
+    uint32_t* target = nullptr;
+    if (strcmp(argv[i], "--identities") == 0) {
+      target = &options.identities;
+    } else if (strcmp(argv[i], "--radios") == 0) {
+      target = &options.radios;
+    } else if (strcmp(argv[i], "--period") == 0) {
+      target = &options.period;
+    } else if (strcmp(argv[i], "--spread") == 0) {
+      target = &options.spread;
+    } else if (strcmp(argv[i], "--dwell") == 0) {
+      target = &options.dwell;
+    } else if (strcmp(argv[i], "--duration") == 0) {
+      target = &options.duration;
+    } else if (strcmp(argv[i], "--change") == 0) {
+      target = &options.change;
+    } else if (strcmp(argv[i], "--interval") == 0) {
+      target = &options.interval;
+    }
+    if (!target || !hasValue) {
+      return false;
+    }
+    *target = strtoul(argv[++i], nullptr, 10);
+  }
+  return options.identities > 0 &&
+         options.identities <= BtHomeIdentityScheduler::MAX_IDENTITIES &&
+         options.radios > 0 &&
+         options.radios <= BtHomeMultiAdvertiser::MAX_RADIOS &&
+         options.period > 0 && options.spread > 0 && options.dwell > 0;
+}
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!parse(argc, argv, options)) {
+    fprintf(stderr,
+            "usage: %s [--identities 1-%u] [--radios 1-%u] [--period MS] "
+            "[--spread N] [--dwell MS] [--duration MS] [--change MS] "
+            "[--interval UNITS]\n",
+            argv[0], (unsigned)BtHomeIdentityScheduler::MAX_IDENTITIES,
+            (unsigned)BtHomeMultiAdvertiser::MAX_RADIOS);
+    return 1;
+  }
+
+  static Simulation simulation;
+  simulation.count = options.identities;
+  MockRadio radios[BtHomeMultiAdvertiser::MAX_RADIOS];
+  BtHomeMultiAdvertiser advertiser(options.dwell,
+                                   static_cast<uint16_t>(options.interval));
+  for (uint32_t r = 0; r < options.radios; r++) {
+    radios[r].setListener(onEvent, &simulation);
+    advertiser.addRadio(radios[r]);
+  }
+
+  // One encoder per identity, each with its own key and counter
+  static BtHomeV2Device* devices[BtHomeIdentityScheduler::MAX_IDENTITIES];
+  double utilization = 0;
+  for (size_t i = 0; i < simulation.count; i++) {
+    Identity& identity = simulation.identities[i];
+    snprintf(identity.name, sizeof(identity.name), "id%02u", (unsigned)i);
+    for (size_t k = 0; k < BIND_KEY_LEN; k++) {
+      identity.key[k] = static_cast<uint8_t>(i * 31 + k);
+    }
+    // Address as on air, most significant byte first; the device and
+    // addIdentity() take it least significant byte first
+    const uint8_t address[6] = {0xC0, 0xB7, 0x00, 0x00, 0x00,
+                                static_cast<uint8_t>(i)};
+    memcpy(identity.address, address, 6);
+    uint8_t mac[BLE_MAC_ADDRESS_LENGTH];
+    for (size_t b = 0; b < sizeof(mac); b++) {
+      mac[b] = address[sizeof(mac) - 1 - b];
+    }
+    identity.period = options.period * (1 + i % options.spread);
+    devices[i] = new BtHomeV2Device(identity.name, identity.name, false,
+                                    identity.key, mac);
+    devices[i]->addTemperature_neg327_to_327_Resolution_0_01(20.0f + i);
+    advertiser.addIdentity(*devices[i], mac, identity.period, 0);
+    utilization += static_cast<double>(options.dwell) / identity.period;
+    if (options.change > 0) {
+      utilization += static_cast<double>(options.dwell) / options.change;
+    }
+  }
+  utilization /= options.radios;
+
+  for (uint32_t now = 0; now < options.duration; now++) {
+    for (uint32_t r = 0; r < options.radios; r++) {
+      radios[r].advanceTo(static_cast<uint64_t>(now) * 1000);
+    }
+    if (options.change > 0) {
+      for (size_t i = 0; i < simulation.count; i++) {
+        // Spread the changes of the identities over the change period
+        if ((now + i * options.change / simulation.count) % options.change ==
+            0) {
+          devices[i]->clearMeasurementData();
+          devices[i]->addTemperature_neg327_to_327_Resolution_0_01(
+              20.0f + (now / options.change + i) % 50 / 10.0f);
+          advertiser.markChanged(i, now);
+        }
+      }
+    }
+    advertiser.poll(now);
+  }
+
+  printf("# utilization %.2f\n", utilization);
+  printf(
+      "# id period   aired  events max_gap_ms  misses max_late_ms "
+      "max_change_ms\n");
+  const BtHomeIdentityScheduler& scheduler = advertiser.scheduler();
+  bool ok = simulation.mismatches == 0;
+  for (size_t i = 0; i < simulation.count; i++) {
+    const Identity& identity = simulation.identities[i];
+    const BtHomeIdentityStats& stats = scheduler.getStats(i);
+    printf("%4u %6u %7u %7u %10.1f %7u %11u %13u\n", (unsigned)i,
+           identity.period, stats.aired, identity.events,
+           identity.maxGapUs / 1000.0, stats.misses, stats.maxLatenessMs,
+           stats.maxChangeMs);
+    if (utilization <= 1.0 && stats.maxLatenessMs > options.dwell) {
+      ok = false;
+    }
+    for (size_t j = 0; j < i && options.change == 0; j++) {
+      const BtHomeIdentityStats& other = scheduler.getStats(j);
+      uint32_t difference = stats.aired > other.aired
+                                ? stats.aired - other.aired
+                                : other.aired - stats.aired;
+      if (simulation.identities[j].period == identity.period &&
+          difference > 1) {
+        ok = false;
+      }
+    }
+  }
+  if (simulation.mismatches > 0) {
+    fprintf(stderr, "%u events with the payload of another identity\n",
+            simulation.mismatches);
+  }
+  if (!ok) {
+    fprintf(stderr, "scheduling check failed\n");
+  }
+  for (size_t i = 0; i < simulation.count; i++) {
+    delete devices[i];
+  }
+  return ok ? 0 : 1;
+}
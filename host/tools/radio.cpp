@@ -0,0 +1,138 @@
+/**
+ * @file radio.cpp
+ * @brief Compares payload swaps with advertiser restarts on a mock radio.
+ *
+ * Runs a sensor whose temperature changes every period through the
+ * updateRadio() and pollRadio() of BThomeV2Device, once on a MockRadio that
+ * swaps the payload of the running advertiser and once on one that has to
+ * restart for every new payload, and prints for both the stack round trips,
+ * the time off air, the longest silence between advertising events and the
+ * latency until a new payload is on air:
+ *
+ *   bthome_radio --period 500 --duration 60000 --command-us 800
+ *
+ * Usage: bthome_radio [--period MS] [--duration MS] [--loop MS]
+ *                     [--fast MS] [--slow MS] [--burst MS]
+ *                     [--command-us US] [--first-event-us US]
+ */
+
+#include <BThomeV2.h>
+#include <BtHomeV2Device.h>
+#include <MockRadio.h>
+#include <stdlib.h>
+
+/// BThomeV2Device on a MockRadio: the shared updateRadio() and pollRadio()
+/// with the time passed in.
+class SimulatedSensor : public BThomeV2 {
+ public:
+  explicit SimulatedSensor(MockRadio& radio) : _radio(radio) {
+    createEncoder("sim");
+  }
+
+  bool begin(const char*) override { return true; }
+  void end() override {}
+  bool startAdvertising() override { return true; }
+  void stopAdvertising() override { stopRadio(_radio); }
+  bool setMAC(const uint8_t[6]) override { return false; }
+
+  void update(uint32_t now) { updateRadio(_radio, now); }
+  void poll(uint32_t now) { pollRadio(_radio, now); }
+
+  /// @brief Advertisement of the current measurements.
+  size_t lastAdvertisement(uint8_t* data) {
+    return encodeFrame(*btHomeDevice, 0, data, false);
+  }
+
+ private:
+  MockRadio& _radio;
+};
+
+struct Options {
+  uint32_t period = 730;
+  uint32_t duration = 60000;
+  uint32_t loop = 10;
+  BtHomeAdvertisingPolicy policy = DEFAULT_ADVERTISING_POLICY;
+  uint32_t commandUs = 500;
+  uint32_t firstEventUs = 5000;
+};
+
+/// @return false if the radio does not end up sending the last payload
+static bool simulate(const char* name, bool canUpdate,
+                     const Options& options) {
+  MockRadio radio(canUpdate, options.commandUs, options.firstEventUs);
+  SimulatedSensor sensor(radio);
+  sensor.setAdvertisingPolicy(options.policy);
+  uint32_t changes = 0;
+  for (uint32_t now = 0; now < options.duration; now += options.loop) {
+    radio.advanceTo(static_cast<uint64_t>(now) * 1000);
+    if (now % options.period < options.loop) {
+      sensor.clearMeasurements();
+      sensor.addTemperature(20.0f + 0.1f * (changes++ % 100));
+      sensor.update(now);
+    } else {
+      sensor.poll(now);
+    }
+  }
+  radio.advanceTo(static_cast<uint64_t>(options.duration) * 1000);
+  radio.advanceTo(radio.now() + MAX_ADVERTISING_INTERVAL_UNITS * 625ull);
+
+  const MockRadio::Stats& stats = radio.stats();
+  printf("%-7s %7u %7u %7u %8u %8u %10.1f %14.1f %15.2f %14.2f\n", name,
+         changes, stats.starts, stats.updates, stats.commands, stats.events,
+         stats.offAirUs / 1000.0, stats.maxSilenceUs / 1000.0,
+         stats.delivered ? stats.latencyUs / 1000.0 / stats.delivered : 0.0,
+         stats.maxLatencyUs / 1000.0);
+
+  uint8_t last[MAX_ADVERTISEMENT_SIZE];
+  size_t size = sensor.lastAdvertisement(last);
+  if (radio.airSize() != size || memcmp(radio.airData(), last, size) != 0) {
+    fprintf(stderr, "%s: last payload not on air\n", name);
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    bool hasValue = i + 1 < argc;
+    uint32_t* target = nullptr;
+    if (strcmp(argv[i], "--period") == 0) {
+      target = &options.period;
+    } else if (strcmp(argv[i], "--duration") == 0) {
+      target = &options.duration;
+    } else if (strcmp(argv[i], "--loop") == 0) {
+      target = &options.loop;
+    } else if (strcmp(argv[i], "--fast") == 0) {
+      target = &options.policy.fastIntervalMs;
+    } else if (strcmp(argv[i], "--slow") == 0) {
+      target = &options.policy.slowIntervalMs;
+    } else if (strcmp(argv[i], "--burst") == 0) {
+      target = &options.policy.burstMs;
+    } else if (strcmp(argv[i], "--command-us") == 0) {
+      target = &options.commandUs;
+    } else if (strcmp(argv[i], "--first-event-us") == 0) {
+      target = &options.firstEventUs;
+    }
+    if (!target || !hasValue) {
+      fprintf(stderr,
+              "usage: %s [--period MS] [--duration MS] [--loop MS] "
+              "[--fast MS] [--slow MS] [--burst MS] [--command-us US] "
+              "[--first-event-us US]\n",
+              argv[0]);
+      return 1;
+    }
+    *target = strtoul(argv[++i], nullptr, 10);
+  }
+  if (options.period == 0 || options.loop == 0) {
+    fprintf(stderr, "period and loop must not be 0\n");
+    return 1;
+  }
+
+  printf(
+      "# path   changes  starts updates commands   events off_air_ms "
+      "max_silence_ms mean_latency_ms max_latency_ms\n");
+  bool swapOk = simulate("swap", true, options);
+  bool restartOk = simulate("restart", false, options);
+  return swapOk && restartOk ? 0 : 1;
+}
@@ -0,0 +1,134 @@
+/**
+ * @file replay.cpp
+ * @brief Feeds a recorded advertisement stream through BtHomeReceiver.
+ *
+ * Every line of the stream is one received advertisement:
+ *
+ *   <time ms> <AA:BB:CC:DD:EE:FF> <rssi> <advertising data as hex>
+ *
+ * Empty lines and lines starting with '#' are skipped. Stored packets are
+ * printed with their decoded objects, followed by the final device table and
+ * the receive counters, so gateway behaviour can be checked against
+ * captures without a radio.
+ *
+ * Usage: bthome_replay [--expire MS] [--quiet] stream.txt
+ */
+
+#include <BaseDevice.h>
+#include <BtHomeReceiver.h>
+#include <stdlib.h>
+
+static bool parseMac(const char* text, uint8_t mac[BLE_ADDRESS_LENGTH]) {
+  unsigned int bytes[BLE_ADDRESS_LENGTH];
+  if (sscanf(text, "%2x:%2x:%2x:%2x:%2x:%2x", &bytes[0], &bytes[1],
+             &bytes[2], &bytes[3], &bytes[4], &bytes[5]) != 6) {
+    return false;
+  }
+  for (uint8_t i = 0; i < BLE_ADDRESS_LENGTH; i++) {
+    mac[i] = bytes[i];
+  }
+  return true;
+}
+
+static size_t parseHex(const char* text, uint8_t* data, size_t capacity) {
+  size_t length = 0;
+  unsigned int byte;
+  while (length < capacity && sscanf(text, "%2x", &byte) == 1) {
+    data[length++] = byte;
+    text += 2;
+  }
+  return length;
+}
+
+static void printMac(const uint8_t mac[BLE_ADDRESS_LENGTH]) {
+  printf("%02X:%02X:%02X:%02X:%02X:%02X", mac[0], mac[1], mac[2], mac[3],
+         mac[4], mac[5]);
+}
+
+static void printEntry(const BtHomeReceiver::Entry& entry) {
+  printMac(entry.mac);
+  printf(" rssi %d", entry.rssi);
+  BtHomeServiceData serviceData = entry.serviceData();
+  if (serviceData.isEncrypted()) {
+    printf(" encrypted counter %u", entry.counter);
+  }
+  for (const BtHomeObject& object : serviceData) {
+    if (object.isVariableLength()) {
+      printf(" 0x%02X[%u]", object.id, object.length);
+    } else {
+      printf(" 0x%02X=%g", object.id, object.value());
+    }
+  }
+  printf("\n");
+}
+
+static void onStored(const BtHomeReceiver::Entry& entry, void* context) {
+  const uint32_t* time = static_cast<const uint32_t*>(context);
+  printf("%u ", *time);
+  printEntry(entry);
+}
+
+int main(int argc, char** argv) {
+  const char* path = nullptr;
+  uint32_t maxAge = 0;
+  bool quiet = false;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--expire") == 0 && i + 1 < argc) {
+      maxAge = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--quiet") == 0) {
+      quiet = true;
+    } else {
+      path = argv[i];
+    }
+  }
+  FILE* stream = path ? fopen(path, "r") : nullptr;
+  if (!stream) {
+    fprintf(stderr, "usage: %s [--expire MS] [--quiet] stream.txt\n",
+            argv[0]);
+    return 1;
+  }
+
+  static BtHomeReceiver receiver;
+  uint32_t now = 0;
+  if (!quiet) {
+    receiver.setCallback(onStored, &now);
+  }
+
+  char line[1024];
+  size_t lineNumber = 0;
+  while (fgets(line, sizeof(line), stream)) {
+    lineNumber++;
+    if (line[0] == '#' || line[0] == '\n' || line[0] == '\r') {
+      continue;
+    }
+    char macText[32];
+    char hex[600];
+    int rssi;
+    uint8_t mac[BLE_ADDRESS_LENGTH];
+    uint8_t data[MAX_EXTENDED_ADVERTISEMENT_SIZE];
+    if (sscanf(line, "%u %31s %d %599s", &now, macText, &rssi, hex) != 4 ||
+        !parseMac(macText, mac)) {
+      fprintf(stderr, "%s:%zu: cannot parse line\n", path, lineNumber);
+      continue;
+    }
+    size_t length = parseHex(hex, data, sizeof(data));
+    receiver.process(mac, data, length, rssi, now);
+    if (maxAge) {
+      receiver.expire(now, maxAge);
+    }
+  }
+  fclose(stream);
+
+  printf("# devices %zu\n", receiver.size());
+  receiver.forEach([](const BtHomeReceiver::Entry& entry) {
+    printf("# ");
+    printEntry(entry);
+  });
+  printf(
+      "# stored %u duplicate %u ignored %u malformed %u too_long %u "
+      "table_full %u\n",
+      receiver.getStoredCount(), receiver.getDuplicateCount(),
+      receiver.getIgnoredCount(), receiver.getMalformedCount(),
+      receiver.getTooLongCount(), receiver.getTableFullCount());
+  return 0;
+}
@@ -0,0 +1,114 @@
+/**
+ * @file schedule.cpp
+ * @brief Simulates BtHomeAdvertisingScheduler for a sequence of changes.
+ *
+ * Prints every interval change of the policy over the simulated time, then
+ * the advertising events and radio duty cycle compared with advertising at
+ * the fast or the slow interval all the time, so a policy can be tuned for
+ * battery life before it is flashed:
+ *
+ *   bthome_schedule --fast 100 --slow 2000 --burst 3000 --duration 600000 \
+ *       1000 60000 61000 300000
+ *
+ * Arguments after the options are the times (ms) at which a value changes.
+ * The air time of one advertising event defaults to a 31 byte legacy
+ * advertisement on the three primary channels.
+ *
+ * Usage: bthome_schedule [--fast MS] [--slow MS] [--burst MS]
+ *                        [--duration MS] [--airtime US] [CHANGE_MS...]
+ */
+
+#include <BtHomeAdvertisingScheduler.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <vector>
+
+// 47 bytes on the 1M PHY (376 us) on each of the three channels
+static const uint32_t LEGACY_EVENT_AIRTIME_US = 3 * 376;
+
+static void printInterval(uint32_t time,
+                          const BtHomeAdvertisingScheduler& scheduler) {
+  uint32_t interval = scheduler.getAppliedInterval();
+  printf("%u %u %u\n", time, interval,
+         BtHomeAdvertisingScheduler::toUnits(interval));
+}
+
+int main(int argc, char** argv) {
+  BtHomeAdvertisingPolicy policy = DEFAULT_ADVERTISING_POLICY;
+  uint32_t duration = 600000;
+  uint32_t airtime = LEGACY_EVENT_AIRTIME_US;
+  std::vector<uint32_t> changes;
+  for (int i = 1; i < argc; i++) {
+    bool hasValue = i + 1 < argc;
+    if (strcmp(argv[i], "--fast") == 0 && hasValue) {
+      policy.fastIntervalMs = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--slow") == 0 && hasValue) {
+      policy.slowIntervalMs = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--burst") == 0 && hasValue) {
+      policy.burstMs = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--duration") == 0 && hasValue) {
+      duration = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--airtime") == 0 && hasValue) {
+      airtime = strtoul(argv[++i], nullptr, 10);
+    } else if (argv[i][0] >= '0' && argv[i][0] <= '9') {
+      changes.push_back(strtoul(argv[i], nullptr, 10));
+    } else {
+      fprintf(stderr,
+              "usage: %s [--fast MS] [--slow MS] [--burst MS] "
+              "[--duration MS] [--airtime US] [CHANGE_MS...]\n",
+              argv[0]);
+      return 1;
+    }
+  }
+  std::sort(changes.begin(), changes.end());
+  if (policy.fastIntervalMs == 0 || policy.slowIntervalMs == 0) {
+    fprintf(stderr, "intervals must not be 0\n");
+    return 1;
+  }
+
+  // events() covers the latest burst exactly, so the time is summed up in
+  // pieces from one change to the next
+  BtHomeAdvertisingScheduler scheduler(policy);
+  printf("# time_ms interval_ms radio_units\n");
+  printInterval(0, scheduler);
+  float events = 0;
+  uint32_t now = 0;
+  bool changed = false;
+  for (size_t i = 0; now < duration; i++) {
+    uint32_t end =
+        i < changes.size() && changes[i] < duration ? changes[i] : duration;
+    events += scheduler.events(now, end);
+    uint32_t burstEnd = now + policy.burstMs;
+    if (changed && burstEnd < end && scheduler.update(burstEnd)) {
+      printInterval(burstEnd, scheduler);
+    }
+    now = end;
+    if (now < duration) {
+      scheduler.trigger(now);
+      changed = true;
+      if (scheduler.update(now)) {
+        printInterval(now, scheduler);
+      }
+    }
+  }
+
+  // Constant intervals for comparison
+  BtHomeAdvertisingPolicy fastPolicy = {policy.fastIntervalMs,
+                                        policy.fastIntervalMs, 0};
+  BtHomeAdvertisingPolicy slowPolicy = {policy.slowIntervalMs,
+                                        policy.slowIntervalMs, 0};
+  BtHomeAdvertisingScheduler fast(fastPolicy);
+  BtHomeAdvertisingScheduler slow(slowPolicy);
+  printf("# changes %zu duration_s %.1f\n", changes.size(),
+         duration / 1000.0f);
+  printf("# events %.0f duty_cycle %.5f%%\n", events,
+         100.0f * events * airtime / (duration * 1000.0f));
+  printf("# always_fast events %.0f duty_cycle %.5f%%\n",
+         fast.events(0, duration),
+         100.0f * fast.dutyCycle(0, duration, airtime));
+  printf("# always_slow events %.0f duty_cycle %.5f%%\n",
+         slow.events(0, duration),
+         100.0f * slow.dutyCycle(0, duration, airtime));
+  return 0;
+}
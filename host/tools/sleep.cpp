@@ -0,0 +1,170 @@
+/**
+ * @file sleep.cpp
+ * @brief Simulates wake-advertise-sleep cycles of an encrypting sensor.
+ *
+ * Every cycle builds a new device, as a deep sleep wake-up does, restores
+ * the encoder state with BtHomeSleepCycle, prepares an encrypted packet and
+ * sends a burst on a MockRadio. The retained state stands in for RTC memory
+ * and is wiped every --power-loss cycles. The same cycles run once with the
+ * retained state and once without it (a PersistentCounter started from
+ * storage on every wake-up), and the tool prints the storage writes, the
+ * counters used up, the prepare time and the burst length of both:
+ *
+ *   bthome_sleep --cycles 10000 --events 3 --power-loss 2500
+ *
+ * It exits with status 1 if a counter repeats, the packet id does not
+ * continue after a warm wake-up, a warm wake-up writes to storage outside a
+ * block change or a burst sends fewer events than requested.
+ *
+ * Usage: bthome_sleep [--cycles N] [--events N] [--interval UNITS]
+ *                     [--block N] [--power-loss N]
+ */
+
+#include <BtHomeDecoder.h>
+#include <BtHomeSleep.h>
+#include <BtHomeV2Device.h>
+#include <MockRadio.h>
+#include <stdlib.h>
+
+#include <chrono>
+
+static const uint8_t KEY[BIND_KEY_LEN] = {
+    0x23, 0x1d, 0x39, 0xc1, 0xd7, 0xcc, 0x1a, 0xb1,
+    0xae, 0xe2, 0x24, 0xcd, 0x09, 0x6d, 0xb9, 0x32};
+static const uint8_t MAC[BLE_MAC_ADDRESS_LENGTH] = {0x54, 0x48, 0xE6,
+                                                    0x8F, 0x80, 0xA5};
+
+struct Options {
+  uint32_t cycles = 10000;
+  uint32_t events = BtHomeSleepCycle::DEFAULT_BURST_EVENTS;
+  uint32_t interval = MIN_ADVERTISING_INTERVAL_UNITS;
+  uint32_t block = PersistentCounter::DEFAULT_BLOCK_SIZE;
+  uint32_t powerLoss = 0;
+};
+
+/// @brief Counter of an encrypted advertisement, in front of the MIC.
+/// @return 0 if the advertisement holds no encrypted service data
+static uint32_t packetCounter(const uint8_t* data, size_t size) {
+  BtHomeServiceData serviceData;
+  if (!BtHomeServiceData::fromAdvertisement(data, size, serviceData) ||
+      !serviceData.isEncrypted() ||
+      serviceData.payloadLength() < MIC_LEN + COUNTER_LEN) {
+    return 0;
+  }
+  const uint8_t* counter = serviceData.payload() +
+                           serviceData.payloadLength() - MIC_LEN - COUNTER_LEN;
+  return (uint32_t)counter[0] | ((uint32_t)counter[1] << 8) |
+         ((uint32_t)counter[2] << 16) | ((uint32_t)counter[3] << 24);
+}
+
+/// @return false if a check failed
+static bool simulate(const char* name, bool retain, const Options& options) {
+  RamCounterStorage storage;
+  BtHomeRetainedState retained = {};
+  uint32_t firstCounter = 0;
+  uint32_t lastCounter = 0;
+  uint8_t lastPacketId = 0;
+  uint32_t coldBoots = 0;
+  double prepareUs = 0;
+  uint32_t burstMs = 0;
+  bool ok = true;
+  for (uint32_t cycle = 0; cycle < options.cycles; cycle++) {
+    if (!retain ||
+        (options.powerLoss > 0 && cycle % options.powerLoss == 0)) {
+      memset(&retained, 0, sizeof(retained));
+    }
+    uint32_t writes = storage.getWriteCount();
+    // Only a used up block may be written on a warm wake-up
+    bool blockUsedUp = retained.counter == retained.counterLimit;
+
+    BtHomeV2Device device("sleepy", "sleepy", false, KEY, MAC);
+    PersistentCounter counter(storage, options.block);
+    BtHomeSleepCycle sleepCycle(retained);
+    auto start = std::chrono::steady_clock::now();
+    bool warm = sleepCycle.restore(device, &counter);
+    device.setPacketIdEnabled(true);
+    device.addTemperature_neg327_to_327_Resolution_0_01(20.0f +
+                                                        (cycle % 50) / 10.0f);
+    size_t size = sleepCycle.prepare(device);
+    prepareUs += std::chrono::duration<double, std::micro>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+    coldBoots += warm ? 0 : 1;
+
+    MockRadio radio;
+    sleepCycle.startBurst(radio, 0, static_cast<uint16_t>(options.events),
+                          static_cast<uint16_t>(options.interval));
+    uint32_t remaining = sleepCycle.remainingMs(0);
+    radio.advanceTo(static_cast<uint64_t>(remaining) * 1000);
+    ok &= sleepCycle.safeToSleep(remaining);
+    sleepCycle.finish(radio);
+    burstMs += remaining;
+
+    uint32_t packet = size ? packetCounter(sleepCycle.data(), size) : 0;
+    if (packet == 0 || (cycle > 0 && packet <= lastCounter)) {
+      fprintf(stderr, "%s: counter %u after %u in cycle %u\n", name, packet,
+              lastCounter, cycle);
+      ok = false;
+    }
+    if (warm && storage.getWriteCount() != writes && !blockUsedUp) {
+      fprintf(stderr, "%s: warm wake-up %u wrote to storage\n", name, cycle);
+      ok = false;
+    }
+    if (warm && device.getPacketId() != (uint8_t)(lastPacketId + 1)) {
+      fprintf(stderr, "%s: packet id %u after %u in cycle %u\n", name,
+              device.getPacketId(), lastPacketId, cycle);
+      ok = false;
+    }
+    if (radio.stats().events < options.events) {
+      fprintf(stderr, "%s: %u of %u events in cycle %u\n", name,
+              radio.stats().events, options.events, cycle);
+      ok = false;
+    }
+    firstCounter = cycle == 0 ? packet : firstCounter;
+    lastCounter = packet;
+    lastPacketId = device.getPacketId();
+  }
+  printf("%-8s %8u %6u %7u %14u %11.2f %9.1f\n", name, options.cycles,
+         coldBoots, storage.getWriteCount(), lastCounter - firstCounter + 1,
+         prepareUs / options.cycles,
+         options.cycles ? static_cast<double>(burstMs) / options.cycles : 0.0);
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    bool hasValue = i + 1 < argc;
+    uint32_t* target = nullptr;
+    if (strcmp(argv[i], "--cycles") == 0) {
+      target = &options.cycles;
+    } else if (strcmp(argv[i], "--events") == 0) {
+      target = &options.events;
+    } else if (strcmp(argv[i], "--interval") == 0) {
+      target = &options.interval;
+    } else if (strcmp(argv[i], "--block") == 0) {
+      target = &options.block;
+    } else if (strcmp(argv[i], "--power-loss") == 0) {
+      target = &options.powerLoss;
+    }
+    if (!target || !hasValue) {
+      fprintf(stderr,
+              "usage: %s [--cycles N] [--events N] [--interval UNITS] "
+              "[--block N] [--power-loss N]\n",
+              argv[0]);
+      return 1;
+    }
+    *target = strtoul(argv[++i], nullptr, 10);
+  }
+  if (options.events == 0 || options.events > UINT16_MAX) {
+    fprintf(stderr, "events must be 1 to 65535\n");
+    return 1;
+  }
+
+  printf(
+      "# path     cycles  colds  writes counters_used prepare_us "
+      "burst_ms\n");
+  bool retainedOk = simulate("retained", true, options);
+  bool coldOk = simulate("cold", false, options);
+  return retainedOk && coldOk ? 0 : 1;
+}
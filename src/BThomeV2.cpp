@@ -5,74 +5,259 @@
 
 #include "BThomeV2.h"
 
+#include "BaseDevice.h"
+#include "BtHomeLog.h"
+#include "BtHomeObjects.h"
+
 // BThome V2 Service UUID: 0000fcd2-0000-1000-8000-00805f9b34fb
 const uint16_t BTHOME_SERVICE_UUID = 0xFCD2;
 
-void BThomeV2::clearMeasurements() { measurements.clear(); }
+const uint8_t BThomeV2::FRAME_ALL;
+const uint8_t BThomeV2::FRAME_NONE;
+
+static const uint8_t COMMAND_ARGUMENT_MASK = 0x1F;
+
+const size_t BThomeV2::MEASUREMENT_BUFFER_SIZE;
+const size_t BThomeV2::MAX_MEASUREMENTS;
+const size_t BThomeV2::MAX_DEADBANDS;
+const size_t BThomeV2::DIAGNOSTIC_OBJECT_SIZE;
+const uint32_t BThomeV2::DEFAULT_BACKLOG_INTERVAL_MS;
+const uint32_t BThomeV2::REPLAY_EVENTS;
+const size_t BThomeV2::TIMESTAMP_OBJECT_SIZE;
+
+/// @brief Scales value to the wire integer of an object, rounded to nearest
+/// and saturated to its width. Matches BaseDevice::addFloat().
+static int64_t toWireValue(const BtHomeObjectInfo& info, float value) {
+  float scaled = info.scale.numerator == 1
+                     ? value * info.scale.denominator
+                     : value / (static_cast<float>(info.scale.numerator) /
+                                info.scale.denominator);
+  uint8_t valueBits = 8 * info.byteCount - (info.signed_value ? 1 : 0);
+  int64_t maximum = (static_cast<int64_t>(1) << valueBits) - 1;
+  int64_t minimum = info.signed_value ? -maximum - 1 : 0;
+  if (scaled != scaled) {
+    return 0;  // NaN
+  }
+  if (scaled >= maximum) {
+    return maximum;
+  }
+  if (scaled <= minimum) {
+    return minimum;
+  }
+  return static_cast<int64_t>(scaled < 0 ? scaled - 0.5f : scaled + 0.5f);
+}
+
+void BThomeV2::clearMeasurements() {
+  measurementCount = 0;
+  measurementBytes = 0;
+}
 
-void BThomeV2::addTemperature(float temperature) {
+bool BThomeV2::addTemperature(float temperature) {
   // Temperature in 0.01 °C, signed 16-bit
-  int16_t temp = (int16_t)(temperature * 100.0f);
-  std::vector<uint8_t> data;
-  encodeInt16(temp, data);
-  measurements.push_back(BThomeMeasurement(TEMPERATURE, data));
+  return addObject(TEMPERATURE, temperature);
 }
 
-void BThomeV2::addHumidity(float humidity) {
+bool BThomeV2::addHumidity(float humidity) {
   // Humidity in 0.01 %, unsigned 16-bit
-  uint16_t hum = (uint16_t)(humidity * 100.0f);
-  std::vector<uint8_t> data;
-  encodeUInt16(hum, data);
-  measurements.push_back(BThomeMeasurement(HUMIDITY, data));
+  return addObject(HUMIDITY, humidity);
 }
 
-void BThomeV2::addBattery(uint8_t battery) {
+bool BThomeV2::addBattery(uint8_t battery) {
   // Battery in %, unsigned 8-bit
-  std::vector<uint8_t> data;
-  data.push_back(battery);
-  measurements.push_back(BThomeMeasurement(BATTERY, data));
+  return addObject(BATTERY, battery);
 }
 
-void BThomeV2::addPressure(float pressure) {
+bool BThomeV2::addPressure(float pressure) {
   // Pressure in 0.01 hPa, unsigned 24-bit
-  uint32_t press = (uint32_t)(pressure * 100.0f);
-  std::vector<uint8_t> data;
-  encodeUInt24(press, data);
-  measurements.push_back(BThomeMeasurement(PRESSURE, data));
+  return addObject(PRESSURE, pressure);
 }
 
-void BThomeV2::addIlluminance(float illuminance) {
+bool BThomeV2::addIlluminance(float illuminance) {
   // Illuminance in 0.01 lux, unsigned 24-bit
-  uint32_t illum = (uint32_t)(illuminance * 100.0f);
-  std::vector<uint8_t> data;
-  encodeUInt24(illum, data);
-  measurements.push_back(BThomeMeasurement(ILLUMINANCE, data));
+  return addObject(ILLUMINANCE, illuminance);
 }
 
-void BThomeV2::addCO2(uint16_t co2) {
+bool BThomeV2::addCO2(uint16_t co2) {
   // CO2 in ppm, unsigned 16-bit
-  std::vector<uint8_t> data;
-  encodeUInt16(co2, data);
-  measurements.push_back(BThomeMeasurement(CO2, data));
+  return addObject(CO2, co2);
 }
 
-void BThomeV2::addBinarySensor(BThomeObjectID objectId, bool state) {
+bool BThomeV2::addBinarySensor(BThomeObjectID objectId, bool state) {
   // Binary sensor, 1 byte (0 or 1)
-  std::vector<uint8_t> data;
-  data.push_back(state ? 0x01 : 0x00);
-  measurements.push_back(BThomeMeasurement(objectId, data));
+  return addObject(objectId, state ? 1 : 0);
 }
 
-void BThomeV2::addButtonEvent(uint8_t event) {
+bool BThomeV2::addButtonEvent(uint8_t event) {
   // Button event, 1 byte
-  std::vector<uint8_t> data;
-  data.push_back(event);
-  measurements.push_back(BThomeMeasurement(BUTTON, data));
+  return addObject(BUTTON, event);
 }
 
-void BThomeV2::addMeasurement(BThomeObjectID objectId,
+bool BThomeV2::addObject(uint8_t objectId, float value) {
+  const BtHomeObjectInfo& info = bthomeObjectInfo(objectId);
+  // Text, raw and command ids are OBJECT_LENGTH_PREFIXED / OBJECT_COMMAND
+  if (info.byteCount == OBJECT_UNKNOWN || info.byteCount > sizeof(uint32_t)) {
+    return false;
+  }
+  uint8_t* data = reserveMeasurement(objectId, info.byteCount);
+  if (!data) {
+    return false;
+  }
+  uint64_t raw = static_cast<uint64_t>(toWireValue(info, value));
+  for (uint8_t i = 0; i < info.byteCount; i++) {
+    data[i] = (raw >> (8 * i)) & 0xFF;
+  }
+  return true;
+}
+
+bool BThomeV2::addMeasurement(BThomeObjectID objectId, const uint8_t* data,
+                              uint8_t size) {
+  // Receivers stop parsing at an object whose size they do not know
+  uint8_t byteCount = bthomeObjectInfo(objectId).byteCount;
+  bool valid = byteCount == OBJECT_LENGTH_PREFIXED
+                   ? size > 0 && data[0] == size - 1
+               : byteCount == OBJECT_COMMAND
+                   ? size > 1 && (data[0] & COMMAND_ARGUMENT_MASK) == size - 2
+                   : byteCount != OBJECT_UNKNOWN && byteCount == size;
+  if (!valid) {
+    return false;
+  }
+  uint8_t* value = reserveMeasurement(objectId, size);
+  if (!value) {
+    return false;
+  }
+  memcpy(value, data, size);
+  return true;
+}
+
+bool BThomeV2::addMeasurement(BThomeObjectID objectId,
                               const std::vector<uint8_t>& data) {
-  measurements.push_back(BThomeMeasurement(objectId, data));
+  if (data.size() > MEASUREMENT_BUFFER_SIZE) {
+    return false;
+  }
+  return addMeasurement(objectId, data.data(), data.size());
+}
+
+/// @brief Appends an object id and room for size value bytes.
+/// @return Pointer to the value bytes, nullptr if the buffer is full
+uint8_t* BThomeV2::reserveMeasurement(uint8_t objectId, size_t size) {
+  if (measurementCount == MAX_MEASUREMENTS ||
+      measurementBytes + 1 + size > MEASUREMENT_BUFFER_SIZE) {
+    stats.droppedMeasurements++;
+    return nullptr;
+  }
+  measurementStarts[measurementCount++] = measurementBytes;
+  measurementData[measurementBytes] = objectId;
+  uint8_t* value = &measurementData[measurementBytes + 1];
+  measurementBytes += 1 + size;
+  return value;
+}
+
+bool BThomeV2::setDeadband(uint8_t objectId, float deadband) {
+  const BtHomeObjectInfo& info = bthomeObjectInfo(objectId);
+  if (info.byteCount == OBJECT_UNKNOWN || info.byteCount > sizeof(uint32_t)) {
+    return false;
+  }
+
+  int index = findDeadband(objectId);
+  if (!(deadband > 0)) {
+    if (index >= 0) {
+      deadbands[index] = deadbands[--deadbandCount];
+    }
+    return true;
+  }
+  if (index < 0) {
+    if (deadbandCount == MAX_DEADBANDS) {
+      return false;
+    }
+    index = deadbandCount++;
+    deadbands[index].objectId = objectId;
+  }
+
+  // Deadband in wire steps, at least one step
+  float steps = deadband * info.scale.denominator / info.scale.numerator;
+  uint32_t threshold = 1;
+  if (steps >= UINT32_MAX) {
+    threshold = UINT32_MAX;
+  } else if (steps > 1) {
+    threshold = static_cast<uint32_t>(steps + 0.5f);
+  }
+  deadbands[index].threshold = threshold;
+  return true;
+}
+
+/// @return Index into deadbands, -1 if the object has none
+int BThomeV2::findDeadband(uint8_t objectId) const {
+  for (uint8_t i = 0; i < deadbandCount; i++) {
+    if (deadbands[i].objectId == objectId) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/// @brief Reads the little endian wire value of an object, sign-extended
+/// for signed objects.
+static int64_t wireValue(const uint8_t* value, const BtHomeObjectInfo& info) {
+  uint32_t bits = 0;
+  for (uint8_t i = 0; i < info.byteCount; i++) {
+    bits |= static_cast<uint32_t>(value[i]) << (8 * i);
+  }
+  if (info.signed_value && info.byteCount < sizeof(uint32_t)) {
+    uint32_t sign = 1UL << (8 * info.byteCount - 1);
+    return static_cast<int64_t>(bits ^ sign) - sign;
+  }
+  return info.signed_value ? static_cast<int32_t>(bits) : bits;
+}
+
+/// @brief Largest change of the measurements against the advertised set.
+BThomeV2::Change BThomeV2::compareWithAdvertised() const {
+  if (measurementCount != advertisedCount ||
+      measurementBytes != advertisedBytes ||
+      memcmp(measurementStarts, advertisedStarts, measurementCount) != 0) {
+    return CHANGE_SIGNIFICANT;
+  }
+
+  Change change = CHANGE_NONE;
+  for (size_t i = 0; i < measurementCount; i++) {
+    size_t start = measurementStarts[i];
+    size_t size = 1 + measurementSize(i);
+    if (memcmp(&measurementData[start], &advertisedData[start], size) == 0) {
+      continue;
+    }
+    uint8_t id = measurementData[start];
+    int deadband = findDeadband(id);
+    if (deadband < 0 || advertisedData[start] != id) {
+      return CHANGE_SIGNIFICANT;
+    }
+    const BtHomeObjectInfo& info = bthomeObjectInfo(id);
+    int64_t delta = wireValue(&measurementData[start + 1], info) -
+                    wireValue(&advertisedData[start + 1], info);
+    if ((delta < 0 ? -delta : delta) >= deadbands[deadband].threshold) {
+      change = CHANGE_DEADBAND;
+    }
+  }
+  return change;
+}
+
+bool BThomeV2::publishDue(uint32_t now) const {
+  uint32_t elapsed = now - lastPublish;
+  switch (compareWithAdvertised()) {
+    case CHANGE_SIGNIFICANT:
+      return true;
+    case CHANGE_DEADBAND:
+      return elapsed >= minPublishInterval;
+    default:
+      // Heartbeat
+      return maxPublishInterval > 0 && elapsed >= maxPublishInterval;
+  }
+}
+
+void BThomeV2::markAdvertised(uint32_t now) {
+  memcpy(advertisedData, measurementData, measurementBytes);
+  memcpy(advertisedStarts, measurementStarts, measurementCount);
+  advertisedCount = measurementCount;
+  advertisedBytes = measurementBytes;
+  lastPublish = now;
 }
 
 bool BThomeV2::setEncryptionKey(const uint8_t key[16]) {
@@ -82,57 +267,355 @@ bool BThomeV2::setEncryptionKey(const uint8_t key[16]) {
 
 void BThomeV2::setEncryption(bool enabled) { encryptionEnabled = enabled; }
 
-size_t BThomeV2::buildServiceData(uint8_t* output, size_t maxSize) {
-  if (maxSize < 1) return 0;
+void BThomeV2::setCritical(BThomeObjectID objectId, bool critical) {
+  uint32_t bit = 1UL << (objectId % 32);
+  if (critical) {
+    criticalObjects[objectId / 32] |= bit;
+  } else {
+    criticalObjects[objectId / 32] &= ~bit;
+  }
+}
 
-  size_t pos = 0;
+size_t BThomeV2::frameCapacity(size_t measurementCapacity) const {
+  return measurementCapacity -
+         (encryptionEnabled ? ENCRYPTION_ADDITIONAL_BYTES : 0) -
+         (packetIdEnabled ? PACKET_ID_SIZE : 0) -
+         (statsAdvertised ? DIAGNOSTIC_OBJECT_SIZE : 0);
+}
 
-  // Device Information byte (bit 0: encryption, bit 1-4: reserved, bit 5-7:
-  // BTHome version)
-  uint8_t deviceInfo = 0x40;  // Version 2 (010 in bits 5-7)
-  if (encryptionEnabled) {
-    deviceInfo |= 0x01;
-  }
-  output[pos++] = deviceInfo;
+size_t BThomeV2::planFrames(size_t capacity) {
+  size_t count = measurementCount;
+  memset(measurementFrames, FRAME_NONE, count);
+  plannedCount = count;
 
-  // If encrypted, add packet counter (not implemented in this basic version)
-  if (encryptionEnabled) {
-    if (pos + 4 > maxSize) return 0;
-    output[pos++] = (packetCounter >> 0) & 0xFF;
-    output[pos++] = (packetCounter >> 8) & 0xFF;
-    output[pos++] = (packetCounter >> 16) & 0xFF;
-    output[pos++] = (packetCounter >> 24) & 0xFF;
-    packetCounter++;
+  // Critical objects take the same room in every frame
+  size_t criticalSize = 0;
+  uint8_t order[MAX_MEASUREMENTS];
+  size_t orderCount = 0;
+  for (size_t i = 0; i < count; i++) {
+    uint8_t id = measurementData[measurementStarts[i]];
+    size_t size = 1 + measurementSize(i);
+    if (isCritical(id) && criticalSize + size <= capacity) {
+      criticalSize += size;
+      measurementFrames[i] = FRAME_ALL;
+    } else {
+      order[orderCount++] = i;
+    }
   }
 
-  // Add measurements
-  for (const auto& measurement : measurements) {
-    if (pos + 1 + measurement.data.size() > maxSize) {
-      break;  // Not enough space
+  // First-fit decreasing over the space left in each frame; insertion sort
+  // keeps equal sizes in the order added without a heap buffer
+  for (size_t o = 1; o < orderCount; o++) {
+    uint8_t index = order[o];
+    size_t p = o;
+    while (p > 0 && measurementSize(order[p - 1]) < measurementSize(index)) {
+      order[p] = order[p - 1];
+      p--;
+    }
+    order[p] = index;
+  }
+  size_t frameSpace = capacity - criticalSize;
+  // Every frame holds at least one measurement
+  size_t used[MAX_MEASUREMENTS];
+  size_t frames = 0;
+  for (size_t o = 0; o < orderCount; o++) {
+    uint8_t index = order[o];
+    size_t size = 1 + measurementSize(index);
+    if (size > frameSpace) {
+      continue;
+    }
+    size_t frame = 0;
+    while (frame < frames && used[frame] + size > frameSpace) {
+      frame++;
     }
+    if (frame == frames) {
+      used[frames++] = 0;
+    }
+    used[frame] += size;
+    measurementFrames[index] = frame;
+  }
+
+  frameCount = frames == 0 ? 1 : frames;
+  return frameCount;
+}
 
-    output[pos++] = (uint8_t)measurement.objectId;
+bool BThomeV2::isInFrame(size_t index, size_t frame) const {
+  if (index >= plannedCount) {
+    // Not planned yet: everything belongs to the first frame
+    return frame == 0;
+  }
+  return measurementFrames[index] == FRAME_ALL ||
+         measurementFrames[index] == frame;
+}
+
+bool BThomeV2::transmit(BtHomeRadio& radio, const uint8_t* data, size_t size,
+                        bool onAir, bool restart) {
+  // Same interval: the controller sends the new payload from its next event
+  // on, without a gap on air
+  uint32_t start = micros();
+  bool updated = onAir && !restart && radio.update(data, size);
+  bool started = false;
+  if (updated) {
+    stats.radioUpdates++;
+    BTHOME_TRACE_EVENT(BtHome_Trace_RadioUpdate, size);
+  } else {
+    started = radio.start(
+        data, size,
+        BtHomeAdvertisingScheduler::toUnits(scheduler.getAppliedInterval()));
+    stats.radioStarts++;
+    BTHOME_TRACE_EVENT(BtHome_Trace_RadioStart, started ? size : 0);
+  }
+  uint32_t elapsed = micros() - start;
+  stats.radioMicros += elapsed;
+  if (elapsed > stats.maxRadioMicros) {
+    stats.maxRadioMicros = elapsed;
+  }
+  if (!updated && !started) {
+    stats.radioFailures++;
+    BTHOME_LOGW("advertising did not start (%u bytes)",
+                static_cast<unsigned int>(size));
+  }
+  return updated || started;
+}
+
+bool BThomeV2::updateRadio(BtHomeRadio& radio, uint32_t now) {
+  if (!btHomeDevice && !extendedDevice) {
+    return false;
+  }
+
+  // Same measurements as on air (within their deadbands): keep the radio
+  // untouched
+  if (advertising && !publishDue(now)) {
+    return true;
+  }
+
+  // Split measurements that exceed one advertisement into frames
+  planFrames(frameCapacity(measurementCapacity));
+  currentFrame = 0;
+  lastFrameSwitch = now;
+  endReplay(now);
+
+  // A change starts a burst at the fast interval
+  scheduler.trigger(now);
+  bool intervalChanged = scheduler.update(now);
+  if (!advertiseFrame(radio, currentFrame, intervalChanged)) {
+    return false;
+  }
+  markAdvertised(now);
+  return true;
+}
+
+void BThomeV2::pollRadio(BtHomeRadio& radio, uint32_t now) {
+  // The history goes on while advertising is stopped
+  recordBacklog(now);
+  if (!advertising) {
+    return;
+  }
 
-    for (uint8_t byte : measurement.data) {
-      output[pos++] = byte;
+  // Deferred deadband changes and heartbeats
+  if (publishDue(now)) {
+    updateRadio(radio, now);
+    return;
+  }
+
+  if (scheduler.update(now)) {
+    // Burst over: same advertisement at the slow interval
+    advertiseFrame(radio, currentFrame, true);
+  }
+
+  // Spare slots between live advertisements replay the backlog
+  if (replayOver(now)) {
+    endReplay(now);
+    lastFrameSwitch = now;
+    advertiseFrame(radio, currentFrame);
+    return;
+  }
+  if (replayDue(now)) {
+    advertiseReplay(radio, now);
+    return;
+  }
+
+  if (replaying || frameCount < 2 || now - lastFrameSwitch < frameInterval) {
+    return;
+  }
+  currentFrame = (currentFrame + 1) % frameCount;
+  lastFrameSwitch = now;
+  advertiseFrame(radio, currentFrame);
+}
+
+bool BThomeV2::advertiseFrame(BtHomeRadio& radio, size_t frame,
+                              bool restart) {
+  uint8_t advertisementData[MAX_EXTENDED_ADVERTISEMENT_SIZE];
+  bool onAir = advertising && !restart;
+  size_t size =
+      extendedDevice
+          ? encodeFrame(*extendedDevice, frame, advertisementData, onAir)
+          : encodeFrame(*btHomeDevice, frame, advertisementData, onAir);
+
+  // Nothing new to send: the radio keeps the current advertisement
+  if (size == 0) {
+    return advertising;
+  }
+
+  advertising = transmit(radio, advertisementData, size, advertising, restart);
+  return advertising;
+}
+
+bool BThomeV2::advertiseReplay(BtHomeRadio& radio, uint32_t now) {
+  uint8_t advertisementData[MAX_EXTENDED_ADVERTISEMENT_SIZE];
+  size_t size =
+      extendedDevice ? encodeReplay(*extendedDevice, advertisementData, now)
+                     : encodeReplay(*btHomeDevice, advertisementData, now);
+  if (size == 0) {
+    return advertising;
+  }
+  advertising = transmit(radio, advertisementData, size, advertising, false);
+  return advertising;
+}
+
+void BThomeV2::stopRadio(BtHomeRadio& radio) {
+  radio.stop();
+  BTHOME_TRACE_EVENT(BtHome_Trace_RadioStop, 0);
+  advertising = false;
+}
+
+bool BThomeV2::setExtendedAdvertising(bool enabled) {
+  // The encoder exists from begin() on
+  if (btHomeDevice || extendedDevice ||
+      (enabled && !BTHOME_EXTENDED_ADVERTISING_SUPPORTED)) {
+    return false;
+  }
+  extendedAdvertising = enabled;
+  return true;
+}
+
+void BThomeV2::createEncoder(const char* name) {
+  deleteEncoder();
+  if (extendedAdvertising) {
+    extendedDevice = new ExtendedBtHomeV2Device(name, name, false);
+    measurementCapacity = ExtendedBtHomeV2Device::MEASUREMENT_CAPACITY;
+  } else {
+    btHomeDevice = new BtHomeV2Device(name, name, false);
+    measurementCapacity = BtHomeV2Device::MEASUREMENT_CAPACITY;
+  }
+}
+
+void BThomeV2::deleteEncoder() {
+  delete btHomeDevice;
+  btHomeDevice = nullptr;
+  delete extendedDevice;
+  extendedDevice = nullptr;
+  encodedDevice = nullptr;
+  advertising = false;
+}
+
+void BThomeV2::setBacklog(BtHomeBacklog* ring, uint32_t intervalMs) {
+  backlog = ring;
+  backlogInterval = intervalMs;
+  replaying = false;
+}
+
+void BThomeV2::setClock(uint32_t secondsSinceEpoch, uint32_t now) {
+  clockSeconds = secondsSinceEpoch;
+  clockMillis = now;
+  clockSet = true;
+}
+
+bool BThomeV2::storeSnapshot(uint32_t secondsSinceEpoch) {
+  size_t capacity = frameCapacity(measurementCapacity);
+  if (!backlog || capacity <= TIMESTAMP_OBJECT_SIZE) {
+    return false;
+  }
+  capacity -= TIMESTAMP_OBJECT_SIZE;
+
+  // Critical objects first, then the others in the order added
+  uint8_t snapshot[MEASUREMENT_BUFFER_SIZE + TIMESTAMP_OBJECT_SIZE];
+  size_t size = 0;
+  for (int pass = 0; pass < 2; pass++) {
+    for (size_t i = 0; i < measurementCount; i++) {
+      const uint8_t* entry = &measurementData[measurementStarts[i]];
+      size_t entrySize = 1 + measurementSize(i);
+      if (isCritical(entry[0]) == (pass == 0) &&
+          size + entrySize <= capacity) {
+        memcpy(&snapshot[size], entry, entrySize);
+        size += entrySize;
+      }
     }
   }
+  if (size == 0) {
+    return false;
+  }
+  snapshot[size++] = TIMESTAMP_OBJECT_ID;
+  for (int i = 0; i < 4; i++) {
+    snapshot[size++] = (secondsSinceEpoch >> (8 * i)) & 0xFF;
+  }
+  return backlog->push(snapshot, size);
+}
 
-  return pos;
+void BThomeV2::recordBacklog(uint32_t now) {
+  if (!backlog || !clockSet || now - lastSnapshot < backlogInterval) {
+    return;
+  }
+  lastSnapshot = now;
+  storeSnapshot(clockSeconds + (now - clockMillis) / 1000);
 }
 
-void BThomeV2::encodeInt16(int16_t value, std::vector<uint8_t>& data) {
-  data.push_back(value & 0xFF);
-  data.push_back((value >> 8) & 0xFF);
+bool BThomeV2::replayDue(uint32_t now) const {
+  if (!backlog || replaying || scheduler.inBurst(now) ||
+      backlog->pending() == 0) {
+    return false;
+  }
+  // Live advertisements get at least as long as a snapshot
+  return now - liveSince >= REPLAY_EVENTS * scheduler.getAppliedInterval();
+}
+
+size_t BThomeV2::valueSize(const uint8_t* object) {
+  uint8_t byteCount = bthomeObjectInfo(object[0]).byteCount;
+  if (byteCount == OBJECT_LENGTH_PREFIXED) {
+    return 1 + object[1];
+  }
+  if (byteCount == OBJECT_COMMAND) {
+    return 2 + (object[1] & COMMAND_ARGUMENT_MASK);
+  }
+  return byteCount;
+}
+
+BThomeV2Stats BThomeV2::getStats() const {
+  BThomeV2Stats result = stats;
+  if (extendedDevice) {
+    result.encoder = extendedDevice->getStats();
+    result.counter = extendedDevice->getCounter();
+  } else if (btHomeDevice) {
+    result.encoder = btHomeDevice->getStats();
+    result.counter = btHomeDevice->getCounter();
+  }
+  return result;
+}
+
+void BThomeV2::resetStats() {
+  memset(&stats, 0, sizeof(stats));
+  if (extendedDevice) {
+    extendedDevice->resetStats();
+  }
+  if (btHomeDevice) {
+    btHomeDevice->resetStats();
+  }
 }
 
-void BThomeV2::encodeUInt16(uint16_t value, std::vector<uint8_t>& data) {
-  data.push_back(value & 0xFF);
-  data.push_back((value >> 8) & 0xFF);
+/// @brief Little endian uint16_t, saturated.
+static void putSaturated16(uint32_t value, uint8_t* output) {
+  uint16_t clamped = value > 0xFFFF ? 0xFFFF : value;
+  output[0] = clamped & 0xFF;
+  output[1] = clamped >> 8;
 }
 
-void BThomeV2::encodeUInt24(uint32_t value, std::vector<uint8_t>& data) {
-  data.push_back(value & 0xFF);
-  data.push_back((value >> 8) & 0xFF);
-  data.push_back((value >> 16) & 0xFF);
+void BThomeV2::encodeDiagnostics(const BtHomeEncoderStats& encoder,
+                                 uint8_t* output) const {
+  output[0] = DIAGNOSTIC_OBJECT_SIZE - 2;
+  output[1] = encoder.packetsBuilt & 0xFF;
+  output[2] = (encoder.packetsBuilt >> 8) & 0xFF;
+  putSaturated16(encoder.droppedObjects + stats.droppedMeasurements,
+                 &output[3]);
+  putSaturated16(encoder.maxEncryptionMicros, &output[5]);
+  putSaturated16(stats.maxRadioMicros, &output[7]);
 }
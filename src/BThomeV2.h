@@ -14,6 +14,14 @@
 
 #include <vector>
 
+#include "BaseDevice.h"
+#include "BtHomeAdvertisingScheduler.h"
+#include "BtHomeBacklog.h"
+#include "BtHomeObjects.h"
+#include "BtHomeRadio.h"
+#include "BtHomeTrace.h"
+#include "BtHomeV2Device.h"
+
 /**
  * @brief BThome V2 object IDs for sensor data
  *
@@ -40,6 +48,7 @@ enum BThomeObjectID : uint8_t {
   TVOC = 0x13,
   MOISTURE = 0x14,
   // Binary sensors
+  GENERIC_BOOLEAN = 0x0F,
   BATTERY_LOW = 0x15,
   BATTERY_CHARGING = 0x16,
   CO = 0x17,
@@ -55,32 +64,90 @@ enum BThomeObjectID : uint8_t {
   MOTION = 0x21,
   MOVING = 0x22,
   OCCUPANCY = 0x23,
-  OPENING = 0x24,
-  PLUG = 0x25,
-  POWER_BINARY = 0x26,
-  PRESENCE = 0x27,
-  PROBLEM = 0x28,
-  RUNNING = 0x29,
-  SAFETY = 0x2A,
-  SMOKE = 0x2B,
-  SOUND = 0x2C,
-  TAMPER = 0x2D,
-  VIBRATION = 0x2E,
-  WINDOW = 0x2F,
+  OPENING = 0x11,
+  PLUG = 0x24,
+  POWER_BINARY = 0x10,
+  PRESENCE = 0x25,
+  PROBLEM = 0x26,
+  RUNNING = 0x27,
+  SAFETY = 0x28,
+  SMOKE = 0x29,
+  SOUND = 0x2A,
+  TAMPER = 0x2B,
+  VIBRATION = 0x2C,
+  WINDOW = 0x2D,
   // Events
   BUTTON = 0x3A,
   DIMMER = 0x3C
 };
 
+// Every id must be that of its data_types.h descriptor, which the encoder
+// takes the value size and scale from
+#define BTHOME_OBJECT_ID(name, descriptor) \
+  static_assert(name == descriptor.id, #name " is not the id of " #descriptor)
+BTHOME_OBJECT_ID(PACKET_ID, packet_id);
+BTHOME_OBJECT_ID(BATTERY, battery_percentage);
+BTHOME_OBJECT_ID(TEMPERATURE, temperature_int16_scale_0_01);
+BTHOME_OBJECT_ID(HUMIDITY, humidity_uint16);
+BTHOME_OBJECT_ID(PRESSURE, pressure);
+BTHOME_OBJECT_ID(ILLUMINANCE, illuminance);
+BTHOME_OBJECT_ID(MASS_KG, mass_kg);
+BTHOME_OBJECT_ID(MASS_LB, mass_lb);
+BTHOME_OBJECT_ID(DEW_POINT, dewpoint);
+BTHOME_OBJECT_ID(COUNT, count_uint8);
+BTHOME_OBJECT_ID(ENERGY, energy_uint24);
+BTHOME_OBJECT_ID(POWER, power_uint24);
+BTHOME_OBJECT_ID(VOLTAGE, voltage_0_001);
+BTHOME_OBJECT_ID(PM2_5, pm2_5);
+BTHOME_OBJECT_ID(PM10, pm10);
+BTHOME_OBJECT_ID(CO2, co2);
+BTHOME_OBJECT_ID(TVOC, tvoc);
+BTHOME_OBJECT_ID(MOISTURE, moisture_uint16);
+BTHOME_OBJECT_ID(GENERIC_BOOLEAN, generic_boolean);
+BTHOME_OBJECT_ID(BATTERY_LOW, battery_state);
+BTHOME_OBJECT_ID(BATTERY_CHARGING, battery_charging);
+BTHOME_OBJECT_ID(CO, carbon_monoxide);
+BTHOME_OBJECT_ID(COLD, cold);
+BTHOME_OBJECT_ID(CONNECTIVITY, connectivity);
+BTHOME_OBJECT_ID(DOOR, door);
+BTHOME_OBJECT_ID(GARAGE_DOOR, garage_door);
+BTHOME_OBJECT_ID(GAS, gas);
+BTHOME_OBJECT_ID(HEAT, heat);
+BTHOME_OBJECT_ID(LIGHT, light);
+BTHOME_OBJECT_ID(LOCK, lock);
+BTHOME_OBJECT_ID(MOISTURE_BINARY, moisture);
+BTHOME_OBJECT_ID(MOTION, motion);
+BTHOME_OBJECT_ID(MOVING, moving);
+BTHOME_OBJECT_ID(OCCUPANCY, occupancy);
+BTHOME_OBJECT_ID(OPENING, opening);
+BTHOME_OBJECT_ID(PLUG, plug);
+BTHOME_OBJECT_ID(POWER_BINARY, power);
+BTHOME_OBJECT_ID(PRESENCE, presence);
+BTHOME_OBJECT_ID(PROBLEM, problem);
+BTHOME_OBJECT_ID(RUNNING, running);
+BTHOME_OBJECT_ID(SAFETY, safety);
+BTHOME_OBJECT_ID(SMOKE, smoke);
+BTHOME_OBJECT_ID(SOUND, sound);
+BTHOME_OBJECT_ID(TAMPER, tamper);
+BTHOME_OBJECT_ID(VIBRATION, vibration);
+BTHOME_OBJECT_ID(WINDOW, window);
+BTHOME_OBJECT_ID(BUTTON, button);
+BTHOME_OBJECT_ID(DIMMER, dimmer);
+#undef BTHOME_OBJECT_ID
+
 /**
- * @brief Structure to hold a single BThome measurement
+ * @brief Counters of the advertising pipeline, see BThomeV2::getStats()
  */
-struct BThomeMeasurement {
-  BThomeObjectID objectId;
-  std::vector<uint8_t> data;
-
-  BThomeMeasurement(BThomeObjectID id, const std::vector<uint8_t>& d)
-      : objectId(id), data(d) {}
+struct BThomeV2Stats {
+  BtHomeEncoderStats encoder;    // Of the platform encoder
+  uint32_t droppedMeasurements;  // add* calls with a full measurement buffer
+  uint32_t radioStarts;
+  uint32_t radioUpdates;  // Payloads swapped into the running advertiser
+  uint32_t radioFailures;
+  uint32_t radioMicros;  // Sum over starts and updates
+  uint32_t maxRadioMicros;
+  uint32_t counter;        // Counter of the next encrypted packet
+  uint32_t heapHighWater;  // Most heap bytes in use so far, 0 if unknown
 };
 
 /**
@@ -91,7 +158,7 @@ struct BThomeMeasurement {
  */
 class BThomeV2 {
  public:
-  virtual ~BThomeV2() {}
+  virtual ~BThomeV2() { deleteEncoder(); }
 
   /**
    * @brief Initialize the BLE stack
@@ -131,61 +198,264 @@ class BThomeV2 {
   /**
    * @brief Add a temperature measurement (0.01 °C)
    * @param temperature Temperature in Celsius
+   * @return false if the measurement buffer is full
    */
-  void addTemperature(float temperature);
+  bool addTemperature(float temperature);
 
   /**
    * @brief Add a humidity measurement (0.01 %)
    * @param humidity Humidity in percent
+   * @return false if the measurement buffer is full
    */
-  void addHumidity(float humidity);
+  bool addHumidity(float humidity);
 
   /**
    * @brief Add a battery level measurement (%)
    * @param battery Battery level in percent (0-100)
+   * @return false if the measurement buffer is full
    */
-  void addBattery(uint8_t battery);
+  bool addBattery(uint8_t battery);
 
   /**
    * @brief Add a pressure measurement (0.01 hPa)
    * @param pressure Pressure in hPa
+   * @return false if the measurement buffer is full
    */
-  void addPressure(float pressure);
+  bool addPressure(float pressure);
 
   /**
    * @brief Add an illuminance measurement (0.01 lux)
    * @param illuminance Illuminance in lux
+   * @return false if the measurement buffer is full
    */
-  void addIlluminance(float illuminance);
+  bool addIlluminance(float illuminance);
 
   /**
    * @brief Add a CO2 measurement (ppm)
    * @param co2 CO2 level in ppm
+   * @return false if the measurement buffer is full
    */
-  void addCO2(uint16_t co2);
+  bool addCO2(uint16_t co2);
 
   /**
    * @brief Add a binary sensor state
    * @param objectId Binary sensor object ID
    * @param state Sensor state (true/false)
+   * @return false if the measurement buffer is full
    */
-  void addBinarySensor(BThomeObjectID objectId, bool state);
+  bool addBinarySensor(BThomeObjectID objectId, bool state);
 
   /**
    * @brief Add a button press event
    * @param event Event type (0x00=none, 0x01=press, 0x02=double_press,
    * 0x03=triple_press, 0x80=long_press)
+   * @return false if the measurement buffer is full
    */
-  void addButtonEvent(uint8_t event);
+  bool addButtonEvent(uint8_t event);
+
+  /**
+   * @brief Add any fixed-width object of the BTHome specification
+   *
+   * Width, signedness and resolution come from the bthomeObjectInfo() table,
+   * so every object in data_types.h can be sent, e.g. addObject(0x0C, 3.3f)
+   * for a voltage in 0.001 V steps. The value is rounded to the resolution
+   * and clamped to the range of the object.
+   * @param objectId Object ID from BThome specification
+   * @param value Value in the unit of the object
+   * @return false for unknown, text, raw and command ids or if the
+   * measurement buffer is full
+   */
+  bool addObject(uint8_t objectId, float value);
+
+  /**
+   * @brief Add a custom measurement
+   * @param objectId Object ID from BThome specification
+   * @param data Value bytes in wire format (little endian)
+   * @param size Number of value bytes
+   * @return false if the size does not match the object, the id is unknown
+   * or the measurement buffer is full
+   */
+  bool addMeasurement(BThomeObjectID objectId, const uint8_t* data,
+                      uint8_t size);
 
   /**
    * @brief Add a custom measurement
    * @param objectId Object ID from BThome specification
    * @param data Raw data bytes for the measurement
+   * @return false if the size does not match the object, the id is unknown
+   * or the measurement buffer is full
    */
-  void addMeasurement(BThomeObjectID objectId,
+  bool addMeasurement(BThomeObjectID objectId,
                       const std::vector<uint8_t>& data);
 
+  /**
+   * @brief Mark an object as critical
+   *
+   * When the measurements do not fit into one advertisement they are split
+   * into several frames that are rotated by poll(). Critical objects are
+   * repeated in every frame.
+   * @param objectId Object ID to mark
+   * @param critical true to send the object in every frame
+   */
+  void setCritical(BThomeObjectID objectId, bool critical = true);
+
+  /**
+   * @brief Set how long each frame stays on air before poll() rotates
+   * @param intervalMs Time per frame in milliseconds
+   */
+  void setFrameInterval(uint32_t intervalMs) { frameInterval = intervalMs; }
+
+  /**
+   * @brief Number of advertisement frames the current measurements need
+   * @return Frame count of the last advertising update (at least 1)
+   */
+  size_t getFrameCount() const { return frameCount; }
+
+  /// Objects that can have a deadband at the same time
+  static const size_t MAX_DEADBANDS = 16;
+
+  /**
+   * @brief Ignore small changes of an analog object
+   *
+   * updateAdvertising() only rebuilds the advertisement for this object when
+   * it moved at least deadband away from the value last advertised, so
+   * jitter in the last digit does not cause radio updates. As the reference
+   * is the advertised value, slow drifts are still published once they add
+   * up to the deadband. Changes of objects without a deadband are always
+   * published.
+   * @param objectId Object ID, see addObject()
+   * @param deadband Smallest change in the unit of the object, 0 to remove
+   * @return false for variable-length ids or if all MAX_DEADBANDS are in use
+   */
+  bool setDeadband(uint8_t objectId, float deadband);
+
+  /**
+   * @brief Limit how often deadband changes are published and send a
+   * heartbeat
+   *
+   * Changes that only passed a deadband wait until minIntervalMs has passed
+   * since the last update; other changes are published at once. Unchanged
+   * measurements are advertised again (with a fresh fast burst) every
+   * maxIntervalMs. poll() publishes deferred changes and heartbeats.
+   * @param minIntervalMs Minimum time between deadband updates, 0 for none
+   * @param maxIntervalMs Heartbeat period, 0 for none
+   */
+  void setPublishIntervals(uint32_t minIntervalMs, uint32_t maxIntervalMs) {
+    minPublishInterval = minIntervalMs;
+    maxPublishInterval = maxIntervalMs;
+  }
+
+  /**
+   * @brief Set the advertising intervals
+   *
+   * Every change of the measurements starts a burst of policy.burstMs at
+   * policy.fastIntervalMs; afterwards poll() backs off to
+   * policy.slowIntervalMs. Takes effect with the next advertising update.
+   * @param policy Intervals in milliseconds, see DEFAULT_ADVERTISING_POLICY
+   */
+  void setAdvertisingPolicy(const BtHomeAdvertisingPolicy& policy) {
+    scheduler.setPolicy(policy);
+  }
+
+  /**
+   * @brief Advertising interval currently programmed into the radio
+   * @return Interval in milliseconds
+   */
+  uint32_t getAdvertisingInterval() const {
+    return scheduler.getAppliedInterval();
+  }
+
+  /**
+   * @brief Send a packet id (object 0x00) in front of the measurements
+   *
+   * The id only changes when the measurements change, so receivers can drop
+   * repeated advertisements of the same reading.
+   * @param enabled true to send the packet id
+   */
+  void setPacketId(bool enabled) { packetIdEnabled = enabled; }
+
+  /**
+   * @brief Counters of the advertising pipeline
+   *
+   * Packets built and their size, objects dropped for lack of space,
+   * encryption and radio call times, the encryption counter and the heap
+   * high-water mark. Counting costs a few increments and two micros() calls
+   * per packet, so it is always on.
+   * @return Counters since power-up or resetStats()
+   */
+  virtual BThomeV2Stats getStats() const;
+
+  /**
+   * @brief Restart all counters of getStats() at 0
+   */
+  virtual void resetStats();
+
+  /**
+   * @brief Advertise with BLE 5 extended advertising (up to 255 bytes)
+   * Must be called before begin(). Only scanners with BLE 5 support receive
+   * extended advertisements.
+   * @return false if the controller has no extended advertising support
+   */
+  bool setExtendedAdvertising(bool enabled);
+
+  /**
+   * @brief Send a diagnostic raw object (0x54) in every advertisement
+   *
+   * Its 8 value bytes (little endian) are the packets built before it (low
+   * 16 bits),
+   * the objects and measurements dropped, the longest encryption and the
+   * longest radio call in microseconds, each saturated at 0xFFFF. It takes
+   * DIAGNOSTIC_OBJECT_SIZE bytes of every frame and is refreshed whenever
+   * an advertisement is built.
+   * @param enabled true to send the object
+   */
+  void setStatsAdvertised(bool enabled) { statsAdvertised = enabled; }
+
+  /// Bytes of the diagnostic object: id, length and 8 value bytes
+  static const size_t DIAGNOSTIC_OBJECT_SIZE = 10;
+
+  /**
+   * @brief Keep a history of the measurements and replay it in spare slots
+   *
+   * poll() stores a snapshot of the measurements every intervalMs, also
+   * while advertising is stopped, with a timestamp object (0x50) from
+   * setTime(). Outside the fast burst after a change, the snapshots take
+   * turns on air for REPLAY_EVENTS advertising events each, with live
+   * advertisements for at least as long in between. A snapshot holds the
+   * critical objects and then the others in the order added, as many as
+   * fit into one advertisement with the timestamp.
+   *
+   * Receivers that ignore the timestamp (e.g. Home Assistant) show replayed
+   * values as current ones; use it with gateways that read object 0x50.
+   * @param ring Backlog for the snapshots, nullptr to stop recording
+   * @param intervalMs Time between two snapshots
+   */
+  void setBacklog(BtHomeBacklog* ring,
+                  uint32_t intervalMs = DEFAULT_BACKLOG_INTERVAL_MS);
+
+  /**
+   * @brief Set the wall clock for the timestamps of the backlog
+   *
+   * The clock runs on from millis(); set it again at least every 49 days.
+   * @param secondsSinceEpoch Current time in seconds since the unix epoch
+   */
+  void setTime(uint32_t secondsSinceEpoch) {
+    setClock(secondsSinceEpoch, millis());
+  }
+
+  /**
+   * @brief Store the current measurements in the backlog now
+   * @param secondsSinceEpoch Timestamp of the snapshot
+   * @return false without a backlog or measurements
+   */
+  bool storeSnapshot(uint32_t secondsSinceEpoch);
+
+  static const uint32_t DEFAULT_BACKLOG_INTERVAL_MS = 60000;
+  /// Advertising events of one replayed snapshot
+  static const uint32_t REPLAY_EVENTS = 3;
+  /// Bytes of the timestamp object: id and 4 value bytes
+  static const size_t TIMESTAMP_OBJECT_SIZE = 5;
+
   /**
    * @brief Set encryption key for encrypted advertising (if supported)
    * @param key 16-byte encryption key
@@ -206,32 +476,402 @@ class BThomeV2 {
   bool isEncryptionEnabled() const { return encryptionEnabled; }
 
  protected:
+  /// Frame marker for critical measurements sent in every frame
+  static const uint8_t FRAME_ALL = 0xFF;
+  /// Frame marker for measurements that are larger than a frame
+  static const uint8_t FRAME_NONE = 0xFE;
+
+  /**
+   * @brief Split the measurements into as few frames as possible
+   *
+   * Critical objects are reserved in every frame, the others are packed
+   * first-fit decreasing into the remaining space.
+   * @param capacity Measurement bytes available per advertisement
+   * @return Number of frames (at least 1)
+   */
+  size_t planFrames(size_t capacity);
+
   /**
-   * @brief Build the service data payload for advertising
-   * @param output Buffer to store the service data
-   * @param maxSize Maximum size of the output buffer
-   * @return Size of the service data, or 0 on error
+   * @brief Measurement bytes left per frame after encryption and packet id
+   * @param measurementCapacity Measurement bytes of one advertisement
    */
-  size_t buildServiceData(uint8_t* output, size_t maxSize);
+  size_t frameCapacity(size_t measurementCapacity) const;
 
-  std::vector<BThomeMeasurement> measurements;
+  /**
+   * @brief Check whether a measurement is part of a frame
+   * @param index Index into measurements
+   * @param frame Frame number
+   * @return true if the measurement is sent in that frame
+   */
+  bool isInFrame(size_t index, size_t frame) const;
+
+  /**
+   * @brief Copy the measurements of a frame into a device and build its
+   * advertisement
+   *
+   * The measurements are already in wire format, so they are copied as they
+   * are; this is the only encoder the platform backends use. If device
+   * still holds the objects of the frame, only their values are
+   * overwritten (see patchFrame()) and the device patches the changed bytes
+   * into its last advertisement instead of rebuilding it.
+   * @param device BtHomeV2Device or ExtendedBtHomeV2Device
+   * @param frame Frame number, see planFrames()
+   * @param buffer Advertisement output, MaxSize of the device
+   * @param onAir true if the current advertisement is being sent
+   * @return Advertisement size, 0 if the advertisement on air is still current
+   */
+  template <typename Device>
+  size_t encodeFrame(Device& device, size_t frame, uint8_t* buffer,
+                     bool onAir);
+
+  /**
+   * @brief Encode the next snapshot of the backlog and start its slot
+   * @param device BtHomeV2Device or ExtendedBtHomeV2Device
+   * @param buffer Advertisement output, MaxSize of the device
+   * @param now Current time in milliseconds
+   * @return Advertisement size, 0 if no snapshot is due
+   */
+  template <typename Device>
+  size_t encodeReplay(Device& device, uint8_t* buffer, uint32_t now);
+
+  /**
+   * @brief Overwrite the values of a frame that device holds already
+   * @param device BtHomeV2Device or ExtendedBtHomeV2Device
+   * @param frame Frame number, see planFrames()
+   * @return false if the objects of device are not those of the frame
+   */
+  template <typename Device>
+  bool patchFrame(Device& device, size_t frame);
+
+  /// @brief Anchor the backlog clock: secondsSinceEpoch at now (ms).
+  void setClock(uint32_t secondsSinceEpoch, uint32_t now);
+
+  /// @brief Store a snapshot if the backlog interval passed since the last.
+  void recordBacklog(uint32_t now);
+
+  /// @brief true if a spare slot for a snapshot is free at now.
+  bool replayDue(uint32_t now) const;
+
+  /// @brief true if the slot of the snapshot on air is over.
+  bool replayOver(uint32_t now) const {
+    return replaying && now - replayStart >= replaySlot;
+  }
+
+  /// @brief Live advertisements take the air again from now on.
+  void endReplay(uint32_t now) {
+    replaying = false;
+    liveSince = now;
+  }
+
+  /// @brief Value bytes of an object in wire format, see addMeasurement().
+  static size_t valueSize(const uint8_t* object);
+
+  /**
+   * @brief Value of the diagnostic object, see setStatsAdvertised()
+   * @param encoder Counters of the encoder that builds the advertisement
+   * @param output Length byte and value bytes, DIAGNOSTIC_OBJECT_SIZE - 1
+   */
+  void encodeDiagnostics(const BtHomeEncoderStats& encoder,
+                         uint8_t* output) const;
+
+  /**
+   * @brief Put an advertisement on air through a radio backend
+   *
+   * While advertising at the applied interval the payload is swapped into
+   * the running advertiser; the radio is only restarted for the first
+   * advertisement, interval changes and payloads it cannot swap.
+   * @param data Advertisement, see encodeFrame()
+   * @param onAir true if radio is advertising
+   * @param restart true if the interval of the scheduler changed
+   * @return true if radio advertises data
+   */
+  bool transmit(BtHomeRadio& radio, const uint8_t* data, size_t size,
+                bool onAir, bool restart);
+
+  /**
+   * @brief updateAdvertising() of the platform backends on radio
+   *
+   * Leaves the radio alone while the advertised measurements are current
+   * (within their deadbands); otherwise plans the frames, starts a burst at
+   * the fast interval and puts the first frame on air.
+   * @param now Current time in milliseconds
+   * @return true if radio advertises the measurements
+   */
+  bool updateRadio(BtHomeRadio& radio, uint32_t now);
+
+  /**
+   * @brief poll() of the platform backends on radio
+   *
+   * Records the backlog, publishes deferred deadband changes and heartbeats,
+   * backs off to the slow interval after a burst, replays the backlog in
+   * spare slots and rotates the frames.
+   * @param now Current time in milliseconds
+   */
+  void pollRadio(BtHomeRadio& radio, uint32_t now);
+
+  /// @brief Puts frame on air with the interval of the scheduler.
+  /// @param restart Restart the radio even if the advertisement is unchanged
+  bool advertiseFrame(BtHomeRadio& radio, size_t frame, bool restart = false);
+
+  /// @brief Puts the next snapshot of the backlog on air for a replay slot.
+  bool advertiseReplay(BtHomeRadio& radio, uint32_t now);
+
+  /// @brief Stops radio; the next update restarts it.
+  void stopRadio(BtHomeRadio& radio);
+
+  /**
+   * @brief Replace the encoder of the radio paths: an ExtendedBtHomeV2Device
+   * with extended advertising, a BtHomeV2Device otherwise
+   * @param name Short and complete name of the device
+   */
+  void createEncoder(const char* name);
+
+  /// @brief Delete the encoder of createEncoder().
+  void deleteEncoder();
+
+  /**
+   * @brief Check whether the measurements have to be advertised again
+   *
+   * True if they differ from the last advertised set beyond the deadbands
+   * (and, for deadband changes, the minimum publish interval passed) or a
+   * heartbeat is due.
+   * @param now Current time in milliseconds
+   * @return true if a new advertisement has to be built
+   */
+  bool publishDue(uint32_t now) const;
+
+  /**
+   * @brief Remember the current measurements as the advertised set
+   * @param now Current time in milliseconds
+   */
+  void markAdvertised(uint32_t now);
+
+  /// Measurement bytes (object id and value) the high-level API holds; room
+  /// for several frames of legacy advertisements
+  static const size_t MEASUREMENT_BUFFER_SIZE = MAX_EXTENDED_ADVERTISEMENT_SIZE;
+  static const size_t MAX_MEASUREMENTS = MEASUREMENT_BUFFER_SIZE / 2;
+
+  /// @brief Value bytes of measurement index
+  size_t measurementSize(size_t index) const {
+    size_t end = index + 1 < measurementCount ? measurementStarts[index + 1]
+                                              : measurementBytes;
+    return end - measurementStarts[index] - 1;
+  }
+
+  // Measurements in wire format (object id, value), in the order added
+  uint8_t measurementData[MEASUREMENT_BUFFER_SIZE];
+  uint8_t measurementStarts[MAX_MEASUREMENTS];
+  uint8_t measurementCount = 0;
+  uint8_t measurementBytes = 0;
+  // Copy of the measurements last put on air
+  uint8_t advertisedData[MEASUREMENT_BUFFER_SIZE];
+  uint8_t advertisedStarts[MAX_MEASUREMENTS];
+  uint8_t advertisedCount = 0;
+  uint8_t advertisedBytes = 0;
+  uint32_t lastPublish = 0;
+  uint32_t minPublishInterval = 0;
+  uint32_t maxPublishInterval = 0;
+  // Frame of every measurement, valid for the first plannedCount
+  uint8_t measurementFrames[MAX_MEASUREMENTS];
+  uint8_t plannedCount = 0;
+  BtHomeAdvertisingScheduler scheduler;
+  uint32_t criticalObjects[8] = {0};
+  size_t frameCount = 1;
+  size_t currentFrame = 0;
+  uint32_t frameInterval = 1000;
+  uint32_t lastFrameSwitch = 0;
   bool encryptionEnabled = false;
+  bool packetIdEnabled = false;
+  bool statsAdvertised = false;
+  BThomeV2Stats stats = {};
   uint8_t encryptionKey[16] = {0};
-  uint32_t packetCounter = 0;
+  /// Measurement bytes of one advertisement of the platform encoder
+  size_t measurementCapacity =
+      BasicBaseDevice<MAX_ADVERTISEMENT_SIZE>::ARENA_SIZE;
+  BtHomeBacklog* backlog = nullptr;
+  uint32_t backlogInterval = DEFAULT_BACKLOG_INTERVAL_MS;
+  uint32_t lastSnapshot = 0;
+  bool clockSet = false;
+  uint32_t clockSeconds = 0;
+  uint32_t clockMillis = 0;
+  bool replaying = false;
+  uint32_t replayStart = 0;
+  uint32_t replaySlot = 0;
+  uint32_t liveSince = 0;
+  // Device and frame last encoded by encodeFrame(), nullptr if unknown
+  const void* encodedDevice = nullptr;
+  size_t encodedFrame = 0;
+  // Encoder of the radio paths, see createEncoder(); extendedDevice
+  // replaces btHomeDevice with extended advertising
+  BtHomeV2Device* btHomeDevice = nullptr;
+  ExtendedBtHomeV2Device* extendedDevice = nullptr;
+  bool extendedAdvertising = false;
+  bool advertising = false;  // The radio sends the measurements
 
  private:
-  void encodeInt16(int16_t value, std::vector<uint8_t>& data);
-  void encodeUInt16(uint16_t value, std::vector<uint8_t>& data);
-  void encodeUInt24(uint32_t value, std::vector<uint8_t>& data);
+  /// Change of one measurement compared with the advertised set
+  enum Change { CHANGE_NONE, CHANGE_DEADBAND, CHANGE_SIGNIFICANT };
+
+  struct Deadband {
+    uint8_t objectId;
+    uint32_t threshold;  // In wire steps of the object
+  };
+
+  uint8_t* reserveMeasurement(uint8_t objectId, size_t size);
+  bool isCritical(uint8_t objectId) const {
+    return criticalObjects[objectId / 32] & (1UL << (objectId % 32));
+  }
+  Change compareWithAdvertised() const;
+  int findDeadband(uint8_t objectId) const;
+
+  Deadband deadbands[MAX_DEADBANDS];
+  uint8_t deadbandCount = 0;
 };
 
+template <typename Device>
+size_t BThomeV2::encodeFrame(Device& device, size_t frame, uint8_t* buffer,
+                             bool onAir) {
+  BTHOME_TRACE_EVENT(BtHome_Trace_EncodeBegin, frame);
+  device.setPacketIdEnabled(packetIdEnabled);
+  // The device still holds this frame: only values changed
+  bool patched = encodedDevice == &device && encodedFrame == frame &&
+                 patchFrame(device, frame);
+  if (!patched) {
+    device.clearMeasurementData();
+    device.setPacketIdEnabled(packetIdEnabled);  // Fits the empty arena
+    for (size_t i = 0; i < measurementCount; i++) {
+      if (!isInFrame(i, frame)) {
+        continue;
+      }
+      const uint8_t* entry = &measurementData[measurementStarts[i]];
+      device.addEncoded(entry[0], entry + 1, measurementSize(i));
+    }
+    if (statsAdvertised) {
+      uint8_t diagnostics[DIAGNOSTIC_OBJECT_SIZE - 1];
+      encodeDiagnostics(device.getStats(), diagnostics);
+      device.addEncoded(RAW_OBJECT_ID, diagnostics, sizeof(diagnostics));
+    }
+    encodedDevice = &device;
+    encodedFrame = frame;
+  }
+
+  // Values that encode to the same bytes need no radio update either
+  if (onAir && !device.hasChanged()) {
+    BTHOME_TRACE_EVENT(BtHome_Trace_EncodeEnd, 0);
+    return 0;
+  }
+  size_t size = device.getAdvertisementData(buffer);
+  BTHOME_TRACE_EVENT(BtHome_Trace_EncodeEnd, size);
+  return size;
+}
+
+template <typename Device>
+bool BThomeV2::patchFrame(Device& device, size_t frame) {
+  size_t objects = 0;
+  uint8_t raws = 0;
+  for (size_t i = 0; i < measurementCount; i++) {
+    if (!isInFrame(i, frame)) {
+      continue;
+    }
+    const uint8_t* entry = &measurementData[measurementStarts[i]];
+    // Objects with the same id are in the device in the order added
+    uint8_t occurrence = 0;
+    for (size_t j = 0; j < i; j++) {
+      occurrence += isInFrame(j, frame) &&
+                    measurementData[measurementStarts[j]] == entry[0];
+    }
+    raws += entry[0] == RAW_OBJECT_ID;
+    if (!device.updateEncoded(entry[0], occurrence, entry + 1,
+                              measurementSize(i))) {
+      return false;
+    }
+    objects++;
+  }
+  if (statsAdvertised) {
+    uint8_t diagnostics[DIAGNOSTIC_OBJECT_SIZE - 1];
+    encodeDiagnostics(device.getStats(), diagnostics);
+    if (!device.updateEncoded(RAW_OBJECT_ID, raws, diagnostics,
+                              sizeof(diagnostics))) {
+      return false;
+    }
+    objects++;
+  }
+  // Every object found once: the device holds exactly this frame
+  return objects == device.getObjectCount();
+}
+
+template <typename Device>
+size_t BThomeV2::encodeReplay(Device& device, uint8_t* buffer, uint32_t now) {
+  uint8_t snapshot[BtHomeBacklog::MAX_SNAPSHOT_SIZE];
+  size_t size = backlog ? backlog->next(snapshot, sizeof(snapshot)) : 0;
+  if (size == 0) {
+    return 0;
+  }
+  encodedDevice = nullptr;
+  device.clearMeasurementData();
+  device.setPacketIdEnabled(packetIdEnabled);
+  for (size_t pos = 0; pos < size;) {
+    size_t length = valueSize(&snapshot[pos]);
+    if (pos + 1 + length > size) {
+      break;
+    }
+    device.addEncoded(snapshot[pos], &snapshot[pos + 1], length);
+    pos += 1 + length;
+  }
+  if (statsAdvertised) {
+    uint8_t diagnostics[DIAGNOSTIC_OBJECT_SIZE - 1];
+    encodeDiagnostics(device.getStats(), diagnostics);
+    device.addEncoded(RAW_OBJECT_ID, diagnostics, sizeof(diagnostics));
+  }
+  replaying = true;
+  replayStart = now;
+  replaySlot = REPLAY_EVENTS * scheduler.getAppliedInterval();
+  return device.getAdvertisementData(buffer);
+}
+
 // Platform-specific device class
 #if defined(ESP32)
 
 #include <ArduinoBLE.h>
 
-// Forward declaration for integrated BTHomeV2 encoding library
-class BtHomeV2Device;
+// Controllers with BLE 5 advertising sets
+#if defined(CONFIG_IDF_TARGET_ESP32C3) || \
+    defined(CONFIG_IDF_TARGET_ESP32S3) || \
+    defined(CONFIG_IDF_TARGET_ESP32C6) || defined(CONFIG_IDF_TARGET_ESP32H2)
+#define BTHOME_EXTENDED_ADVERTISING_SUPPORTED 1
+#else
+#define BTHOME_EXTENDED_ADVERTISING_SUPPORTED 0
+#endif
+
+/**
+ * @brief ArduinoBLE advertiser
+ *
+ * Legacy advertisements go through BLE; updates are sent as HCI LE Set
+ * Advertising Data while advertising is enabled. Extended advertisements use
+ * an advertising set (0 unless setHandle() picks another) through HCI
+ * commands; data of one command (up to 251 bytes) is replaced while the set
+ * is enabled. With setAddress() the advertiser is configured through HCI
+ * commands as non-connectable from that random address; extended sets each
+ * get their own.
+ */
+class ArduinoBleRadio : public BtHomeRadio {
+ public:
+  void setExtended(bool enabled) { extended = enabled; }
+  /// @brief Advertising set of an extended radio, one per radio when several
+  /// advertise at the same time. Call before start().
+  void setHandle(uint8_t setHandle) { handle = setHandle; }
+  bool start(const uint8_t* data, size_t size, uint16_t interval) override;
+  bool update(const uint8_t* data, size_t size) override;
+  void stop() override;
+  bool setAddress(const uint8_t address[6]) override;
+
+ private:
+  bool extended = false;
+  bool running = false;
+  uint8_t handle = 0;
+  bool customAddress = false;
+  uint8_t address[6];  // Least significant byte first, as HCI takes it
+};
 
 /**
  * @brief Platform-specific implementation of BThome V2
@@ -249,17 +889,27 @@ class BThomeV2Device : public BThomeV2 {
   bool startAdvertising() override;
   void stopAdvertising() override;
   bool setMAC(const uint8_t mac[6]) override;
+  BThomeV2Stats getStats() const override;
 
   /**
    * @brief Update advertising data with current measurements
-   * Call this after adding/changing measurements to update the advertisement
+   * Call this after adding/changing measurements to update the advertisement.
+   * Measurements within their deadbands leave the radio alone, see
+   * setDeadband() and setPublishIntervals().
    * @return true if advertising data was updated successfully
    */
   bool updateAdvertising();
 
+  /**
+   * @brief Publish deferred deadband changes and heartbeats, back off to the
+   * slow advertising interval after a burst, rotate through the frames of
+   * oversized measurement sets and record and replay the backlog
+   * Call this from loop().
+   */
+  void poll();
+
  private:
-  ::BtHomeV2Device*
-      btHomeDevice;  // Pointer to integrated BTHomeV2 device instance
+  ArduinoBleRadio radio;
   char deviceName[32] = "BThome";
   bool initialized = false;
 };
@@ -269,8 +919,46 @@ class BThomeV2Device : public BThomeV2 {
 
 #include <bluefruit.h>
 
-// Forward declaration for integrated BTHomeV2 encoding library
-class BtHomeV2Device;
+// SoftDevices with BLE 5 advertising sets
+#if defined(BLE_GAP_ADV_SET_DATA_SIZE_EXTENDED_MAX_SUPPORTED)
+#define BTHOME_EXTENDED_ADVERTISING_SUPPORTED 1
+#else
+#define BTHOME_EXTENDED_ADVERTISING_SUPPORTED 0
+#endif
+
+/**
+ * @brief SoftDevice advertiser
+ *
+ * Runs one advertising set on the SoftDevice directly, as Bluefruit.Advertising
+ * can only change its data after stopping: a non-connectable scannable legacy
+ * set with the name in the scan response, or a non-connectable,
+ * non-scannable extended set. The SoftDevice reads the data while
+ * advertising and only takes updates in other buffers, so the data is double
+ * buffered and update() swaps the buffers with sd_ble_gap_adv_set_configure().
+ */
+class BluefruitRadio : public BtHomeRadio {
+ public:
+  void setExtended(bool enabled) { extended = enabled; }
+  bool start(const uint8_t* data, size_t size, uint16_t interval) override;
+  bool update(const uint8_t* data, size_t size) override;
+  void stop() override;
+  /// The SoftDevice has one address for all advertising; it is set before
+  /// the next start() and the scan response (Bluefruit name) is left out.
+  bool setAddress(const uint8_t address[6]) override;
+
+ private:
+  bool configure(const uint8_t* data, size_t size,
+                 const ble_gap_adv_params_t* parameters);
+
+  bool extended = false;
+  bool running = false;
+  bool customAddress = false;
+  ble_gap_addr_t gapAddress;
+  uint8_t handle = BLE_GAP_ADV_SET_HANDLE_NOT_SET;
+  uint8_t buffers[2][MAX_EXTENDED_ADVERTISEMENT_SIZE];
+  uint8_t scanResponses[2][MAX_ADVERTISEMENT_SIZE];
+  uint8_t active = 0;  // Buffer on air
+};
 
 /**
  * @brief Platform-specific implementation of BThome V2
@@ -288,22 +976,38 @@ class BThomeV2Device : public BThomeV2 {
   bool startAdvertising() override;
   void stopAdvertising() override;
   bool setMAC(const uint8_t mac[6]) override;
+  BThomeV2Stats getStats() const override;
 
   /**
    * @brief Update advertising data with current measurements
-   * Call this after adding/changing measurements to update the advertisement
+   * Call this after adding/changing measurements to update the advertisement.
+   * Measurements within their deadbands leave the radio alone, see
+   * setDeadband() and setPublishIntervals().
    * @return true if advertising data was updated successfully
    */
   bool updateAdvertising();
 
+  /**
+   * @brief Publish deferred deadband changes and heartbeats, back off to the
+   * slow advertising interval after a burst, rotate through the frames of
+   * oversized measurement sets and record and replay the backlog
+   * Call this from loop().
+   */
+  void poll();
+
  private:
-  ::BtHomeV2Device*
-      btHomeDevice;  // Pointer to integrated BTHomeV2 device instance
+  BluefruitRadio radio;
   char deviceName[32] = "BThome";
   bool initialized = false;
-  bool advertising = false;
 };
 
+#elif defined(BTHOME_HOST)
+
+// Host builds (see host/CMakeLists.txt) only compile the encoder layers; there
+// is no radio to advertise with, host/shim/MockRadio.h stands in for one.
+// MockRadio takes advertisements of any size.
+#define BTHOME_EXTENDED_ADVERTISING_SUPPORTED 1
+
 #else
 #error "Unsupported platform. This library supports ESP32 and nRF52 only."
 #endif
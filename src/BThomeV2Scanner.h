@@ -0,0 +1,102 @@
+/**
+ * @file BThomeV2Scanner.h
+ * @brief Passive BLE scanner feeding a BTHome receiver (gateway mode).
+ *
+ * The scanner only moves advertisements from the radio into a
+ * BtHomeAdvertisementSink, usually a BtHomeReceiver; filtering, the device
+ * table and de-duplication live in the platform independent receiver.
+ * Results are handed over in poll(), so the table is only touched from
+ * loop() on every platform.
+ *
+ * @code
+ * BtHomeReceiver receiver;
+ * BThomeV2Scanner scanner(receiver);
+ *
+ * void setup() { scanner.begin(); }
+ * void loop() { scanner.poll(); }
+ * @endcode
+ */
+
+#ifndef BTHOMEV2_SCANNER_H
+#define BTHOMEV2_SCANNER_H
+
+#include <Arduino.h>
+
+#include "BtHomeReceiver.h"
+
+#if defined(ESP32)
+
+/// @brief Scanner on top of ArduinoBLE.
+class BThomeV2Scanner {
+ public:
+  explicit BThomeV2Scanner(BtHomeAdvertisementSink& sink);
+  ~BThomeV2Scanner();
+
+  /// @brief Start the BLE stack and scan continuously.
+  bool begin();
+  void end();
+
+  /// @brief Pass the advertisements received since the last call to the
+  /// sink. Call this from loop().
+  /// @return Number of advertisements passed on
+  size_t poll();
+
+ private:
+  BtHomeAdvertisementSink& _sink;
+  bool _scanning = false;
+};
+
+#elif defined(NRF52) || defined(NRF52840_XXAA) || \
+    defined(ARDUINO_NRF52_ADAFRUIT)
+
+#include <bluefruit.h>
+
+/// @brief Scanner on top of Adafruit Bluefruit.
+///
+/// Reports arrive in the Bluefruit task and are queued in a fixed ring until
+/// poll(); reports that do not fit are counted in getDroppedCount().
+class BThomeV2Scanner {
+ public:
+  static const size_t QUEUE_SIZE = 16;
+  /// Legacy advertisements; extended reports are not requested
+  static const size_t MAX_REPORT_SIZE = 31;
+
+  explicit BThomeV2Scanner(BtHomeAdvertisementSink& sink);
+  ~BThomeV2Scanner();
+
+  /// @brief Start the SoftDevice as central and scan continuously. Only one
+  /// scanner can be active.
+  bool begin();
+  void end();
+
+  /// @brief Pass the queued advertisements to the sink. Call this from
+  /// loop().
+  /// @return Number of advertisements passed on
+  size_t poll();
+
+  /// @brief Reports lost because poll() was not called often enough.
+  uint32_t getDroppedCount() const { return _dropped; }
+
+ private:
+  struct Report {
+    uint8_t mac[BLE_ADDRESS_LENGTH];
+    int8_t rssi;
+    uint8_t length;
+    uint8_t data[MAX_REPORT_SIZE];
+    uint32_t time;
+  };
+
+  static void onReport(ble_gap_evt_adv_report_t* report);
+
+  BtHomeAdvertisementSink& _sink;
+  Report _queue[QUEUE_SIZE];
+  // Written by the Bluefruit task (_head) and loop() (_tail) only
+  volatile uint8_t _head = 0;
+  volatile uint8_t _tail = 0;
+  volatile uint32_t _dropped = 0;
+  bool _scanning = false;
+};
+
+#endif
+
+#endif  // BTHOMEV2_SCANNER_H
@@ -0,0 +1,74 @@
+/**
+ * @file BThomeV2Scanner_ESP32.cpp
+ * @brief ESP32 BLE scanner for gateway mode using ArduinoBLE
+ */
+
+#if defined(ESP32)
+
+#include <ArduinoBLE.h>
+
+#include "BThomeV2Scanner.h"
+
+// Legacy advertising data; extended reports are not delivered by ArduinoBLE
+static const int MAX_REPORT_SIZE = 31;
+
+/// @brief Parse "aa:bb:cc:dd:ee:ff" into bytes, most significant first.
+static bool parseAddress(const String& text, uint8_t mac[BLE_ADDRESS_LENGTH]) {
+  if (text.length() != 3 * BLE_ADDRESS_LENGTH - 1) {
+    return false;
+  }
+  for (uint8_t i = 0; i < BLE_ADDRESS_LENGTH; i++) {
+    char* end = nullptr;
+    mac[i] = strtoul(text.c_str() + 3 * i, &end, 16);
+    if (end != text.c_str() + 3 * i + 2) {
+      return false;
+    }
+  }
+  return true;
+}
+
+BThomeV2Scanner::BThomeV2Scanner(BtHomeAdvertisementSink& sink)
+    : _sink(sink) {}
+
+BThomeV2Scanner::~BThomeV2Scanner() { end(); }
+
+bool BThomeV2Scanner::begin() {
+  if (_scanning) {
+    return true;
+  }
+  if (!BLE.begin()) {
+    return false;
+  }
+  // Sensors repeat unchanged packets; the receiver drops those itself, so
+  // the controller must not filter new packets of known senders
+  _scanning = BLE.scan(true);
+  return _scanning;
+}
+
+void BThomeV2Scanner::end() {
+  if (_scanning) {
+    BLE.stopScan();
+    _scanning = false;
+  }
+}
+
+size_t BThomeV2Scanner::poll() {
+  if (!_scanning) {
+    return 0;
+  }
+  BLE.poll();
+  size_t count = 0;
+  uint8_t mac[BLE_ADDRESS_LENGTH];
+  uint8_t data[MAX_REPORT_SIZE];
+  for (BLEDevice device = BLE.available(); device; device = BLE.available()) {
+    int length = device.advertisementData(data, sizeof(data));
+    if (length <= 0 || !parseAddress(device.address(), mac)) {
+      continue;
+    }
+    _sink.process(mac, data, length, device.rssi(), millis());
+    count++;
+  }
+  return count;
+}
+
+#endif  // ESP32
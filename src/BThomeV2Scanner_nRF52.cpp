@@ -0,0 +1,92 @@
+/**
+ * @file BThomeV2Scanner_nRF52.cpp
+ * @brief nRF52 BLE scanner for gateway mode using Adafruit Bluefruit
+ */
+
+#if defined(NRF52) || defined(NRF52840_XXAA) || defined(ARDUINO_NRF52_ADAFRUIT)
+
+#include <bluefruit.h>
+
+#include "BThomeV2Scanner.h"
+
+// Scan window and interval in 0.625 ms units: listen 100 % of the time
+static const uint16_t SCAN_INTERVAL = 160;
+static const uint16_t SCAN_WINDOW = 160;
+
+// Bluefruit takes a plain function as callback
+static BThomeV2Scanner* activeScanner = nullptr;
+
+BThomeV2Scanner::BThomeV2Scanner(BtHomeAdvertisementSink& sink)
+    : _sink(sink) {}
+
+BThomeV2Scanner::~BThomeV2Scanner() { end(); }
+
+bool BThomeV2Scanner::begin() {
+  if (_scanning) {
+    return true;
+  }
+  if (activeScanner) {
+    return false;
+  }
+  // No peripheral connections, one central link for the scanner
+  if (!Bluefruit.begin(0, 1)) {
+    return false;
+  }
+  activeScanner = this;
+  Bluefruit.Scanner.setRxCallback(onReport);
+  Bluefruit.Scanner.restartOnDisconnect(true);
+  Bluefruit.Scanner.setInterval(SCAN_INTERVAL, SCAN_WINDOW);
+  // Passive: BTHome data is in the advertisement, not the scan response
+  Bluefruit.Scanner.useActiveScan(false);
+  _scanning = Bluefruit.Scanner.start(0);
+  if (!_scanning) {
+    activeScanner = nullptr;
+  }
+  return _scanning;
+}
+
+void BThomeV2Scanner::end() {
+  if (_scanning) {
+    Bluefruit.Scanner.stop();
+    activeScanner = nullptr;
+    _scanning = false;
+  }
+}
+
+void BThomeV2Scanner::onReport(ble_gap_evt_adv_report_t* report) {
+  BThomeV2Scanner* scanner = activeScanner;
+  if (scanner) {
+    uint8_t head = scanner->_head;
+    uint8_t next = (head + 1) % QUEUE_SIZE;
+    if (next == scanner->_tail || report->data.len > MAX_REPORT_SIZE) {
+      scanner->_dropped++;
+    } else {
+      Report& entry = scanner->_queue[head];
+      // The SoftDevice reports the address least significant byte first
+      for (uint8_t i = 0; i < BLE_ADDRESS_LENGTH; i++) {
+        entry.mac[i] = report->peer_addr.addr[BLE_ADDRESS_LENGTH - 1 - i];
+      }
+      entry.rssi = report->rssi;
+      entry.length = report->data.len;
+      memcpy(entry.data, report->data.p_data, report->data.len);
+      entry.time = millis();
+      scanner->_head = next;
+    }
+  }
+  // The SoftDevice pauses scanning after every report
+  Bluefruit.Scanner.resume();
+}
+
+size_t BThomeV2Scanner::poll() {
+  size_t count = 0;
+  while (_tail != _head) {
+    const Report& entry = _queue[_tail];
+    _sink.process(entry.mac, entry.data, entry.length, entry.rssi,
+                  entry.time);
+    _tail = (_tail + 1) % QUEUE_SIZE;
+    count++;
+  }
+  return count;
+}
+
+#endif  // NRF52
@@ -7,22 +7,19 @@
 #if defined(ESP32)
 
 #include <ArduinoBLE.h>
+#include <Esp.h>
+
+#include <utility/HCI.h>
 
 #include "BThomeV2.h"
-#include "BtHomeV2Device.h"
+#include "BtHomeLog.h"
 
 // BThome V2 Service UUID
 const uint16_t BTHOME_SERVICE_UUID_16 = 0xFCD2;
 
-BThomeV2Device::BThomeV2Device() : btHomeDevice(nullptr) {}
+BThomeV2Device::BThomeV2Device() {}
 
-BThomeV2Device::~BThomeV2Device() {
-  end();
-  if (btHomeDevice) {
-    delete btHomeDevice;
-    btHomeDevice = nullptr;
-  }
-}
+BThomeV2Device::~BThomeV2Device() { end(); }
 
 bool BThomeV2Device::begin(const char* devName) {
   if (initialized) {
@@ -34,6 +31,7 @@ bool BThomeV2Device::begin(const char* devName) {
 
   // Initialize ArduinoBLE
   if (!BLE.begin()) {
+    BTHOME_LOGE("BLE.begin() failed");
     return false;
   }
 
@@ -41,11 +39,8 @@ bool BThomeV2Device::begin(const char* devName) {
   BLE.setDeviceName(deviceName);
   BLE.setLocalName(deviceName);
 
-  // Create BTHomeV2-Arduino device instance
-  if (btHomeDevice) {
-    delete btHomeDevice;
-  }
-  btHomeDevice = new ::BtHomeV2Device(deviceName, deviceName, false);
+  createEncoder(deviceName);
+  radio.setExtended(extendedAdvertising);
 
   initialized = true;
   return true;
@@ -58,26 +53,18 @@ void BThomeV2Device::end() {
 
   stopAdvertising();
   BLE.end();
-
-  if (btHomeDevice) {
-    delete btHomeDevice;
-    btHomeDevice = nullptr;
-  }
+  deleteEncoder();
 
   initialized = false;
 }
 
 bool BThomeV2Device::startAdvertising() {
-  if (!initialized || !btHomeDevice) {
-    return false;
-  }
-
-  return updateAdvertising();
+  return initialized && updateAdvertising();
 }
 
 void BThomeV2Device::stopAdvertising() {
   if (initialized) {
-    BLE.stopAdvertise();
+    stopRadio(radio);
   }
 }
 
@@ -87,134 +74,233 @@ bool BThomeV2Device::setMAC(const uint8_t mac[6]) {
   return false;
 }
 
+BThomeV2Stats BThomeV2Device::getStats() const {
+  BThomeV2Stats result = BThomeV2::getStats();
+  result.heapHighWater = ESP.getHeapSize() - ESP.getMinFreeHeap();
+  return result;
+}
+
 bool BThomeV2Device::updateAdvertising() {
-  if (!initialized || !btHomeDevice) {
+  return initialized && updateRadio(radio, millis());
+}
+
+void BThomeV2Device::poll() { pollRadio(radio, millis()); }
+
+/// @brief Legacy advertisements restart through BLE, which sends the
+/// parameters, data and scan response (local name) before enabling.
+static bool startLegacyAdvertising(const uint8_t* data, size_t size,
+                                   uint16_t interval) {
+  if (size > MAX_ADVERTISEMENT_SIZE) {
     return false;
   }
+  BLE.stopAdvertise();
+  BLEAdvertisingData advData;
+  advData.setRawData(data, size);
+  BLE.setAdvertisingData(advData);
+  BLE.setAdvertisingInterval(interval);
+  return BLE.advertise();
+}
 
-  // Clear the BTHomeV2-Arduino device's measurement data
-  btHomeDevice->clearMeasurementData();
-
-  // Add all measurements from our base class to the BTHomeV2-Arduino device
-  for (const auto& measurement : measurements) {
-    switch (measurement.objectId) {
-      case TEMPERATURE:
-        if (measurement.data.size() == 2) {
-          // Decode int16 temperature (0.01 °C resolution)
-          int16_t temp =
-              (int16_t)(measurement.data[0] | (measurement.data[1] << 8));
-          btHomeDevice->addTemperature_neg327_to_327_Resolution_0_01(temp /
-                                                                     100.0f);
-        }
-        break;
-
-      case HUMIDITY:
-        if (measurement.data.size() == 2) {
-          // Decode uint16 humidity (0.01 % resolution)
-          uint16_t hum =
-              (uint16_t)(measurement.data[0] | (measurement.data[1] << 8));
-          btHomeDevice->addHumidityPercent_Resolution_0_01(hum / 100.0f);
-        }
-        break;
-
-      case BATTERY:
-        if (measurement.data.size() == 1) {
-          btHomeDevice->addBatteryPercentage(measurement.data[0]);
-        }
-        break;
-
-      case PRESSURE:
-        if (measurement.data.size() == 3) {
-          // Decode uint24 pressure (0.01 hPa resolution)
-          uint32_t pressure =
-              (uint32_t)(measurement.data[0] | (measurement.data[1] << 8) |
-                         (measurement.data[2] << 16));
-          btHomeDevice->addPressureHpa(pressure / 100.0f);
-        }
-        break;
-
-      case ILLUMINANCE:
-        if (measurement.data.size() == 3) {
-          // Decode uint24 illuminance (0.01 lux resolution)
-          uint32_t lux =
-              (uint32_t)(measurement.data[0] | (measurement.data[1] << 8) |
-                         (measurement.data[2] << 16));
-          btHomeDevice->addIlluminanceLux(lux / 100.0f);
-        }
-        break;
-
-      case CO2:
-        if (measurement.data.size() == 2) {
-          uint16_t co2 =
-              (uint16_t)(measurement.data[0] | (measurement.data[1] << 8));
-          btHomeDevice->addCo2Ppm(co2);
-        }
-        break;
-
-      // Binary sensors
-      case BATTERY_LOW:
-        if (measurement.data.size() == 1) {
-          btHomeDevice->setBatteryState(
-              measurement.data[0] ? BATTERY_STATE_LOW : BATTERY_STATE_NORMAL);
-        }
-        break;
-
-      case MOTION:
-        if (measurement.data.size() == 1) {
-          btHomeDevice->setMotionState(measurement.data[0]
-                                           ? Motion_Sensor_Status_Detected
-                                           : Motion_Sensor_Status_Clear);
-        }
-        break;
-
-      case DOOR:
-        if (measurement.data.size() == 1) {
-          btHomeDevice->setDoorState(measurement.data[0]
-                                         ? Door_Sensor_Status_Open
-                                         : Door_Sensor_Status_Closed);
-        }
-        break;
-
-      case WINDOW:
-        if (measurement.data.size() == 1) {
-          btHomeDevice->setWindowState(measurement.data[0]
-                                           ? Window_Sensor_Status_Open
-                                           : Window_Sensor_Status_Closed);
-        }
-        break;
-
-      case BUTTON:
-        if (measurement.data.size() == 1) {
-          btHomeDevice->setButtonEvent(
-              (Button_Event_Status)measurement.data[0]);
-        }
-        break;
-
-      default:
-        // Unsupported sensor type - skip
-        break;
-    }
+// HCI LE commands for legacy advertising from a random address (OGF 0x08)
+static const uint16_t HCI_LE_SET_RANDOM_ADDRESS = 0x2005;
+static const uint16_t HCI_LE_SET_ADV_PARAMETERS = 0x2006;
+static const uint16_t HCI_LE_SET_ADV_ENABLE = 0x200A;
+// Non-connectable undirected advertising (ADV_NONCONN_IND)
+static const uint8_t ADV_NONCONN_IND = 0x03;
+static const uint8_t OWN_ADDRESS_RANDOM = 0x01;
+
+/// @brief BLE.advertise() always sends from the public address, so legacy
+/// advertising from a random address is configured with HCI commands.
+static bool startLegacyAdvertisingFrom(uint8_t address[6],
+                                       const uint8_t* data, size_t size,
+                                       uint16_t interval) {
+  if (size > MAX_ADVERTISEMENT_SIZE) {
+    return false;
+  }
+  BLE.stopAdvertise();
+  // The random address can only change while advertising is disabled
+  if (HCI.sendCommand(HCI_LE_SET_RANDOM_ADDRESS, 6, address) != 0) {
+    return false;
+  }
+  // Intervals (2 x 2), type, own and peer address type, peer address,
+  // channel map, filter policy
+  uint8_t parameters[15] = {0};
+  parameters[0] = interval & 0xFF;
+  parameters[1] = interval >> 8;
+  parameters[2] = interval & 0xFF;
+  parameters[3] = interval >> 8;
+  parameters[4] = ADV_NONCONN_IND;
+  parameters[5] = OWN_ADDRESS_RANDOM;
+  parameters[13] = 0x07;  // All three primary channels
+  if (HCI.sendCommand(HCI_LE_SET_ADV_PARAMETERS, sizeof(parameters),
+                      parameters) != 0) {
+    return false;
+  }
+  uint8_t command[MAX_ADVERTISEMENT_SIZE];
+  memcpy(command, data, size);
+  uint8_t enable = 0x01;
+  return HCI.leSetAdvertisingData(size, command) == 0 &&
+         HCI.sendCommand(HCI_LE_SET_ADV_ENABLE, 1, &enable) == 0;
+}
+
+/// @brief LE Set Advertising Data is allowed while advertising; the
+/// controller sends the new data from its next event on.
+static bool updateLegacyAdvertising(const uint8_t* data, size_t size) {
+  if (size > MAX_ADVERTISEMENT_SIZE) {
+    return false;
   }
+  uint8_t command[MAX_ADVERTISEMENT_SIZE];
+  memcpy(command, data, size);
+  return HCI.leSetAdvertisingData(size, command) == 0;
+}
+
+#if BTHOME_EXTENDED_ADVERTISING_SUPPORTED
+
+// HCI LE commands for BLE 5 advertising sets (OGF 0x08)
+static const uint16_t HCI_LE_SET_ADV_SET_RANDOM_ADDRESS = 0x2035;
+static const uint16_t HCI_LE_SET_EXT_ADV_PARAMETERS = 0x2036;
+static const uint16_t HCI_LE_SET_EXT_ADV_DATA = 0x2037;
+static const uint16_t HCI_LE_SET_EXT_ADV_ENABLE = 0x2039;
+// Advertising data carried by one LE Set Extended Advertising Data command
+static const size_t EXT_ADV_FRAGMENT_SIZE = 251;
+// Operation of a command that carries all of the data
+static const uint8_t EXT_ADV_COMPLETE_DATA = 0x03;
+
+static bool setExtendedAdvertisingEnabled(uint8_t handle, bool enabled) {
+  // Enable, number of sets, handle, duration (2), max events
+  uint8_t parameters[6] = {static_cast<uint8_t>(enabled), 1, handle, 0, 0, 0};
+  return HCI.sendCommand(HCI_LE_SET_EXT_ADV_ENABLE, sizeof(parameters),
+                         parameters) == 0;
+}
 
-  // Get the advertisement data from BTHomeV2-Arduino
-  uint8_t advertisementData[MAX_ADVERTISEMENT_SIZE];
-  size_t size = btHomeDevice->getAdvertisementData(advertisementData);
+/// @brief Sends data to advertising set handle, in fragments above 251
+/// bytes.
+static bool setExtendedAdvertisingData(uint8_t handle, const uint8_t* data,
+                                       size_t size) {
+  uint8_t command[4 + EXT_ADV_FRAGMENT_SIZE];
+  size_t offset = 0;
+  do {
+    size_t length = size - offset < EXT_ADV_FRAGMENT_SIZE
+                        ? size - offset
+                        : EXT_ADV_FRAGMENT_SIZE;
+    bool first = offset == 0;
+    bool last = offset + length == size;
+    command[0] = handle;
+    command[1] = first && last ? EXT_ADV_COMPLETE_DATA
+                               : (first ? 0x01 : (last ? 0x02 : 0x00));
+    command[2] = 0x01;  // Prefer no fragmentation by the controller
+    command[3] = length;
+    memcpy(&command[4], &data[offset], length);
+    if (HCI.sendCommand(HCI_LE_SET_EXT_ADV_DATA, 4 + length, command) != 0) {
+      return false;
+    }
+    offset += length;
+  } while (offset < size);
+  return true;
+}
+
+/// @brief (Re)starts advertising set handle with data as non-connectable,
+/// non-scannable extended advertisement on the 1M PHY.
+/// @param address Random address of the set (LSB first), nullptr for the
+/// public address
+static bool startExtendedAdvertising(uint8_t handle, const uint8_t* address,
+                                     const uint8_t* data, size_t size,
+                                     uint16_t interval, bool running) {
+  if (running) {
+    setExtendedAdvertisingEnabled(handle, false);
+  }
 
-  if (size == 0 || size > MAX_ADVERTISEMENT_SIZE) {
+  // Event properties 0: non-connectable, non-scannable, undirected
+  uint8_t parameters[25] = {0};
+  parameters[0] = handle;
+  parameters[3] = interval & 0xFF;  // Minimum interval (3 bytes, 0.625 ms)
+  parameters[4] = interval >> 8;
+  parameters[6] = interval & 0xFF;  // Maximum interval
+  parameters[7] = interval >> 8;
+  parameters[9] = 0x07;  // All three primary channels
+  parameters[10] = address ? OWN_ADDRESS_RANDOM : 0x00;
+  parameters[19] = 0x7F;  // No TX power preference
+  parameters[20] = 0x01;  // Primary PHY: LE 1M
+  parameters[22] = 0x01;  // Secondary PHY: LE 1M
+  parameters[23] = handle & 0x0F;  // Advertising SID
+  if (HCI.sendCommand(HCI_LE_SET_EXT_ADV_PARAMETERS, sizeof(parameters),
+                      parameters) != 0) {
     return false;
   }
+  if (address) {
+    uint8_t command[7] = {handle};
+    memcpy(&command[1], address, 6);
+    if (HCI.sendCommand(HCI_LE_SET_ADV_SET_RANDOM_ADDRESS, sizeof(command),
+                        command) != 0) {
+      return false;
+    }
+  }
+  return setExtendedAdvertisingData(handle, data, size) &&
+         setExtendedAdvertisingEnabled(handle, true);
+}
 
-  // Stop any existing advertising
-  BLE.stopAdvertise();
+/// @brief An enabled set only takes data in one command (complete data).
+static bool updateExtendedAdvertising(uint8_t handle, const uint8_t* data,
+                                      size_t size) {
+  return size <= EXT_ADV_FRAGMENT_SIZE &&
+         setExtendedAdvertisingData(handle, data, size);
+}
 
-  // Set raw advertising data
-  BLEAdvertisingData advData;
-  advData.setRawData(advertisementData, size);
-  BLE.setAdvertisingData(advData);
+static void stopExtendedAdvertising(uint8_t handle) {
+  setExtendedAdvertisingEnabled(handle, false);
+}
 
-  // Start advertising
-  BLE.advertise();
+#else
 
+static bool startExtendedAdvertising(uint8_t, const uint8_t*, const uint8_t*,
+                                     size_t, uint16_t, bool) {
+  return false;
+}
+
+static bool updateExtendedAdvertising(uint8_t, const uint8_t*, size_t) {
+  return false;
+}
+
+static void stopExtendedAdvertising(uint8_t) {}
+
+#endif  // BTHOME_EXTENDED_ADVERTISING_SUPPORTED
+
+bool ArduinoBleRadio::start(const uint8_t* data, size_t size,
+                            uint16_t interval) {
+  const uint8_t* ownAddress = customAddress ? address : nullptr;
+  if (extended) {
+    running = startExtendedAdvertising(handle, ownAddress, data, size,
+                                       interval, running);
+  } else if (customAddress) {
+    running = startLegacyAdvertisingFrom(address, data, size, interval);
+  } else {
+    running = startLegacyAdvertising(data, size, interval);
+  }
+  return running;
+}
+
+bool ArduinoBleRadio::update(const uint8_t* data, size_t size) {
+  if (!running) {
+    return false;
+  }
+  return extended ? updateExtendedAdvertising(handle, data, size)
+                  : updateLegacyAdvertising(data, size);
+}
+
+void ArduinoBleRadio::stop() {
+  if (extended) {
+    stopExtendedAdvertising(handle);
+  } else {
+    BLE.stopAdvertise();
+  }
+  running = false;
+}
+
+bool ArduinoBleRadio::setAddress(const uint8_t newAddress[6]) {
+  for (int i = 0; i < 6; i++) {
+    address[i] = newAddress[5 - i];
+  }
+  customAddress = true;
   return true;
 }
 
@@ -12,21 +12,18 @@
 #include <Arduino.h>
 #include <data_types.h>
 
+#include "BtHomeTrace.h"
+#include "CcmBackend.h"
+#include "CounterStorage.h"
 #include "definitions.h"
 
-// Include mbedtls only on platforms that support it
-#if defined(ESP32) || defined(ESP8266)
-#include "mbedtls/ccm.h"
+// Every platform encrypts; SoftwareCcm covers those without mbedtls
 #define BTHOME_ENCRYPTION_SUPPORTED 1
-#else
-// For platforms without mbedtls, define a dummy structure
-typedef struct {
-  unsigned char dummy;
-} mbedtls_ccm_context;
-#define BTHOME_ENCRYPTION_SUPPORTED 0
-#endif
 
+// Largest legacy (BLE 4.x) advertisement.
 static const size_t MAX_ADVERTISEMENT_SIZE = 31;
+// Largest BLE 5 extended advertisement built by this library.
+static const size_t MAX_EXTENDED_ADVERTISEMENT_SIZE = 255;
 static const size_t HEADER_SIZE = 9;
 static const size_t MAX_MEASUREMENT_SIZE = MAX_ADVERTISEMENT_SIZE - HEADER_SIZE;
 static const size_t TYPE_INDICATOR_SIZE = 1;
@@ -35,44 +32,740 @@ static const size_t ENCRYPTION_KEY_LENGTH = 16;
 static const size_t BLE_MAC_ADDRESS_LENGTH = 6;
 static const size_t NONCE_LEN = 13;
 static const size_t MIC_LEN = 4;
+static const size_t COUNTER_LEN = 4;
+// Counter and MIC appended behind the ciphertext of encrypted packets.
+static const size_t ENCRYPTION_TRAILER_SIZE = COUNTER_LEN + MIC_LEN;
+// Measurement bytes that fit behind the 8 byte flags/service data header.
+static const size_t MEASUREMENT_ARENA_SIZE = MAX_MEASUREMENT_SIZE + 1;
+// Offset of the first measurement byte in an advertisement.
+static const size_t MEASUREMENT_OFFSET =
+    MAX_ADVERTISEMENT_SIZE - MEASUREMENT_ARENA_SIZE;
+// Smallest object is an id byte plus one data byte.
+static const size_t MAX_MEASUREMENT_COUNT = MEASUREMENT_ARENA_SIZE / 2;
+// Packet id object (id byte and one counter byte).
+static const uint8_t PACKET_ID_SIZE = 2;
 
 #define BIND_KEY_LEN 16
 #define ENCRYPTION_ADDITIONAL_BYTES 12
 
-class BaseDevice {
+/// @brief Counters of an encoder since construction or resetStats(). A few
+/// increments per packet, cheap enough to leave on.
+struct BtHomeEncoderStats {
+  uint32_t packetsBuilt;    // Advertisements built, not reused
+  uint32_t bytesBuilt;      // Sum of their sizes
+  uint32_t lastPacketSize;  // Size of the last one
+  uint32_t droppedObjects;  // Objects rejected for lack of space
+  uint32_t encryptions;
+  uint32_t encryptionMicros;  // Sum over all encryptions
+  uint32_t maxEncryptionMicros;
+};
+
+/// @brief BTHome encoder for advertisements of up to MaxSize bytes.
+/// @tparam MaxSize MAX_ADVERTISEMENT_SIZE for legacy advertising,
+/// MAX_EXTENDED_ADVERTISEMENT_SIZE for BLE 5 extended advertising or any
+/// size in between (e.g. the advertising data limit of a controller). The
+/// first two are compiled in BaseDevice.cpp, others where they are used.
+template <size_t MaxSize>
+class BasicBaseDevice {
  public:
-  BaseDevice(const char* shortName, const char* completeName,
-             bool isTriggerBased, uint8_t const* const key,
-             const uint8_t macAddress[BLE_MAC_ADDRESS_LENGTH],
-             uint32_t counter);
-  BaseDevice(const char* shortName, const char* completeName,
-             bool isTriggerBased);
-  size_t getAdvertisementData(uint8_t buffer[MAX_ADVERTISEMENT_SIZE]);
+  static_assert(MaxSize >= MAX_ADVERTISEMENT_SIZE &&
+                    MaxSize <= MAX_EXTENDED_ADVERTISEMENT_SIZE,
+                "Advertisements hold 31 to 255 bytes");
+
+  /// Measurement bytes that fit behind the flags/service data header.
+  static const size_t ARENA_SIZE = MaxSize - MEASUREMENT_OFFSET;
+  /// Smallest object is an id byte plus one data byte.
+  static const size_t MAX_ENTRIES = ARENA_SIZE / 2;
+
+  /// @brief Encrypting encoder.
+  /// @param key Bind key, 16 bytes
+  /// @param macAddress Bluetooth MAC of the sender, least significant byte
+  /// first (AA:BB:CC:DD:EE:FF is {0xFF, 0xEE, 0xDD, 0xCC, 0xBB, 0xAA}); the
+  /// receiver builds the nonce from the MAC it sees, so a wrong order fails
+  /// every MIC check
+  /// @param counter Counter of the first encrypted packet
+  BasicBaseDevice(const char* shortName, const char* completeName,
+                  bool isTriggerBased, uint8_t const* const key,
+                  const uint8_t macAddress[BLE_MAC_ADDRESS_LENGTH],
+                  uint32_t counter);
+  BasicBaseDevice(const char* shortName, const char* completeName,
+                  bool isTriggerBased);
+  size_t getAdvertisementData(uint8_t buffer[MaxSize]);
+  bool hasChanged() const;
+  bool setPacketIdEnabled(bool enabled);
+  void setPersistentCounter(PersistentCounter* counter);
+  void setCounter(uint32_t counter);
+  void setPacketId(uint8_t packetId);
+  /// Packet id of the last advertisement.
+  uint8_t getPacketId() const { return _packetId; }
+  void setCcmBackend(CcmBackend* backend);
+  bool precomputeEncryption();
   void resetMeasurement();
   bool addState(BtHomeState, uint8_t state);
   bool addState(BtHomeState sensor, uint8_t state, uint8_t steps);
   bool addUnsignedInteger(BtHomeType sensor, uint64_t value);
   bool addSignedInteger(BtHomeType sensor, int64_t value);
   bool addFloat(BtHomeType sensor, float value);
+  bool addFixedPoint(BtHomeType sensor, int64_t value, uint32_t divisor);
   bool addRaw(uint8_t sensor, uint8_t* value, uint8_t size);
+  bool addEncoded(uint8_t sensor, const uint8_t* value, uint8_t size);
+  bool updateEncoded(uint8_t sensor, uint8_t occurrence, const uint8_t* value,
+                     uint8_t size);
+  /// Objects in the measurement arena.
+  uint8_t getEntryCount() const { return _entryCount; }
+  size_t encryptMeasurements(const uint8_t* plaintext, size_t length,
+                             uint8_t* output);
+  const BtHomeEncoderStats& getStats() const { return _stats; }
+  void resetStats();
+  /// Counter of the next encrypted packet.
+  uint32_t getCounter() const { return _counter; }
 
  private:
+  // Inputs are clamped to this magnitude before scaling so that multiplying
+  // by a scale denominator cannot overflow; it is far beyond any 4 byte
+  // value.
+  static const int64_t MAX_UNSCALED = static_cast<int64_t>(1) << 40;
+
   bool pushBytes(uint64_t value2, BtHomeState sensor);
+  uint8_t* reserveEntry(uint8_t sensorId, uint8_t size);
+  // Measurements are kept id-ordered in a fixed inline arena so building an
+  // advertisement never allocates or sorts.
   uint8_t _sensorDataIdx = 0;
-  std::vector<std::vector<uint8_t>> _sensorData;
+  uint8_t _sensorData[ARENA_SIZE];
+  uint8_t _entryCount = 0;
+  uint8_t _entryOffsets[MAX_ENTRIES];
+  // Last built advertisement; reused while the measurements stay the same.
+  uint8_t _lastAdvertisement[MaxSize];
+  uint8_t _lastAdvertisementSize = 0;
+  // Plaintext measurements of the last advertisement.
+  uint8_t _lastMeasurements[ARENA_SIZE];
+  uint8_t _lastMeasurementSize = 0;
+  // Packet id (object 0x00) sent in front of the measurements when enabled.
+  bool _usePacketId = false;
+  uint8_t _packetId = 0;
   char _shortName[MAX_LENGTH_SHORT_NAME + NULL_TERMINATOR_SIZE];
   char _completeName[MAX_LENGTH_COMPLETE_NAME + NULL_TERMINATOR_SIZE];
+  bool measurementsChanged() const;
+  int remainingBytes() const;
   bool hasEnoughSpace(BtHomeState sensor);
   bool hasEnoughSpace(uint8_t size);
-  template <typename T>
-  bool addInteger(BtHomeType sensor, T value);
+  static uint64_t toRaw(const BtHomeType& sensor, float value);
+  static int64_t saturate(const BtHomeType& sensor, int64_t raw);
   bool _triggerDevice = false;
   bool _useEncryption = false;
   uint32_t _counter = 1;
-  mbedtls_ccm_context _encryptCTX;
+  PersistentCounter* _persistentCounter = nullptr;
+  // Custom backend set with setCcmBackend(), otherwise _defaultCcm is used.
+  CcmBackend* _ccm = nullptr;
+  DefaultCcm _defaultCcm;
+  // Keystream of the next packet, see precomputeEncryption().
+  static const uint8_t KEYSTREAM_INVALID = 0xFF;
+  bool _precomputed = false;
+  uint8_t _precomputedLength = KEYSTREAM_INVALID;
+  uint32_t _precomputedCounter = 0;
+  uint8_t _precomputedState[AES_BLOCK_SIZE];
+  uint8_t _keystream[CCM_TAG_LENGTH + ARENA_SIZE];
   uint8_t _macAddress[BLE_MAC_ADDRESS_LENGTH];
   uint8_t bindKey[BIND_KEY_LEN];
-  size_t getMeasurementByteArray(uint8_t sortedBytes[MAX_ADVERTISEMENT_SIZE]);
+  BtHomeEncoderStats _stats;
+  void buildNonce(uint32_t counter, uint8_t nonce[NONCE_LEN]) const;
+  size_t getMeasurementByteArray(uint8_t sortedBytes[ARENA_SIZE]);
+  size_t patchAdvertisement(uint8_t buffer[MaxSize]);
 };
 
+template <size_t MaxSize>
+const size_t BasicBaseDevice<MaxSize>::ARENA_SIZE;
+template <size_t MaxSize>
+const size_t BasicBaseDevice<MaxSize>::MAX_ENTRIES;
+template <size_t MaxSize>
+const int64_t BasicBaseDevice<MaxSize>::MAX_UNSCALED;
+
+template <size_t MaxSize>
+BasicBaseDevice<MaxSize>::BasicBaseDevice(const char* shortName,
+                                          const char* completeName,
+                                          bool isTriggerBased)
+    : _triggerDevice(isTriggerBased) {
+  strncpy(_shortName, shortName, MAX_LENGTH_SHORT_NAME);
+  _shortName[MAX_LENGTH_SHORT_NAME] = '\0';
+
+  strncpy(_completeName, completeName, MAX_LENGTH_COMPLETE_NAME);
+  _completeName[MAX_LENGTH_COMPLETE_NAME] = '\0';
+
+  resetMeasurement();
+  resetStats();
+}
+
+template <size_t MaxSize>
+BasicBaseDevice<MaxSize>::BasicBaseDevice(
+    const char* shortName, const char* completeName, bool isTriggerBased,
+    uint8_t const* const key, const uint8_t macAddress[BLE_MAC_ADDRESS_LENGTH],
+    uint32_t counter)
+    : BasicBaseDevice(shortName, completeName, isTriggerBased) {
+  _useEncryption = true;
+  _counter = counter;
+
+  memcpy(bindKey, key, sizeof(uint8_t) * BIND_KEY_LEN);
+  memcpy(_macAddress, macAddress, BLE_MAC_ADDRESS_LENGTH);
+  _defaultCcm.setKey(bindKey);
+}
+
+template <size_t MaxSize>
+void BasicBaseDevice<MaxSize>::resetMeasurement() {
+  _sensorDataIdx = 0;
+  _entryCount = 0;
+}
+
+template <size_t MaxSize>
+void BasicBaseDevice<MaxSize>::resetStats() {
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+template <size_t MaxSize>
+bool BasicBaseDevice<MaxSize>::hasEnoughSpace(BtHomeState sensor) {
+  return hasEnoughSpace(sensor.byteCount + TYPE_INDICATOR_SIZE);
+}
+
+/// @brief Free measurement bytes, without counting anything.
+template <size_t MaxSize>
+int BasicBaseDevice<MaxSize>::remainingBytes() const {
+  return static_cast<int>(ARENA_SIZE) - _sensorDataIdx -
+         (_useEncryption ? ENCRYPTION_ADDITIONAL_BYTES : 0) -
+         (_usePacketId ? PACKET_ID_SIZE : 0);
+}
+
+/// @brief Space check of the add* methods; counts a refused object as
+/// dropped.
+template <size_t MaxSize>
+bool BasicBaseDevice<MaxSize>::hasEnoughSpace(uint8_t size) {
+  if (remainingBytes() < size || _entryCount >= MAX_ENTRIES) {
+    _stats.droppedObjects++;
+    return false;
+  }
+  return true;
+}
+
+template <size_t MaxSize>
+bool BasicBaseDevice<MaxSize>::addState(BtHomeState sensor, uint8_t state) {
+  if (!hasEnoughSpace(sensor)) {
+    return false;
+  }
+  return pushBytes(state, sensor);
+}
+
+template <size_t MaxSize>
+bool BasicBaseDevice<MaxSize>::addState(BtHomeState sensor, uint8_t state,
+                                        uint8_t steps) {
+  if (!hasEnoughSpace(sensor)) {
+    return false;
+  }
+  uint16_t stepState = ((uint16_t)steps << 8 | state);
+  return pushBytes(stepState, sensor);
+}
+
+template <size_t MaxSize>
+bool BasicBaseDevice<MaxSize>::addUnsignedInteger(BtHomeType sensor,
+                                                  uint64_t value) {
+  int64_t clamped = value > static_cast<uint64_t>(MAX_UNSCALED)
+                        ? MAX_UNSCALED
+                        : static_cast<int64_t>(value);
+  return addFixedPoint(sensor, clamped, 1);
+}
+
+template <size_t MaxSize>
+bool BasicBaseDevice<MaxSize>::addSignedInteger(BtHomeType sensor,
+                                                int64_t value) {
+  return addFixedPoint(sensor, value, 1);
+}
+
+/// @brief Adds a fixed-point value using integer arithmetic only.
+/// @param sensor Type of the value
+/// @param value Value in units of 1/divisor (e.g. 2137 for 21.37 with a
+/// divisor of 100)
+/// @param divisor Units per whole, must not be 0
+/// @return false if the value does not fit into the packet
+template <size_t MaxSize>
+bool BasicBaseDevice<MaxSize>::addFixedPoint(BtHomeType sensor, int64_t value,
+                                             uint32_t divisor) {
+  if (!hasEnoughSpace(sensor)) {
+    return false;
+  }
+  if (sensor.exactScale.numerator == 0) {
+    return pushBytes(toRaw(sensor, static_cast<float>(value) / divisor),
+                     sensor);
+  }
+
+  // raw = value / divisor / (numerator / denominator)
+  int64_t multiplier = sensor.exactScale.denominator;
+  int64_t quotient =
+      static_cast<int64_t>(sensor.exactScale.numerator) * divisor;
+  int64_t raw = value < -MAX_UNSCALED
+                    ? -MAX_UNSCALED
+                    : (value > MAX_UNSCALED ? MAX_UNSCALED : value);
+  if (multiplier != quotient) {
+    raw *= multiplier;
+    int64_t half = quotient / 2;
+    raw = (raw < 0 ? raw - half : raw + half) / quotient;
+  }
+  return pushBytes(static_cast<uint64_t>(saturate(sensor, raw)), sensor);
+}
+
+template <size_t MaxSize>
+bool BasicBaseDevice<MaxSize>::addFloat(BtHomeType sensor, float value) {
+  if (!hasEnoughSpace(sensor)) {
+    return false;
+  }
+  return pushBytes(toRaw(sensor, value), sensor);
+}
+
+/// @brief Scales, rounds and saturates a float to the wire value of sensor.
+template <size_t MaxSize>
+uint64_t BasicBaseDevice<MaxSize>::toRaw(const BtHomeType& sensor,
+                                         float value) {
+  float scaledValue = sensor.exactScale.numerator == 1
+                          ? value * sensor.exactScale.denominator
+                          : value / sensor.scale;
+  scaledValue += scaledValue < 0 ? -0.5f : 0.5f;
+
+  int64_t raw = 0;
+  if (scaledValue >= MAX_UNSCALED) {
+    raw = MAX_UNSCALED;
+  } else if (scaledValue <= -MAX_UNSCALED) {
+    raw = -MAX_UNSCALED;
+  } else if (scaledValue == scaledValue) {  // NaN encodes as 0
+    raw = static_cast<int64_t>(scaledValue);
+  }
+  return static_cast<uint64_t>(saturate(sensor, raw));
+}
+
+/// @brief Clamps a wire value to the range of the sensor's byte width.
+template <size_t MaxSize>
+int64_t BasicBaseDevice<MaxSize>::saturate(const BtHomeType& sensor,
+                                           int64_t raw) {
+  uint8_t valueBits = 8 * sensor.byteCount - (sensor.signed_value ? 1 : 0);
+  int64_t maxValue = (static_cast<int64_t>(1) << valueBits) - 1;
+  int64_t minValue = sensor.signed_value ? -maxValue - 1 : 0;
+  return raw < minValue ? minValue : (raw > maxValue ? maxValue : raw);
+}
+
+template <size_t MaxSize>
+bool BasicBaseDevice<MaxSize>::pushBytes(uint64_t value2,
+                                         BtHomeState sensor) {
+  uint8_t* data = reserveEntry(sensor.id, sensor.byteCount);
+
+  for (uint8_t i = 0; i < sensor.byteCount; i++) {
+    data[i] = static_cast<byte>((value2 >> (8 * i)) & 0xff);
+  }
+  return true;
+}
+
+template <size_t MaxSize>
+bool BasicBaseDevice<MaxSize>::addRaw(uint8_t sensorId, uint8_t* value,
+                                      uint8_t size) {
+  static const size_t RAW_HEADER_BYTE_SIZE = 2;
+
+  if (!hasEnoughSpace(size + RAW_HEADER_BYTE_SIZE)) {
+    return false;
+  }
+
+  uint8_t* data = reserveEntry(sensorId, size + 1);
+  data[0] = size;
+  memcpy(&data[1], value, size);
+  return true;
+}
+
+/// @brief Adds an object whose value is already in wire format (little
+/// endian, scaled), without a length byte.
+/// @param size Number of value bytes following the object id
+template <size_t MaxSize>
+bool BasicBaseDevice<MaxSize>::addEncoded(uint8_t sensorId,
+                                          const uint8_t* value, uint8_t size) {
+  if (!hasEnoughSpace(static_cast<uint8_t>(size + TYPE_INDICATOR_SIZE))) {
+    return false;
+  }
+
+  memcpy(reserveEntry(sensorId, size), value, size);
+  return true;
+}
+
+/// @brief Overwrites the value of an object already in the arena, leaving
+/// the others as they are, so the next advertisement only patches it.
+/// @param occurrence Which of the objects with this id, 0 for the first
+/// @param size Number of value bytes, must match the object in the arena
+/// @return false if there is no such object of that size
+template <size_t MaxSize>
+bool BasicBaseDevice<MaxSize>::updateEncoded(uint8_t sensorId,
+                                             uint8_t occurrence,
+                                             const uint8_t* value,
+                                             uint8_t size) {
+  for (uint8_t entry = 0; entry < _entryCount; entry++) {
+    uint8_t offset = _entryOffsets[entry];
+    if (_sensorData[offset] > sensorId) {
+      break;  // Id-ordered: no such object
+    }
+    if (_sensorData[offset] != sensorId || occurrence-- > 0) {
+      continue;
+    }
+    uint8_t end =
+        entry + 1 < _entryCount ? _entryOffsets[entry + 1] : _sensorDataIdx;
+    if (end - offset - TYPE_INDICATOR_SIZE != size) {
+      return false;
+    }
+    memcpy(&_sensorData[offset + TYPE_INDICATOR_SIZE], value, size);
+    return true;
+  }
+  return false;
+}
+
+/// @brief Opens a gap for a new object at its id-ordered position in the
+/// arena. Objects with the same id keep their insertion order.
+/// @param sensorId Object id written in front of the data
+/// @param size Number of data bytes following the object id
+/// @return Pointer to the data bytes of the new entry
+template <size_t MaxSize>
+uint8_t* BasicBaseDevice<MaxSize>::reserveEntry(uint8_t sensorId,
+                                                uint8_t size) {
+  uint8_t entry = _entryCount;
+  while (entry > 0 && _sensorData[_entryOffsets[entry - 1]] > sensorId) {
+    entry--;
+  }
+
+  uint8_t offset = entry < _entryCount ? _entryOffsets[entry] : _sensorDataIdx;
+  uint8_t entrySize = size + TYPE_INDICATOR_SIZE;
+  memmove(&_sensorData[offset + entrySize], &_sensorData[offset],
+          _sensorDataIdx - offset);
+
+  for (uint8_t i = _entryCount; i > entry; i--) {
+    _entryOffsets[i] = _entryOffsets[i - 1] + entrySize;
+  }
+  _entryOffsets[entry] = offset;
+  _entryCount++;
+  _sensorDataIdx += entrySize;
+
+  _sensorData[offset] = sensorId;
+  return &_sensorData[offset + TYPE_INDICATOR_SIZE];
+}
+
+/// @brief Take encryption counters from counter instead of the constructor
+/// argument, so they keep increasing across reboots.
+/// @param counter Started PersistentCounter, or nullptr to count in RAM
+template <size_t MaxSize>
+void BasicBaseDevice<MaxSize>::setPersistentCounter(
+    PersistentCounter* counter) {
+  _persistentCounter = counter;
+  _precomputed = false;
+}
+
+/// @brief Continue counting at counter, e.g. with a value kept in RTC memory
+/// across deep sleep. Ignored while a PersistentCounter is set.
+template <size_t MaxSize>
+void BasicBaseDevice<MaxSize>::setCounter(uint32_t counter) {
+  _counter = counter;
+  _precomputed = false;
+}
+
+/// @brief Continue the packet id sequence after packetId, so the next
+/// changed advertisement sends packetId + 1.
+template <size_t MaxSize>
+void BasicBaseDevice<MaxSize>::setPacketId(uint8_t packetId) {
+  _packetId = packetId;
+}
+
+/// @brief Encrypt with backend instead of the built-in DefaultCcm, e.g. a
+/// hardware AES peripheral.
+/// @param backend Backend with the bind key already set, or nullptr for the
+/// default
+template <size_t MaxSize>
+void BasicBaseDevice<MaxSize>::setCcmBackend(CcmBackend* backend) {
+  _ccm = backend;
+  _precomputed = false;
+}
+
+/// @brief Compute the keystream of the next encrypted packet ahead of time,
+/// e.g. while idle after sending. The next packet then only needs the
+/// CBC-MAC over its measurements.
+///
+/// The keystream is tied to the current measurement length; object values
+/// may change, but a packet of a different length falls back to the normal
+/// path. The counter for the packet is taken now.
+/// @return false if encryption is off, the counter cannot advance or the
+/// backend has no block access (CcmBackend::encryptBlock())
+template <size_t MaxSize>
+bool BasicBaseDevice<MaxSize>::precomputeEncryption() {
+  if (!_useEncryption) {
+    return false;
+  }
+  size_t length = (_usePacketId ? PACKET_ID_SIZE : 0) + _sensorDataIdx;
+  if (_precomputed && length == _precomputedLength) {
+    return true;
+  }
+
+  // Keep a counter that is already taken
+  uint32_t counter = _precomputed ? _precomputedCounter : _counter;
+  if (!_precomputed && _persistentCounter &&
+      !_persistentCounter->next(counter)) {
+    return false;
+  }
+  _precomputedCounter = counter;
+  _precomputed = true;
+
+  uint8_t nonce[NONCE_LEN];
+  buildNonce(counter, nonce);
+  CcmBackend& ccm = _ccm ? *_ccm : _defaultCcm;
+  if (!ccm.precompute(nonce, length, _precomputedState, _keystream)) {
+    _precomputedLength = KEYSTREAM_INVALID;
+    return false;
+  }
+  _precomputedLength = length;
+  return true;
+}
+
+/// @brief Check whether the next advertisement differs from the last one.
+/// Encrypted advertisements always change because the counter advances.
+template <size_t MaxSize>
+bool BasicBaseDevice<MaxSize>::hasChanged() const {
+  return _useEncryption || measurementsChanged();
+}
+
+/// @brief Check whether the measurements differ from the ones of the last
+/// advertisement.
+template <size_t MaxSize>
+bool BasicBaseDevice<MaxSize>::measurementsChanged() const {
+  return _lastAdvertisementSize == 0 ||
+         _lastMeasurementSize != _sensorDataIdx ||
+         memcmp(_lastMeasurements, _sensorData, _sensorDataIdx) != 0;
+}
+
+/// @brief Sends a packet id (object 0x00) in front of the measurements. The
+/// id increments only when the measurements change, so receivers can drop
+/// repeated advertisements of the same reading.
+/// @return false if the current measurements leave no room for the id
+template <size_t MaxSize>
+bool BasicBaseDevice<MaxSize>::setPacketIdEnabled(bool enabled) {
+  // The packet id is no object of the caller, a refusal is no dropped object
+  if (enabled && !_usePacketId && remainingBytes() < PACKET_ID_SIZE) {
+    return false;
+  }
+  if (enabled != _usePacketId) {
+    _usePacketId = enabled;
+    _lastAdvertisementSize = 0;
+  }
+  return true;
+}
+
+template <size_t MaxSize>
+size_t BasicBaseDevice<MaxSize>::getAdvertisementData(uint8_t buffer[MaxSize]) {
+  bool changed = measurementsChanged();
+  if (!changed && !_useEncryption) {
+    memcpy(buffer, _lastAdvertisement, _lastAdvertisementSize);
+    return _lastAdvertisementSize;
+  }
+  if (changed && _usePacketId) {
+    _packetId++;
+  }
+  if (!_useEncryption && _lastAdvertisementSize != 0 &&
+      _lastMeasurementSize == _sensorDataIdx) {
+    return patchAdvertisement(buffer);
+  }
+
+  uint8_t serviceData[MaxSize];
+  uint8_t serviceDataIndex = 0;
+
+  serviceData[serviceDataIndex++] = SERVICE_DATA;
+  serviceData[serviceDataIndex++] = UUID1;
+  serviceData[serviceDataIndex++] = UUID2;
+
+  uint8_t indicatorByte = FLAG_VERSION;
+
+  if (_triggerDevice) {
+    indicatorByte |= FLAG_TRIGGER;
+  }
+
+  if (_useEncryption) {
+    indicatorByte |= FLAG_ENCRYPT;
+  }
+
+  serviceData[serviceDataIndex++] = indicatorByte;
+
+  uint8_t sortedBytes[ARENA_SIZE];
+  size_t sortedBytesLength = getMeasurementByteArray(sortedBytes);
+
+  if (_useEncryption) {
+    size_t encryptedLength = encryptMeasurements(
+        sortedBytes, sortedBytesLength, &serviceData[serviceDataIndex]);
+    if (encryptedLength == 0) {
+      return 0;
+    }
+    serviceDataIndex += encryptedLength;
+  } else {
+    for (uint8_t i = 0; i < sortedBytesLength; i++) {
+      serviceData[serviceDataIndex++] = sortedBytes[i];
+    }
+  }
+
+  uint8_t bufferDataIndex = 0;
+  buffer[bufferDataIndex++] = FLAG1;
+  buffer[bufferDataIndex++] = FLAG2;
+  buffer[bufferDataIndex++] = FLAG3;
+  byte sd_length = serviceDataIndex;
+  buffer[bufferDataIndex++] = sd_length;
+
+  for (size_t i = 0; i < serviceDataIndex; i++) {
+    buffer[bufferDataIndex++] = serviceData[i];
+  }
+
+  static const size_t CURRENT_BYTE = 1;
+
+  size_t completeNameLength = strnlen(_completeName, MAX_LENGTH_COMPLETE_NAME);
+  bool canFitLongName = bufferDataIndex + completeNameLength +
+                            TYPE_INDICATOR_SIZE + CURRENT_BYTE <=
+                        MaxSize;
+  if (canFitLongName) {
+    buffer[bufferDataIndex++] = completeNameLength + TYPE_INDICATOR_SIZE;
+    buffer[bufferDataIndex++] = COMPLETE_NAME;
+    memcpy(&buffer[bufferDataIndex], _completeName, completeNameLength);
+    bufferDataIndex += completeNameLength;
+  }
+
+  size_t shortNameLength = strnlen(_shortName, MAX_LENGTH_SHORT_NAME);
+  bool canFitShortName =
+      bufferDataIndex + TYPE_INDICATOR_SIZE + shortNameLength + CURRENT_BYTE <=
+      MaxSize;
+  if (canFitShortName) {
+    buffer[bufferDataIndex++] = shortNameLength + TYPE_INDICATOR_SIZE;
+    buffer[bufferDataIndex++] = SHORT_NAME;
+    memcpy(&buffer[bufferDataIndex], _shortName, shortNameLength);
+    bufferDataIndex += shortNameLength;
+  }
+
+  memcpy(_lastAdvertisement, buffer, bufferDataIndex);
+  _lastAdvertisementSize = bufferDataIndex;
+  memcpy(_lastMeasurements, _sensorData, _sensorDataIdx);
+  _lastMeasurementSize = _sensorDataIdx;
+  _stats.packetsBuilt++;
+  _stats.bytesBuilt += bufferDataIndex;
+  _stats.lastPacketSize = bufferDataIndex;
+  return bufferDataIndex;
+}
+
+/// @brief Writes only the changed measurement bytes and the packet id into
+/// the last advertisement. Plaintext measurements sit at a fixed offset and
+/// the rest of the advertisement depends on their size only, so a set of
+/// the same size needs no rebuild. Encrypted ones always do: the new
+/// counter changes every ciphertext byte and the MIC.
+template <size_t MaxSize>
+size_t BasicBaseDevice<MaxSize>::patchAdvertisement(uint8_t buffer[MaxSize]) {
+  size_t offset = MEASUREMENT_OFFSET;
+  if (_usePacketId) {
+    _lastAdvertisement[offset + 1] = _packetId;
+    offset += PACKET_ID_SIZE;
+  }
+  for (size_t i = 0; i < _sensorDataIdx; i++) {
+    if (_sensorData[i] != _lastMeasurements[i]) {
+      _lastMeasurements[i] = _sensorData[i];
+      _lastAdvertisement[offset + i] = _sensorData[i];
+    }
+  }
+  memcpy(buffer, _lastAdvertisement, _lastAdvertisementSize);
+  _stats.packetsBuilt++;
+  _stats.bytesBuilt += _lastAdvertisementSize;
+  _stats.lastPacketSize = _lastAdvertisementSize;
+  return _lastAdvertisementSize;
+}
+
+/// @brief Encrypts measurement bytes with the bind key and the next counter.
+/// @param plaintext Measurement bytes (object ids and values)
+/// @param length Number of measurement bytes
+/// @param output Receives ciphertext, counter and MIC
+/// @return Number of bytes written to output (length +
+/// ENCRYPTION_TRAILER_SIZE), 0 if the persistent counter cannot advance or
+/// the backend fails
+template <size_t MaxSize>
+size_t BasicBaseDevice<MaxSize>::encryptMeasurements(const uint8_t* plaintext,
+                                                     size_t length,
+                                                     uint8_t* output) {
+  BTHOME_TRACE_EVENT(BtHome_Trace_EncryptBegin, length);
+  uint32_t start = micros();
+  uint32_t counter = _counter;
+  if (_precomputed) {
+    counter = _precomputedCounter;
+  } else if (_persistentCounter && !_persistentCounter->next(counter)) {
+    BTHOME_TRACE_EVENT(BtHome_Trace_EncryptEnd, 0);
+    return 0;
+  }
+
+  uint8_t encryptionTag[MIC_LEN] = {0};
+  CcmBackend& ccm = _ccm ? *_ccm : _defaultCcm;
+  bool encrypted;
+  if (_precomputed && length == _precomputedLength) {
+    encrypted = ccm.encryptPrecomputed(_precomputedState, _keystream,
+                                       plaintext, length, output,
+                                       encryptionTag);
+  } else {
+    uint8_t nonce[NONCE_LEN];
+    buildNonce(counter, nonce);
+    encrypted = ccm.encrypt(nonce, plaintext, length, output, encryptionTag);
+  }
+  _precomputed = false;
+  if (!encrypted) {
+    BTHOME_TRACE_EVENT(BtHome_Trace_EncryptEnd, 0);
+    return 0;
+  }
+
+  size_t outputIndex = length;
+  memcpy(&output[outputIndex], &counter, COUNTER_LEN);
+  outputIndex += COUNTER_LEN;
+  this->_counter = counter + 1;
+  output[outputIndex++] = encryptionTag[0];
+  output[outputIndex++] = encryptionTag[1];
+  output[outputIndex++] = encryptionTag[2];
+  output[outputIndex++] = encryptionTag[3];
+  uint32_t elapsed = micros() - start;
+  _stats.encryptions++;
+  _stats.encryptionMicros += elapsed;
+  if (elapsed > _stats.maxEncryptionMicros) {
+    _stats.maxEncryptionMicros = elapsed;
+  }
+  BTHOME_TRACE_EVENT(BtHome_Trace_EncryptEnd, outputIndex);
+  return outputIndex;
+}
+
+/// @brief Nonce of BTHome encryption: MAC (most significant byte first),
+/// UUID, indicator byte and counter.
+template <size_t MaxSize>
+void BasicBaseDevice<MaxSize>::buildNonce(uint32_t counter,
+                                          uint8_t nonce[NONCE_LEN]) const {
+  nonce[0] = _macAddress[5];
+  nonce[1] = _macAddress[4];
+  nonce[2] = _macAddress[3];
+  nonce[3] = _macAddress[2];
+  nonce[4] = _macAddress[1];
+  nonce[5] = _macAddress[0];
+  nonce[6] = UUID1;
+  nonce[7] = UUID2;
+  // The nonce carries the indicator byte as sent, including the trigger flag
+  nonce[8] = FLAG_VERSION | FLAG_ENCRYPT | (_triggerDevice ? FLAG_TRIGGER : 0);
+  memcpy(&nonce[9], &counter, COUNTER_LEN);
+}
+
+template <size_t MaxSize>
+size_t BasicBaseDevice<MaxSize>::getMeasurementByteArray(
+    uint8_t sortedBytes[ARENA_SIZE]) {
+  size_t length = 0;
+  if (_usePacketId) {
+    sortedBytes[length++] = packet_id.id;
+    sortedBytes[length++] = _packetId;
+  }
+  memcpy(&sortedBytes[length], _sensorData, _sensorDataIdx);
+  return length + _sensorDataIdx;
+}
+
+// Legacy and extended encoders are compiled once, in BaseDevice.cpp
+extern template class BasicBaseDevice<MAX_ADVERTISEMENT_SIZE>;
+extern template class BasicBaseDevice<MAX_EXTENDED_ADVERTISEMENT_SIZE>;
+
+/// Encoder for legacy advertisements.
+typedef BasicBaseDevice<MAX_ADVERTISEMENT_SIZE> BaseDevice;
+/// Encoder for BLE 5 extended advertisements.
+typedef BasicBaseDevice<MAX_EXTENDED_ADVERTISEMENT_SIZE> ExtendedBaseDevice;
+
 #endif  // BASE_DEVICE_H
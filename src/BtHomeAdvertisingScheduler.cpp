@@ -0,0 +1,81 @@
+/**
+ * @file BtHomeAdvertisingScheduler.cpp
+ * @brief Advertising interval policy: fast bursts after changes, slow
+ * otherwise.
+ */
+
+#include "BtHomeAdvertisingScheduler.h"
+
+BtHomeAdvertisingScheduler::BtHomeAdvertisingScheduler(
+    const BtHomeAdvertisingPolicy& policy)
+    : _policy(policy), _applied(policy.slowIntervalMs) {}
+
+void BtHomeAdvertisingScheduler::setPolicy(
+    const BtHomeAdvertisingPolicy& policy) {
+  _policy = policy;
+}
+
+void BtHomeAdvertisingScheduler::trigger(uint32_t now) {
+  _burstStart = now;
+  _bursting = _policy.burstMs > 0;
+}
+
+bool BtHomeAdvertisingScheduler::inBurst(uint32_t now) const {
+  // Unsigned difference, so bursts survive the millis() wrap
+  return _bursting && now - _burstStart < _policy.burstMs;
+}
+
+uint32_t BtHomeAdvertisingScheduler::interval(uint32_t now) const {
+  return inBurst(now) ? _policy.fastIntervalMs : _policy.slowIntervalMs;
+}
+
+bool BtHomeAdvertisingScheduler::update(uint32_t now) {
+  // A finished burst must not come back once now wraps around
+  _bursting = inBurst(now);
+  uint32_t wanted = interval(now);
+  if (wanted == _applied) {
+    return false;
+  }
+  _applied = wanted;
+  return true;
+}
+
+float BtHomeAdvertisingScheduler::events(uint32_t from, uint32_t to) const {
+  int64_t span = static_cast<uint32_t>(to - from);
+  int64_t fast = 0;
+  if (_bursting) {
+    // Overlap of the burst with [from, to), relative to from
+    int64_t start = static_cast<int32_t>(_burstStart - from);
+    int64_t end = start + _policy.burstMs;
+    start = start < 0 ? 0 : start;
+    end = end > span ? span : end;
+    fast = end > start ? end - start : 0;
+  }
+  float count = 0;
+  if (fast > 0 && _policy.fastIntervalMs > 0) {
+    count += static_cast<float>(fast) / _policy.fastIntervalMs;
+  }
+  if (span > fast && _policy.slowIntervalMs > 0) {
+    count += static_cast<float>(span - fast) / _policy.slowIntervalMs;
+  }
+  return count;
+}
+
+float BtHomeAdvertisingScheduler::dutyCycle(uint32_t from, uint32_t to,
+                                            uint32_t eventAirtimeUs) const {
+  uint32_t span = to - from;
+  if (span == 0) {
+    return 0;
+  }
+  return events(from, to) * eventAirtimeUs / (span * 1000.0f);
+}
+
+uint16_t BtHomeAdvertisingScheduler::toUnits(uint32_t intervalMs) {
+  // 0.625 ms per unit; longer intervals are clamped before they overflow
+  uint32_t maximumMs = MAX_ADVERTISING_INTERVAL_UNITS * 5 / 8;
+  uint32_t units = intervalMs >= maximumMs ? MAX_ADVERTISING_INTERVAL_UNITS
+                                           : intervalMs * 8 / 5;
+  return units < MIN_ADVERTISING_INTERVAL_UNITS
+             ? MIN_ADVERTISING_INTERVAL_UNITS
+             : units;
+}
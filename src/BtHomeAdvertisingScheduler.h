@@ -0,0 +1,86 @@
+/**
+ * @file BtHomeAdvertisingScheduler.h
+ * @brief Advertising interval policy: fast bursts after changes, slow
+ * otherwise.
+ *
+ * A sensor advertises at the fast interval for a burst after a value or
+ * state changed, so receivers pick the change up quickly, and then backs off
+ * to the slow interval to save power. The scheduler only works on
+ * timestamps: BThomeV2Device programs the radio with the interval it
+ * returns, and on host it estimates advertising events and radio duty cycle
+ * of a policy (see bthome_schedule).
+ *
+ * @code
+ * BtHomeAdvertisingScheduler scheduler({100, 2000, 3000});
+ * scheduler.trigger(millis());       // value changed: fast burst
+ * if (scheduler.update(millis())) {  // burst over
+ *   restartAdvertising(scheduler.getAppliedInterval());
+ * }
+ * @endcode
+ */
+
+#ifndef BT_HOME_ADVERTISING_SCHEDULER_H
+#define BT_HOME_ADVERTISING_SCHEDULER_H
+
+#include <Arduino.h>
+
+/// BLE advertising interval limits in 0.625 ms units (20 ms to 10.24 s)
+static const uint16_t MIN_ADVERTISING_INTERVAL_UNITS = 32;
+static const uint16_t MAX_ADVERTISING_INTERVAL_UNITS = 16384;
+
+/// @brief Advertising intervals of a sensor.
+struct BtHomeAdvertisingPolicy {
+  uint32_t fastIntervalMs;  // During a burst
+  uint32_t slowIntervalMs;  // Otherwise
+  uint32_t burstMs;         // Length of a burst after a change, 0 for none
+};
+
+/// Repeats a change about 20 times within 2 s, then one packet per second.
+static const BtHomeAdvertisingPolicy DEFAULT_ADVERTISING_POLICY = {100, 1000,
+                                                                   2000};
+
+/// @brief Computes the advertising interval over time.
+class BtHomeAdvertisingScheduler {
+ public:
+  explicit BtHomeAdvertisingScheduler(
+      const BtHomeAdvertisingPolicy& policy = DEFAULT_ADVERTISING_POLICY);
+
+  /// @brief Replace the policy; a running burst keeps its start time.
+  void setPolicy(const BtHomeAdvertisingPolicy& policy);
+  const BtHomeAdvertisingPolicy& getPolicy() const { return _policy; }
+
+  /// @brief A value or state changed at now: (re)start the fast burst.
+  void trigger(uint32_t now);
+
+  /// @brief Interval the policy asks for at now, in ms.
+  uint32_t interval(uint32_t now) const;
+
+  /// @brief Adopt interval(now) as the one on air.
+  /// @return true if it differs from the interval applied before, so the
+  /// radio has to be reprogrammed
+  bool update(uint32_t now);
+
+  /// @brief Interval adopted by the last update(), in ms.
+  uint32_t getAppliedInterval() const { return _applied; }
+
+  /// @brief Advertising events the policy sends from `from` to `to`.
+  float events(uint32_t from, uint32_t to) const;
+
+  /// @brief Fraction of the time from `from` to `to` the radio transmits.
+  /// @param eventAirtimeUs Air time of one advertising event on all channels
+  float dutyCycle(uint32_t from, uint32_t to, uint32_t eventAirtimeUs) const;
+
+  /// @brief Interval in 0.625 ms radio units, clamped to the BLE limits.
+  static uint16_t toUnits(uint32_t intervalMs);
+
+  /// @brief true while the fast burst of the last trigger() runs.
+  bool inBurst(uint32_t now) const;
+
+ private:
+  BtHomeAdvertisingPolicy _policy;
+  uint32_t _burstStart = 0;
+  bool _bursting = false;
+  uint32_t _applied;
+};
+
+#endif  // BT_HOME_ADVERTISING_SCHEDULER_H
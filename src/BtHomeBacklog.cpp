@@ -0,0 +1,89 @@
+/**
+ * @file BtHomeBacklog.cpp
+ * @brief Bounded ring of timestamped measurement snapshots for replay
+ */
+
+#include "BtHomeBacklog.h"
+
+const size_t BtHomeBacklog::ENTRY_HEADER_SIZE;
+const size_t BtHomeBacklog::MAX_SNAPSHOT_SIZE;
+const uint8_t BtHomeBacklog::DEFAULT_REPLAYS;
+
+BtHomeBacklog::BtHomeBacklog(uint8_t* storage, size_t capacity)
+    : _storage(storage), _capacity(capacity) {}
+
+bool BtHomeBacklog::push(const uint8_t* snapshot, size_t size) {
+  size_t entrySize = ENTRY_HEADER_SIZE + size;
+  if (size == 0 || size > MAX_SNAPSHOT_SIZE || entrySize > _capacity) {
+    return false;
+  }
+  while (_capacity - _used < entrySize) {
+    dropOldest();
+  }
+  // Snapshots wrap around the end of the storage byte by byte
+  at(_used) = static_cast<uint8_t>(size);
+  at(_used + 1) = 0;
+  for (size_t i = 0; i < size; i++) {
+    at(_used + ENTRY_HEADER_SIZE + i) = snapshot[i];
+  }
+  _used += entrySize;
+  _count++;
+  return true;
+}
+
+size_t BtHomeBacklog::next(uint8_t* output, size_t maxSize) {
+  for (size_t visited = 0; visited < _count; visited++) {
+    if (_cursor >= _used) {
+      _cursor = 0;
+    }
+    size_t offset = _cursor;
+    size_t size = at(offset);
+    _cursor += ENTRY_HEADER_SIZE + size;
+    uint8_t& aired = at(offset + 1);
+    if (replayed(aired) || size > maxSize) {
+      continue;
+    }
+    for (size_t i = 0; i < size; i++) {
+      output[i] = at(offset + ENTRY_HEADER_SIZE + i);
+    }
+    if (aired < UINT8_MAX) {
+      aired++;
+    }
+    // Replayed snapshots in front are freed; later ones wait their turn
+    while (_count > 0 && replayed(at(1))) {
+      dropOldest();
+    }
+    return size;
+  }
+  return 0;
+}
+
+size_t BtHomeBacklog::pending() const {
+  size_t count = 0;
+  for (size_t offset = 0; offset < _used;
+       offset += ENTRY_HEADER_SIZE + at(offset)) {
+    if (!replayed(at(offset + 1))) {
+      count++;
+    }
+  }
+  return count;
+}
+
+void BtHomeBacklog::clear() {
+  _head = 0;
+  _used = 0;
+  _cursor = 0;
+  _count = 0;
+}
+
+void BtHomeBacklog::dropOldest() {
+  size_t entrySize = ENTRY_HEADER_SIZE + at(0);
+  if (!replayed(at(1))) {
+    _overwritten++;
+  }
+  _head = (_head + entrySize) % _capacity;
+  _used -= entrySize;
+  _count--;
+  // The cursor keeps pointing at the same snapshot, or the new oldest one
+  _cursor = _cursor >= entrySize ? _cursor - entrySize : 0;
+}
@@ -0,0 +1,116 @@
+/**
+ * @file BtHomeBacklog.h
+ * @brief Bounded ring of timestamped measurement snapshots for replay.
+ *
+ * A sensor out of range of its gateway, or one that stopped advertising,
+ * loses every reading that is replaced before it went on air. With a
+ * backlog, BThomeV2 records a snapshot of its measurements at a fixed
+ * interval, tagged with a timestamp object (0x50), and replays the
+ * snapshots in spare advertising slots between the live advertisements, so
+ * a gateway that reads the timestamp can fill the gap afterwards:
+ *
+ * @code
+ * BasicBtHomeBacklog<512> backlog;  // 39 temperature + humidity snapshots
+ *
+ * void setup() {
+ *   bthome.begin("Sensor");
+ *   bthome.setTime(ntpSeconds());   // Timestamps need the wall clock
+ *   bthome.setBacklog(&backlog, 60000);
+ * }
+ * @endcode
+ *
+ * The ring has a fixed size chosen at compile time and never allocates.
+ * When it is full, the oldest snapshot makes room for the new one.
+ * Snapshots are replayed oldest first, in turn, until they are overwritten,
+ * as the device cannot know when its gateway is back in range.
+ * setReplays() frees each one after a number of replays instead.
+ */
+
+#ifndef BT_HOME_BACKLOG_H
+#define BT_HOME_BACKLOG_H
+
+#include <Arduino.h>
+
+/// Storage of BasicBtHomeBacklog<> in bytes.
+static const size_t DEFAULT_BACKLOG_BYTES = 512;
+
+/// @brief Ring of snapshots in caller-provided storage, see
+/// BasicBtHomeBacklog.
+class BtHomeBacklog {
+ public:
+  /// Bytes in front of every snapshot: its size and how often it aired.
+  static const size_t ENTRY_HEADER_SIZE = 2;
+  /// Largest snapshot, its size is stored in one byte.
+  static const size_t MAX_SNAPSHOT_SIZE = 255;
+  /// Replay every snapshot until it is overwritten.
+  static const uint8_t DEFAULT_REPLAYS = 0;
+
+  BtHomeBacklog(uint8_t* storage, size_t capacity);
+
+  /// @brief How often each snapshot goes on air before it is freed.
+  /// @param replays Replays per snapshot, 0 to keep every snapshot until it
+  /// is overwritten
+  void setReplays(uint8_t replays) { _replays = replays; }
+  uint8_t getReplays() const { return _replays; }
+
+  /// @brief Append a snapshot, dropping the oldest ones if the ring is full.
+  /// @param snapshot Objects in wire format (object id, value)
+  /// @return false if the snapshot is empty or larger than the ring
+  bool push(const uint8_t* snapshot, size_t size);
+
+  /// @brief Next snapshot to replay. Snapshots take turns, oldest first.
+  /// @param output Buffer for the snapshot
+  /// @param maxSize Size of output; larger snapshots are skipped
+  /// @return Size of the snapshot, 0 if no snapshot is due
+  size_t next(uint8_t* output, size_t maxSize);
+
+  /// @brief Snapshots that still have replays left.
+  size_t pending() const;
+
+  /// @brief Snapshots in the ring, replayed ones not yet freed included.
+  size_t size() const { return _count; }
+
+  size_t bytesUsed() const { return _used; }
+  size_t capacity() const { return _capacity; }
+
+  /// @brief Snapshots dropped for new ones before their last replay (every
+  /// dropped one with unlimited replays).
+  uint32_t getOverwritten() const { return _overwritten; }
+
+  void clear();
+
+ private:
+  uint8_t& at(size_t offset) { return _storage[(_head + offset) % _capacity]; }
+  uint8_t at(size_t offset) const {
+    return _storage[(_head + offset) % _capacity];
+  }
+  bool replayed(uint8_t aired) const {
+    return _replays != 0 && aired >= _replays;
+  }
+  void dropOldest();
+
+  uint8_t* _storage;
+  size_t _capacity;
+  size_t _head = 0;    // Offset of the oldest snapshot in _storage
+  size_t _used = 0;    // Bytes from _head on
+  size_t _cursor = 0;  // Snapshot to replay next, as an offset from _head
+  size_t _count = 0;
+  uint8_t _replays = DEFAULT_REPLAYS;
+  uint32_t _overwritten = 0;
+};
+
+/// @brief Backlog with Bytes of storage (snapshots and 2 header bytes each).
+template <size_t Bytes = DEFAULT_BACKLOG_BYTES>
+class BasicBtHomeBacklog : public BtHomeBacklog {
+ public:
+  static_assert(Bytes > ENTRY_HEADER_SIZE, "backlog storage too small");
+
+  BasicBtHomeBacklog() : BtHomeBacklog(_storage, Bytes) {}
+  BasicBtHomeBacklog(const BasicBtHomeBacklog&) = delete;
+  BasicBtHomeBacklog& operator=(const BasicBtHomeBacklog&) = delete;
+
+ private:
+  uint8_t _storage[Bytes];
+};
+
+#endif  // BT_HOME_BACKLOG_H
@@ -0,0 +1,135 @@
+/**
+ * @file BtHomeBatchDecoder.cpp
+ * @brief Bulk decoder for archives of captured BTHome service data
+ */
+
+#include "BtHomeBatchDecoder.h"
+
+static const uint8_t VERSION_MASK = 0xE0;
+static const uint8_t COMMAND_ARGUMENT_MASK = 0x1F;
+// Values are loaded as 4 bytes and masked to their size
+static const size_t LOAD_SIZE = 4;
+
+/// @brief Little-endian load of the value bytes at data[offset]; near the
+/// end of the data only the size value bytes are there.
+static uint32_t loadValue(const uint8_t* data, size_t offset, size_t size,
+                          size_t length) {
+  const uint8_t* value = data + offset;
+  if (offset + LOAD_SIZE <= length) {
+    return static_cast<uint32_t>(value[0]) |
+           (static_cast<uint32_t>(value[1]) << 8) |
+           (static_cast<uint32_t>(value[2]) << 16) |
+           (static_cast<uint32_t>(value[3]) << 24);
+  }
+  uint32_t bytes = 0;
+  for (size_t b = 0; b < size && b < LOAD_SIZE; b++) {
+    bytes |= static_cast<uint32_t>(value[b]) << (8 * b);
+  }
+  return bytes;
+}
+
+BtHomeBatchDecoder::BtHomeBatchDecoder() {
+  for (size_t id = 0; id < 256; id++) {
+    const BtHomeObjectInfo& info = bthomeObjectInfo(id);
+    _columns[id].info = info;
+    _size[id] = info.byteCount;
+    // Fixed-width objects in data_types.h hold 1 to 4 bytes
+    uint8_t size = info.byteCount <= LOAD_SIZE ? info.byteCount : 0;
+    _keep[id] = size == LOAD_SIZE ? 0xFFFFFFFFu : (1u << (8 * size)) - 1;
+    _sign[id] = info.signed_value && size ? 1u << (8 * size - 1) : 0;
+  }
+}
+
+void BtHomeBatchDecoder::clear() {
+  for (size_t id = 0; id < 256; id++) {
+    _columns[id].packets.clear();
+    _columns[id].values.clear();
+  }
+  _packets = 0;
+  _skipped = 0;
+  _malformed = 0;
+  _variableLength = 0;
+}
+
+size_t BtHomeBatchDecoder::decode(const uint8_t* data,
+                                  const uint32_t* offsets, size_t count,
+                                  uint32_t firstPacket) {
+  size_t length = count ? offsets[count] : 0;
+  size_t stored = 0;
+  for (size_t packet = 0; packet < count; packet++) {
+    size_t position = offsets[packet];
+    size_t end = offsets[packet + 1];
+    _packets++;
+    if (position == end || (data[position] & VERSION_MASK) != FLAG_VERSION ||
+        (data[position] & FLAG_ENCRYPT)) {
+      _skipped++;
+      continue;
+    }
+
+    // Object walk, staging every fixed-width value
+    position++;
+    while (position < end) {
+      uint8_t id = data[position];
+      size_t size = _size[id];
+      bool variable =
+          size == OBJECT_LENGTH_PREFIXED || size == OBJECT_COMMAND;
+      if (variable && position + 1 < end) {
+        // Text and raw count their bytes, commands the arguments behind the
+        // opcode
+        uint8_t header = data[position + 1];
+        size = 1 + (size == OBJECT_LENGTH_PREFIXED
+                        ? header
+                        : 1 + (header & COMMAND_ARGUMENT_MASK));
+      }
+      if (size == OBJECT_UNKNOWN || position + 1 + size > end) {
+        _malformed++;
+        break;
+      }
+      if (variable) {
+        _variableLength++;
+      } else {
+        uint32_t bytes = loadValue(data, position + 1, size, length);
+        _stagedValue[_staged] = static_cast<int32_t>(
+            ((bytes & _keep[id]) ^ _sign[id]) - _sign[id]);
+        _stagedId[_staged] = id;
+        _stagedPacket[_staged] = firstPacket + packet;
+        if (_counts[id] == 0) {
+          _touched[_touchedCount++] = id;
+        }
+        _stagedSlot[_staged] = _counts[id]++;
+        stored++;
+        if (++_staged == STAGE_SIZE) {
+          flush();
+        }
+      }
+      position += 1 + size;
+    }
+  }
+  flush();
+  return stored;
+}
+
+/// @brief Append the staged values to their columns.
+void BtHomeBatchDecoder::flush() {
+  // Grow every touched column once; the walk already numbered the objects
+  // per id, so the scatter stores do not depend on each other
+  uint32_t* packets[256];
+  int32_t* values[256];
+  for (size_t t = 0; t < _touchedCount; t++) {
+    uint8_t id = _touched[t];
+    BtHomeColumn& column = _columns[id];
+    size_t size = column.values.size();
+    column.packets.resize(size + _counts[id]);
+    column.values.resize(size + _counts[id]);
+    packets[id] = &column.packets[size];
+    values[id] = &column.values[size];
+    _counts[id] = 0;
+  }
+  for (size_t i = 0; i < _staged; i++) {
+    uint8_t id = _stagedId[i];
+    packets[id][_stagedSlot[i]] = _stagedPacket[i];
+    values[id][_stagedSlot[i]] = _stagedValue[i];
+  }
+  _touchedCount = 0;
+  _staged = 0;
+}
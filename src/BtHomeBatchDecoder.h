@@ -0,0 +1,120 @@
+/**
+ * @file BtHomeBatchDecoder.h
+ * @brief Bulk decoder for archives of captured BTHome service data.
+ *
+ * BtHomeBatchDecoder decodes many packets per call into one column per
+ * object id (structure of arrays), for offline analytics over large
+ * captures. The position of an object depends on the length of the one
+ * before it, so each packet is walked object by object. Every value is
+ * loaded as 4 bytes where the walk finds it and sign-extended without
+ * branches per type:
+ *
+ *   value = ((bytes & KEEP[id]) ^ SIGN[id]) - SIGN[id]
+ *
+ * where KEEP masks the value bytes of the id and SIGN is the sign bit of
+ * signed ids (0 for unsigned ones). Values are staged and appended to their
+ * columns in blocks, growing each column once per block.
+ *
+ * @code
+ * BtHomeBatchDecoder decoder;
+ * decoder.decode(archive, offsets, packetCount);
+ * const BtHomeColumn& temperature = decoder.column(0x02);
+ * for (size_t i = 0; i < temperature.size(); i++) {
+ *   printf("%u %f\n", temperature.packets[i], temperature.value(i));
+ * }
+ * @endcode
+ */
+
+#ifndef BT_HOME_BATCH_DECODER_H
+#define BT_HOME_BATCH_DECODER_H
+
+#include <Arduino.h>
+
+#include <vector>
+
+#include "BtHomeObjects.h"
+#include "definitions.h"
+
+/// @brief Every value of one object id in a batch.
+struct BtHomeColumn {
+  BtHomeObjectInfo info;
+  /// Index of the packet each value came from, ascending.
+  std::vector<uint32_t> packets;
+  /// Wire value; sign-extended for signed ids, the plain bits (read as
+  /// uint32_t) for unsigned ones.
+  std::vector<int32_t> values;
+
+  size_t size() const { return values.size(); }
+
+  /// @brief Value i as an integer, like BtHomeObject::rawValue().
+  int64_t rawValue(size_t i) const {
+    return info.signed_value ? static_cast<int64_t>(values[i])
+                             : static_cast<int64_t>(
+                                   static_cast<uint32_t>(values[i]));
+  }
+
+  /// @brief Value i in the unit of the object.
+  float value(size_t i) const {
+    return static_cast<float>(rawValue(i) * info.scale.numerator) /
+           info.scale.denominator;
+  }
+};
+
+/// @brief Decodes batches of service data into per-id columns.
+class BtHomeBatchDecoder {
+ public:
+  BtHomeBatchDecoder();
+
+  /// @brief Append the objects of a batch of packets to the columns.
+  ///
+  /// Packet i is data[offsets[i]] up to data[offsets[i + 1]], starting with
+  /// the device information byte (service data without the UUID). Encrypted
+  /// packets and other BTHome versions are skipped; text, raw and command
+  /// objects are counted but not stored. Decoding a packet stops at an
+  /// unknown id or a truncated object.
+  /// @param offsets count + 1 ascending offsets, the last below 2^31
+  /// @param firstPacket Added to the packet indices stored in the columns
+  /// @return Number of values stored
+  size_t decode(const uint8_t* data, const uint32_t* offsets, size_t count,
+                uint32_t firstPacket = 0);
+
+  const BtHomeColumn& column(uint8_t id) const { return _columns[id]; }
+
+  /// @brief Empty all columns and counters, keeping the allocated memory.
+  void clear();
+
+  uint32_t getPacketCount() const { return _packets; }
+  uint32_t getSkippedCount() const { return _skipped; }
+  uint32_t getMalformedCount() const { return _malformed; }
+  uint32_t getVariableLengthCount() const { return _variableLength; }
+
+ private:
+  /// Objects collected before they are appended to their columns.
+  static const size_t STAGE_SIZE = 1024;
+
+  void flush();
+
+  BtHomeColumn _columns[256];
+  // byteCount of every id, packed for the object walk
+  uint8_t _size[256];
+  // Sign extension masks, see the file comment
+  uint32_t _keep[256];
+  uint32_t _sign[256];
+
+  size_t _staged = 0;
+  uint8_t _stagedId[STAGE_SIZE];
+  uint32_t _stagedPacket[STAGE_SIZE];
+  uint16_t _stagedSlot[STAGE_SIZE];  // Position among staged objects of id
+  int32_t _stagedValue[STAGE_SIZE];
+  // Staged objects per id, and the ids with any
+  uint16_t _counts[256] = {0};
+  uint8_t _touched[256];
+  size_t _touchedCount = 0;
+
+  uint32_t _packets = 0;
+  uint32_t _skipped = 0;
+  uint32_t _malformed = 0;
+  uint32_t _variableLength = 0;
+};
+
+#endif  // BT_HOME_BATCH_DECODER_H
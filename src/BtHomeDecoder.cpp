@@ -0,0 +1,159 @@
+/**
+ * @file BtHomeDecoder.cpp
+ * @brief Zero-copy decoder for BTHome v2 service data
+ */
+
+#include "BtHomeDecoder.h"
+
+// Service data AD structure: length, type and UUID in front of the data.
+static const size_t SERVICE_DATA_HEADER_SIZE = 4;
+// Low bits of the command header byte hold the argument count.
+static const uint8_t COMMAND_ARGUMENT_MASK = 0x1F;
+static const uint8_t VERSION_MASK = 0xE0;
+
+int64_t BtHomeObject::rawValue() const {
+  uint32_t bits = 0;
+  uint8_t size = isVariableLength() ? 0 : length;
+  switch (size) {
+    case 4:
+      bits |= static_cast<uint32_t>(data[3]) << 24;
+      // fall through
+    case 3:
+      bits |= static_cast<uint32_t>(data[2]) << 16;
+      // fall through
+    case 2:
+      bits |= static_cast<uint32_t>(data[1]) << 8;
+      // fall through
+    case 1:
+      bits |= data[0];
+      break;
+    default:
+      return 0;
+  }
+  if (info.signed_value && size < 4) {
+    uint8_t unused = 32 - 8 * size;
+    return static_cast<int32_t>(bits << unused) >> unused;
+  }
+  return info.signed_value ? static_cast<int32_t>(bits)
+                           : static_cast<int64_t>(bits);
+}
+
+float BtHomeObject::value() const {
+  return static_cast<float>(rawValue() * info.scale.numerator) /
+         info.scale.denominator;
+}
+
+int64_t BtHomeObject::fixedPoint(uint32_t divisor) const {
+  int64_t scaled = rawValue() * info.scale.numerator * divisor;
+  int64_t half = info.scale.denominator / 2;
+  return (scaled >= 0 ? scaled + half : scaled - half) /
+         info.scale.denominator;
+}
+
+BtHomeObjectIterator::BtHomeObjectIterator(const uint8_t* position,
+                                           const uint8_t* end)
+    : _position(position), _next(position), _end(end) {
+  parse();
+}
+
+BtHomeObjectIterator& BtHomeObjectIterator::operator++() {
+  _position = _next;
+  parse();
+  return *this;
+}
+
+/// @brief Decode the object at _position, or move to _end if there is none.
+void BtHomeObjectIterator::parse() {
+  if (_position >= _end) {
+    _position = _end;
+    return;
+  }
+
+  const uint8_t* value = _position + 1;
+  const BtHomeObjectInfo& info = bthomeObjectInfo(*_position);
+  size_t length = info.byteCount;
+  bool variable = info.byteCount == OBJECT_LENGTH_PREFIXED ||
+                  info.byteCount == OBJECT_COMMAND;
+  if (variable && value < _end) {
+    // Text and raw count their bytes, commands the arguments behind the
+    // opcode
+    uint8_t header = *value++;
+    length = info.byteCount == OBJECT_LENGTH_PREFIXED
+                 ? header
+                 : 1 + (header & COMMAND_ARGUMENT_MASK);
+  }
+
+  if (info.byteCount == OBJECT_UNKNOWN ||
+      length > static_cast<size_t>(_end - value)) {
+    _malformed = true;
+    _position = _end;
+    return;
+  }
+
+  _object.id = *_position;
+  _object.info = info;
+  _object.data = value;
+  _object.length = length;
+  _next = value + length;
+}
+
+BtHomeServiceData::BtHomeServiceData(const uint8_t* data, size_t length)
+    : _data(data), _length(length) {}
+
+bool BtHomeServiceData::fromAdvertisement(const uint8_t* advertisement,
+                                          size_t length,
+                                          BtHomeServiceData& serviceData) {
+  size_t index = 0;
+  while (index < length && advertisement[index] != 0) {
+    size_t structureLength = advertisement[index];
+    if (index + 1 + structureLength > length) {
+      return false;
+    }
+    const uint8_t* structure = &advertisement[index];
+    if (structureLength + 1 >= SERVICE_DATA_HEADER_SIZE &&
+        structure[1] == SERVICE_DATA && structure[2] == UUID1 &&
+        structure[3] == UUID2) {
+      serviceData = BtHomeServiceData(
+          &structure[SERVICE_DATA_HEADER_SIZE],
+          structureLength + 1 - SERVICE_DATA_HEADER_SIZE);
+      return true;
+    }
+    index += 1 + structureLength;
+  }
+  return false;
+}
+
+bool BtHomeServiceData::isValid() const {
+  return _length > 0 && (_data[0] & VERSION_MASK) == FLAG_VERSION;
+}
+
+BtHomeObjectIterator BtHomeServiceData::begin() const {
+  if (!isValid() || isEncrypted()) {
+    return end();
+  }
+  return BtHomeObjectIterator(payload(), payload() + payloadLength());
+}
+
+BtHomeObjectIterator BtHomeServiceData::end() const {
+  const uint8_t* last = payload() + payloadLength();
+  return BtHomeObjectIterator(last, last);
+}
+
+bool BtHomeServiceData::isWellFormed() const {
+  BtHomeObjectIterator it = begin();
+  BtHomeObjectIterator last = end();
+  while (it != last) {
+    ++it;
+  }
+  return !it.malformed();
+}
+
+bool BtHomeServiceData::find(uint8_t id, BtHomeObject& object) const {
+  for (BtHomeObjectIterator it = begin(), last = end(); it != last; ++it) {
+    if (it->id == id) {
+      object = *it;
+      return true;
+    }
+  }
+  return false;
+}
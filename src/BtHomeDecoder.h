@@ -0,0 +1,121 @@
+/**
+ * @file BtHomeDecoder.h
+ * @brief Zero-copy decoder for BTHome v2 service data.
+ *
+ * BtHomeServiceData wraps a received buffer without copying it; iterating
+ * yields BtHomeObject views whose layout comes from bthomeObjectInfo(), so
+ * decoding never allocates and costs one table lookup per object.
+ *
+ * @code
+ * BtHomeServiceData serviceData;
+ * if (BtHomeServiceData::fromAdvertisement(adv, length, serviceData)) {
+ *   for (const BtHomeObject& object : serviceData) {
+ *     Serial.printf("0x%02X = %f\n", object.id, object.value());
+ *   }
+ * }
+ * @endcode
+ */
+
+#ifndef BT_HOME_DECODER_H
+#define BT_HOME_DECODER_H
+
+#include <Arduino.h>
+
+#include "BtHomeObjects.h"
+#include "definitions.h"
+
+/// @brief One object of a packet; data points into the decoded buffer.
+struct BtHomeObject {
+  uint8_t id = 0;
+  BtHomeObjectInfo info = {OBJECT_UNKNOWN, false, {1, 1}};
+  /// Value bytes; text and raw without their length byte, commands from the
+  /// opcode on.
+  const uint8_t* data = nullptr;
+  uint8_t length = 0;
+
+  /// @brief Text, raw or command object (data holds bytes, not a number).
+  bool isVariableLength() const {
+    return info.byteCount == OBJECT_LENGTH_PREFIXED ||
+           info.byteCount == OBJECT_COMMAND;
+  }
+
+  /// @brief Little-endian wire value, sign-extended for signed objects.
+  int64_t rawValue() const;
+
+  /// @brief Value in the unit of the object (e.g. 21.37 for 0x02 2137).
+  float value() const;
+
+  /// @brief Value as an integer in 1/divisor units, rounded to nearest; the
+  /// inverse of BaseDevice::addFixedPoint().
+  int64_t fixedPoint(uint32_t divisor) const;
+};
+
+/// @brief Forward iterator over the objects of a packet. Stops at the end of
+/// the data, an unknown object id or a truncated object.
+class BtHomeObjectIterator {
+ public:
+  BtHomeObjectIterator(const uint8_t* position, const uint8_t* end);
+
+  const BtHomeObject& operator*() const { return _object; }
+  const BtHomeObject* operator->() const { return &_object; }
+  BtHomeObjectIterator& operator++();
+  bool operator==(const BtHomeObjectIterator& other) const {
+    return _position == other._position;
+  }
+  bool operator!=(const BtHomeObjectIterator& other) const {
+    return _position != other._position;
+  }
+
+  /// @brief Iteration stopped before the end of the data.
+  bool malformed() const { return _malformed; }
+
+ private:
+  void parse();
+
+  const uint8_t* _position;
+  const uint8_t* _next;
+  const uint8_t* _end;
+  bool _malformed = false;
+  BtHomeObject _object;
+};
+
+/// @brief View of the service data behind UUID 0xFCD2: the device
+/// information byte, then the objects (or ciphertext, counter and MIC).
+class BtHomeServiceData {
+ public:
+  BtHomeServiceData() {}
+  BtHomeServiceData(const uint8_t* data, size_t length);
+
+  /// @brief Find the BTHome service data in raw advertising data (AD
+  /// structures as built by getAdvertisementData()).
+  /// @return false if the advertisement has no BTHome service data
+  static bool fromAdvertisement(const uint8_t* advertisement, size_t length,
+                                BtHomeServiceData& serviceData);
+
+  /// @brief Non-empty service data with BTHome version 2.
+  bool isValid() const;
+  uint8_t deviceInfo() const { return _length ? _data[0] : 0; }
+  bool isEncrypted() const { return deviceInfo() & FLAG_ENCRYPT; }
+  bool isTriggerBased() const { return deviceInfo() & FLAG_TRIGGER; }
+
+  /// @brief Bytes behind the device information byte.
+  const uint8_t* payload() const { return _length ? _data + 1 : _data; }
+  size_t payloadLength() const { return _length ? _length - 1 : 0; }
+
+  /// @brief Objects of a valid, unencrypted packet; empty otherwise.
+  BtHomeObjectIterator begin() const;
+  BtHomeObjectIterator end() const;
+
+  /// @brief All objects decode up to the last byte.
+  bool isWellFormed() const;
+
+  /// @brief First object with id.
+  /// @return false if the packet has no such object
+  bool find(uint8_t id, BtHomeObject& object) const;
+
+ private:
+  const uint8_t* _data = nullptr;
+  size_t _length = 0;
+};
+
+#endif  // BT_HOME_DECODER_H
@@ -0,0 +1,70 @@
+/**
+ * @file BtHomeLog.h
+ * @brief Compile-time log levels for the library.
+ *
+ * Messages above BTHOME_LOG_LEVEL compile to nothing, arguments included, so
+ * release builds carry no format strings and no Serial calls. Set the level
+ * for the whole build, e.g. in platformio.ini:
+ *
+ * @code
+ * build_flags = -DBTHOME_LOG_LEVEL=BTHOME_LOG_LEVEL_DEBUG
+ * @endcode
+ *
+ * Logging blocks for the time the UART needs (about 1 ms per 11 characters at
+ * 115200 baud); keep it out of code that runs for every packet and use the
+ * trace ring (BtHomeTrace.h) there.
+ */
+
+#ifndef BT_HOME_LOG_H
+#define BT_HOME_LOG_H
+
+#include <Arduino.h>
+
+#define BTHOME_LOG_LEVEL_NONE 0
+#define BTHOME_LOG_LEVEL_ERROR 1
+#define BTHOME_LOG_LEVEL_WARN 2
+#define BTHOME_LOG_LEVEL_INFO 3
+#define BTHOME_LOG_LEVEL_DEBUG 4
+
+#ifndef BTHOME_LOG_LEVEL
+#define BTHOME_LOG_LEVEL BTHOME_LOG_LEVEL_NONE
+#endif
+
+/// Stream the messages go to; needs print(), printf() and println().
+#ifndef BTHOME_LOG_OUTPUT
+#define BTHOME_LOG_OUTPUT Serial
+#endif
+
+/// One line: "[BTHome <level>] " followed by a printf() format and arguments.
+#define BTHOME_LOG_PRINT(level, ...)                \
+  do {                                              \
+    BTHOME_LOG_OUTPUT.print("[BTHome " level "] "); \
+    BTHOME_LOG_OUTPUT.printf(__VA_ARGS__);          \
+    BTHOME_LOG_OUTPUT.println();                    \
+  } while (0)
+
+#if BTHOME_LOG_LEVEL >= BTHOME_LOG_LEVEL_ERROR
+#define BTHOME_LOGE(...) BTHOME_LOG_PRINT("E", __VA_ARGS__)
+#else
+#define BTHOME_LOGE(...) ((void)0)
+#endif
+
+#if BTHOME_LOG_LEVEL >= BTHOME_LOG_LEVEL_WARN
+#define BTHOME_LOGW(...) BTHOME_LOG_PRINT("W", __VA_ARGS__)
+#else
+#define BTHOME_LOGW(...) ((void)0)
+#endif
+
+#if BTHOME_LOG_LEVEL >= BTHOME_LOG_LEVEL_INFO
+#define BTHOME_LOGI(...) BTHOME_LOG_PRINT("I", __VA_ARGS__)
+#else
+#define BTHOME_LOGI(...) ((void)0)
+#endif
+
+#if BTHOME_LOG_LEVEL >= BTHOME_LOG_LEVEL_DEBUG
+#define BTHOME_LOGD(...) BTHOME_LOG_PRINT("D", __VA_ARGS__)
+#else
+#define BTHOME_LOGD(...) ((void)0)
+#endif
+
+#endif  // BT_HOME_LOG_H
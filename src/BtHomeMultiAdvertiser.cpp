@@ -0,0 +1,222 @@
+/**
+ * @file BtHomeMultiAdvertiser.cpp
+ * @brief Deadline scheduling of several identities on shared radios
+ */
+
+#include "BtHomeMultiAdvertiser.h"
+
+#include "BtHomeLog.h"
+#include "BtHomeTrace.h"
+
+const size_t BtHomeIdentityScheduler::MAX_IDENTITIES;
+const int BtHomeIdentityScheduler::NONE;
+const uint32_t BtHomeMultiAdvertiser::DEFAULT_DWELL_MS;
+const size_t BtHomeMultiAdvertiser::MAX_RADIOS;
+
+/// @brief true if time a lies before b, across millis() wrap-around.
+static bool before(uint32_t a, uint32_t b) {
+  return static_cast<int32_t>(a - b) < 0;
+}
+
+int BtHomeIdentityScheduler::add(uint32_t periodMs, uint32_t now) {
+  if (_count == MAX_IDENTITIES) {
+    return NONE;
+  }
+  Entry& entry = _entries[_count];
+  memset(&entry, 0, sizeof(entry));
+  entry.periodMs = periodMs;
+  entry.deadline = now;
+  // Never aired: ahead of every identity that was
+  entry.lastAired = now - periodMs;
+  return static_cast<int>(_count++);
+}
+
+bool BtHomeIdentityScheduler::setPeriod(size_t identity, uint32_t periodMs) {
+  if (identity >= _count) {
+    return false;
+  }
+  Entry& entry = _entries[identity];
+  entry.deadline = entry.lastAired + periodMs;
+  entry.periodMs = periodMs;
+  return true;
+}
+
+void BtHomeIdentityScheduler::markChanged(size_t identity, uint32_t now) {
+  if (identity >= _count) {
+    return;
+  }
+  Entry& entry = _entries[identity];
+  if (!entry.changed) {
+    entry.changed = true;
+    entry.changedAt = now;
+  }
+  if (before(now, entry.deadline)) {
+    entry.deadline = now;
+  }
+}
+
+int BtHomeIdentityScheduler::next() const {
+  int best = NONE;
+  for (size_t i = 0; i < _count; i++) {
+    const Entry& entry = _entries[i];
+    if (entry.onAir) {
+      continue;
+    }
+    if (best == NONE) {
+      best = static_cast<int>(i);
+      continue;
+    }
+    const Entry& current = _entries[best];
+    if (before(entry.deadline, current.deadline) ||
+        (entry.deadline == current.deadline &&
+         before(entry.lastAired, current.lastAired))) {
+      best = static_cast<int>(i);
+    }
+  }
+  return best;
+}
+
+void BtHomeIdentityScheduler::aired(size_t identity, uint32_t now) {
+  if (identity >= _count) {
+    return;
+  }
+  Entry& entry = _entries[identity];
+  // All identities are due when they are added, the first round is no miss
+  uint32_t due = entry.lastAired + entry.periodMs;
+  if (entry.stats.aired > 0 && before(due, now)) {
+    entry.stats.misses++;
+    if (now - due > entry.stats.maxLatenessMs) {
+      entry.stats.maxLatenessMs = now - due;
+    }
+  }
+  if (entry.changed && now - entry.changedAt > entry.stats.maxChangeMs) {
+    entry.stats.maxChangeMs = now - entry.changedAt;
+  }
+  entry.changed = false;
+  entry.stats.aired++;
+  entry.lastAired = now;
+  entry.deadline = now + entry.periodMs;
+  entry.onAir = true;
+}
+
+void BtHomeIdentityScheduler::released(size_t identity) {
+  if (identity < _count) {
+    _entries[identity].onAir = false;
+  }
+}
+
+uint32_t BtHomeIdentityScheduler::getDeadline(size_t identity) const {
+  return identity < _count ? _entries[identity].deadline : 0;
+}
+
+const BtHomeIdentityStats& BtHomeIdentityScheduler::getStats(
+    size_t identity) const {
+  return _entries[identity < _count ? identity : 0].stats;
+}
+
+BtHomeMultiAdvertiser::BtHomeMultiAdvertiser(uint32_t dwellMs,
+                                             uint16_t interval)
+    : _dwellMs(dwellMs), _interval(interval) {}
+
+bool BtHomeMultiAdvertiser::addRadio(BtHomeRadio& radio) {
+  if (_channelCount == MAX_RADIOS) {
+    return false;
+  }
+  Channel& channel = _channels[_channelCount++];
+  channel.radio = &radio;
+  channel.identity = BtHomeIdentityScheduler::NONE;
+  channel.since = 0;
+  return true;
+}
+
+int BtHomeMultiAdvertiser::addIdentity(BtHomeV2Device& device,
+                                       const uint8_t address[6],
+                                       uint32_t periodMs, uint32_t now) {
+  int index = _scheduler.add(periodMs, now);
+  if (index != BtHomeIdentityScheduler::NONE) {
+    Identity& identity = _identities[index];
+    identity.device = &device;
+    // Radios take the address most significant byte first
+    for (size_t i = 0; i < sizeof(identity.address); i++) {
+      identity.address[i] = address[sizeof(identity.address) - 1 - i];
+    }
+    identity.changed = false;
+  }
+  return index;
+}
+
+void BtHomeMultiAdvertiser::markChanged(size_t identity, uint32_t now) {
+  if (identity < _scheduler.size()) {
+    _identities[identity].changed = true;
+    _scheduler.markChanged(identity, now);
+  }
+}
+
+void BtHomeMultiAdvertiser::poll(uint32_t now) {
+  for (size_t i = 0; i < _channelCount; i++) {
+    Channel& channel = _channels[i];
+    bool idle = channel.identity == BtHomeIdentityScheduler::NONE;
+    if (!idle && now - channel.since < _dwellMs) {
+      // Changed data of the identity on air goes out without waiting
+      if (_identities[channel.identity].changed) {
+        air(channel, channel.identity, now);
+      }
+      continue;
+    }
+    if (!idle) {
+      _scheduler.released(channel.identity);
+    }
+    int next = _scheduler.next();
+    if (next != BtHomeIdentityScheduler::NONE) {
+      channel.since = now;
+      air(channel, next, now);
+    }
+  }
+}
+
+/// @brief Encodes identity and puts it on the radio of channel. A new
+/// identity needs a restart for its address, the same one swaps its data.
+void BtHomeMultiAdvertiser::air(Channel& channel, size_t identity,
+                                uint32_t now) {
+  Identity& entry = _identities[identity];
+  uint8_t data[MAX_ADVERTISEMENT_SIZE];
+  size_t size = entry.device->getAdvertisementData(data);
+  entry.changed = false;
+  _scheduler.aired(identity, now);
+  if (size == 0) {
+    return;
+  }
+  BtHomeRadio& radio = *channel.radio;
+  if (channel.identity == static_cast<int>(identity) &&
+      radio.update(data, size)) {
+    BTHOME_TRACE_EVENT(BtHome_Trace_RadioUpdate, size);
+    return;
+  }
+  channel.identity = static_cast<int>(identity);
+  radio.setAddress(entry.address);
+  bool started = radio.start(data, size, _interval);
+  BTHOME_TRACE_EVENT(BtHome_Trace_RadioStart, started ? size : 0);
+  if (!started) {
+    // Free the radio, the next poll() tries again
+    BTHOME_LOGW("identity %u did not start", static_cast<unsigned>(identity));
+    _scheduler.released(identity);
+    channel.identity = BtHomeIdentityScheduler::NONE;
+  }
+}
+
+void BtHomeMultiAdvertiser::stop() {
+  for (size_t i = 0; i < _channelCount; i++) {
+    Channel& channel = _channels[i];
+    if (channel.identity != BtHomeIdentityScheduler::NONE) {
+      channel.radio->stop();
+      BTHOME_TRACE_EVENT(BtHome_Trace_RadioStop, 0);
+      _scheduler.released(channel.identity);
+      channel.identity = BtHomeIdentityScheduler::NONE;
+    }
+  }
+}
+
+int BtHomeMultiAdvertiser::onAir(size_t radio) const {
+  return radio < _channelCount ? _channels[radio].identity
+                               : BtHomeIdentityScheduler::NONE;
+}
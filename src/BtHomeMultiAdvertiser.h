@@ -0,0 +1,173 @@
+/**
+ * @file BtHomeMultiAdvertiser.h
+ * @brief Several BTHome identities time-multiplexed on one controller.
+ *
+ * A bridge that forwards wired sensors advertises each of them as its own
+ * BTHome device: with its own name, random static address, bind key and
+ * counter (one BtHomeV2Device per identity). BtHomeMultiAdvertiser puts one
+ * identity at a time on every radio, for a dwell time of a few advertising
+ * events, and picks the next one with BtHomeIdentityScheduler. With several
+ * extended advertising sets (one BtHomeRadio each) as many identities are on
+ * air at the same time.
+ *
+ * @code
+ * BtHomeV2Device kitchen("Kitchen", "Kitchen", false, KEY1, MAC1);
+ * BtHomeV2Device cellar("Cellar", "Cellar", false, KEY2, MAC2);
+ * ArduinoBleRadio radio;
+ * BtHomeMultiAdvertiser advertiser;
+ *
+ * void setup() {
+ *   BLE.begin();
+ *   advertiser.addRadio(radio);
+ *   advertiser.addIdentity(kitchen, MAC1, 1000, millis());
+ *   advertiser.addIdentity(cellar, MAC2, 5000, millis());
+ * }
+ *
+ * void loop() {
+ *   kitchen.clearMeasurementData();
+ *   kitchen.addTemperature_neg327_to_327_Resolution_0_01(readKitchen());
+ *   advertiser.markChanged(0, millis());  // On air within one dwell time
+ *   advertiser.poll(millis());
+ * }
+ * @endcode
+ *
+ * The scheduler has no platform code; bthome_multi runs it on MockRadios.
+ */
+
+#ifndef BT_HOME_MULTI_ADVERTISER_H
+#define BT_HOME_MULTI_ADVERTISER_H
+
+#include <Arduino.h>
+
+#include "BtHomeAdvertisingScheduler.h"
+#include "BtHomeRadio.h"
+#include "BtHomeV2Device.h"
+
+/// @brief How an identity was served, see BtHomeIdentityScheduler.
+struct BtHomeIdentityStats {
+  uint32_t aired;          // Payloads put on air, refreshes included
+  uint32_t misses;         // Went on air later than one period after the last
+  uint32_t maxLatenessMs;  // Longest time past such a deadline
+  uint32_t maxChangeMs;    // Longest time from markChanged() to on air
+};
+
+/// @brief Earliest-deadline-first choice of the identity to put on air.
+///
+/// Every identity has a period: the longest time it may stay off air. Going
+/// on air sets its deadline one period ahead, markChanged() pulls it in to
+/// now (misses are still counted against the period). A free radio takes
+/// the identity with the earliest deadline that is not on another radio;
+/// equal deadlines go to the one that was off air longest, so identities
+/// with the same period take turns. When more is asked than the radios can
+/// send, all identities fall behind evenly instead of some starving, and the
+/// misses show in getStats(). A running dwell is not cut short, so an
+/// identity can be up to one dwell time late even when the radios keep up.
+class BtHomeIdentityScheduler {
+ public:
+  static const size_t MAX_IDENTITIES = 16;
+  static const int NONE = -1;
+
+  /// @brief Add an identity that is due at once.
+  /// @param periodMs Longest time off air
+  /// @return Index of the identity, NONE if MAX_IDENTITIES are in use
+  int add(uint32_t periodMs, uint32_t now);
+
+  bool setPeriod(size_t identity, uint32_t periodMs);
+
+  /// @brief New data for identity: due now.
+  void markChanged(size_t identity, uint32_t now);
+
+  /// @brief Identity to put on air next.
+  /// @return NONE if every identity is on air
+  int next() const;
+
+  /// @brief identity went on air at now, or got new data while on air.
+  void aired(size_t identity, uint32_t now);
+
+  /// @brief identity left the air, next() may pick it again.
+  void released(size_t identity);
+
+  size_t size() const { return _count; }
+  uint32_t getDeadline(size_t identity) const;
+  const BtHomeIdentityStats& getStats(size_t identity) const;
+
+ private:
+  struct Entry {
+    uint32_t periodMs;
+    uint32_t deadline;
+    uint32_t lastAired;
+    uint32_t changedAt;
+    bool changed;
+    bool onAir;
+    BtHomeIdentityStats stats;
+  };
+
+  Entry _entries[MAX_IDENTITIES];
+  size_t _count = 0;
+};
+
+/// @brief Advertises BtHomeV2Device identities in turn on one or more
+/// radios.
+class BtHomeMultiAdvertiser {
+ public:
+  /// Advertising events per dwell at the shortest interval, with advDelay.
+  static const uint32_t DEFAULT_DWELL_MS = 100;
+  /// Radios (advertising sets) used at the same time.
+  static const size_t MAX_RADIOS = 4;
+
+  /// @param dwellMs Time an identity stays on a radio before the next one
+  /// @param interval Advertising interval in 0.625 ms units
+  explicit BtHomeMultiAdvertiser(
+      uint32_t dwellMs = DEFAULT_DWELL_MS,
+      uint16_t interval = MIN_ADVERTISING_INTERVAL_UNITS);
+
+  /// @brief Add a radio; every radio needs its own advertising set.
+  /// @return false if MAX_RADIOS are in use
+  bool addRadio(BtHomeRadio& radio);
+
+  /// @brief Add an identity advertised from address.
+  /// @param device Encoder with the name, key and counter of the identity
+  /// @param address Random static address, least significant byte first
+  /// like the MAC of device, so both can be the same array
+  /// @param periodMs Longest time off air
+  /// @return Index of the identity, BtHomeIdentityScheduler::NONE if full
+  int addIdentity(BtHomeV2Device& device, const uint8_t address[6],
+                  uint32_t periodMs, uint32_t now);
+
+  /// @brief Measurements of identity changed: put them on air next.
+  void markChanged(size_t identity, uint32_t now);
+
+  /// @brief Rotate radios whose dwell time is over. Call from loop().
+  void poll(uint32_t now);
+
+  /// @brief Stop all radios.
+  void stop();
+
+  /// @brief Identity on radio, BtHomeIdentityScheduler::NONE if idle.
+  int onAir(size_t radio) const;
+
+  const BtHomeIdentityScheduler& scheduler() const { return _scheduler; }
+
+ private:
+  struct Channel {
+    BtHomeRadio* radio;
+    int identity;
+    uint32_t since;
+  };
+  struct Identity {
+    BtHomeV2Device* device;
+    uint8_t address[6];
+    bool changed;
+  };
+
+  void air(Channel& channel, size_t identity, uint32_t now);
+
+  uint32_t _dwellMs;
+  uint16_t _interval;
+  BtHomeIdentityScheduler _scheduler;
+  Identity _identities[BtHomeIdentityScheduler::MAX_IDENTITIES];
+  Channel _channels[MAX_RADIOS];
+  size_t _channelCount = 0;
+};
+
+#endif  // BT_HOME_MULTI_ADVERTISER_H
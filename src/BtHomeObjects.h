@@ -0,0 +1,138 @@
+/**
+ * @file BtHomeObjects.h
+ * @brief Wire layout of every object id, derived from data_types.h.
+ *
+ * bthomeObjectInfo() looks up the value size, signedness and exact scale of
+ * an object id in a 256-entry table that the compiler builds from the
+ * descriptors in data_types.h, so decoders and encoders handle the whole
+ * object set in O(1) without a switch per id. A descriptor added to
+ * data_types.h only has to be listed in TYPES or STATES below. The ids of
+ * BThomeObjectID (BThomeV2.h) are checked against their descriptors there.
+ */
+
+#ifndef BT_HOME_OBJECTS_H
+#define BT_HOME_OBJECTS_H
+
+#include <Arduino.h>
+
+#include "data_types.h"
+
+/// byteCount of ids that data_types.h does not describe.
+static const uint8_t OBJECT_UNKNOWN = 0;
+/// byteCount of text (0x53) and raw (0x54): a length byte, then the bytes.
+static const uint8_t OBJECT_LENGTH_PREFIXED = 0xFF;
+/// byteCount of commands (0x3B): argument count in the low 5 bits of a header
+/// byte, then the opcode and the arguments.
+static const uint8_t OBJECT_COMMAND = 0xFE;
+
+static const uint8_t TEXT_OBJECT_ID = 0x53;
+static const uint8_t RAW_OBJECT_ID = 0x54;
+static const uint8_t COMMAND_OBJECT_ID = 0x3B;
+static const uint8_t TIMESTAMP_OBJECT_ID = 0x50;
+
+/// @brief Wire layout of one object id.
+struct BtHomeObjectInfo {
+  uint8_t byteCount;  // Value bytes, or one of the OBJECT_* kinds above
+  bool signed_value;
+  BtHomeScale scale;  // {1, 1} for states and variable-length objects
+};
+
+namespace bthome_objects {
+
+constexpr BtHomeType TYPES[] = {
+    temperature_int8, temperature_int8_scale_0_35, temperature_int16_scale_0_1,
+    temperature_int16_scale_0_01, count_uint8, count_uint16, count_uint32,
+    count_int8, count_int16, count_int32, voltage_0_001, voltage_0_1, packet_id,
+    battery_percentage, distance_millimetre, distance_metre, acceleration,
+    channel, co2, conductivity, current_uint16, current_int16, dewpoint,
+    direction, duration_uint24, energy_uint32, energy_uint24, gas_uint24,
+    gas_uint32, gyroscope, humidity_uint16, humidity_uint8, illuminance,
+    mass_kg, mass_lb, moisture_uint16, moisture_uint8, pm2_5, pm10,
+    power_uint24, power_int32, precipitation, pressure, rotation, speed,
+    timestamp, tvoc, volume_uint32, volume_uint16_scale_0_1,
+    volume_uint16_scale_1, volume_storage, volume_flow_rate, UV_index,
+    water_litre, time_type,};
+
+constexpr BtHomeState STATES[] = {
+    battery_state, battery_charging, carbon_monoxide, cold, connectivity, door,
+    garage_door, gas, generic_boolean, heat, light, lock, moisture, motion,
+    moving, occupancy, opening, plug, power, presence, problem, running, safety,
+    smoke, sound, tamper, vibration, window, button, dimmer,};
+
+constexpr size_t TYPE_COUNT = sizeof(TYPES) / sizeof(TYPES[0]);
+constexpr size_t STATE_COUNT = sizeof(STATES) / sizeof(STATES[0]);
+
+constexpr BtHomeObjectInfo findState(uint8_t id, size_t index) {
+  return index == STATE_COUNT
+             ? BtHomeObjectInfo{OBJECT_UNKNOWN, false, {1, 1}}
+         : STATES[index].id == id
+             ? BtHomeObjectInfo{STATES[index].byteCount, false, {1, 1}}
+             : findState(id, index + 1);
+}
+
+constexpr BtHomeObjectInfo findType(uint8_t id, size_t index) {
+  return index == TYPE_COUNT ? findState(id, 0)
+         : TYPES[index].id == id
+             ? BtHomeObjectInfo{TYPES[index].byteCount,
+                                TYPES[index].signed_value,
+                                TYPES[index].exactScale}
+             : findType(id, index + 1);
+}
+
+constexpr BtHomeObjectInfo lookup(uint8_t id) {
+  return id == TEXT_OBJECT_ID || id == RAW_OBJECT_ID
+             ? BtHomeObjectInfo{OBJECT_LENGTH_PREFIXED, false, {1, 1}}
+         : id == COMMAND_OBJECT_ID
+             ? BtHomeObjectInfo{OBJECT_COMMAND, false, {1, 1}}
+             : findType(id, 0);
+}
+
+template <size_t... Ids>
+struct Sequence {};
+
+template <size_t Count, size_t... Ids>
+struct MakeSequence : MakeSequence<Count - 1, Count - 1, Ids...> {};
+
+template <size_t... Ids>
+struct MakeSequence<0, Ids...> {
+  typedef Sequence<Ids...> type;
+};
+
+template <typename Ids>
+struct Table;
+
+template <size_t... Ids>
+struct Table<Sequence<Ids...> > {
+  static constexpr BtHomeObjectInfo values[sizeof...(Ids)] = {
+      lookup(Ids)...};
+};
+
+template <size_t... Ids>
+constexpr BtHomeObjectInfo Table<Sequence<Ids...> >::values[sizeof...(Ids)];
+
+typedef Table<MakeSequence<256>::type> ObjectTable;
+
+constexpr bool allExact(size_t index) {
+  return index == TYPE_COUNT || (TYPES[index].exactScale.numerator != 0 &&
+                                 TYPES[index].byteCount <= 4 &&
+                                 allExact(index + 1));
+}
+
+static_assert(allExact(0),
+              "Encoders scale with the exact resolution of every type and "
+              "load at most 4 value bytes");
+static_assert(lookup(0x02).byteCount == 2 && lookup(0x02).signed_value &&
+                  lookup(0x02).scale.denominator == 100,
+              "temperature_int16_scale_0_01 is a signed 0.01 step int16");
+static_assert(lookup(0x3C).byteCount == 2, "dimmer has state and steps");
+static_assert(lookup(0xFF).byteCount == OBJECT_UNKNOWN, "0xFF is unused");
+
+}  // namespace bthome_objects
+
+/// @brief Layout of object id; byteCount is OBJECT_UNKNOWN for ids that
+/// data_types.h does not describe.
+inline const BtHomeObjectInfo& bthomeObjectInfo(uint8_t id) {
+  return bthome_objects::ObjectTable::values[id];
+}
+
+#endif  // BT_HOME_OBJECTS_H
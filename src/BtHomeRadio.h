@@ -0,0 +1,49 @@
+/**
+ * @file BtHomeRadio.h
+ * @brief Advertiser interface between BThomeV2 and the BLE stacks.
+ *
+ * BThomeV2 decides when an advertisement goes on air; a radio backend only
+ * knows how to program the controller. A new payload with the same interval
+ * is swapped into the running advertiser with update(), which the
+ * controller picks up at its next advertising event, so the advertiser never
+ * goes off air. start() (stop, configure, enable) is only needed for the
+ * first advertisement, interval changes and payloads the stack cannot swap.
+ *
+ * The backends live with the platform code (BThomeV2_ESP32.cpp,
+ * BThomeV2_nRF52.cpp); host/shim/MockRadio.h measures update latency and
+ * on-air gaps of both paths (see bthome_radio).
+ */
+
+#ifndef BT_HOME_RADIO_H
+#define BT_HOME_RADIO_H
+
+#include <Arduino.h>
+
+/// @brief One advertising set of a BLE controller.
+class BtHomeRadio {
+ public:
+  virtual ~BtHomeRadio() {}
+
+  /// @brief (Re)start advertising data, stopping a running advertiser.
+  /// @param data Advertisement as built by BaseDevice::getAdvertisementData()
+  /// @param interval Advertising interval in 0.625 ms units
+  /// @return true if the advertiser runs
+  virtual bool start(const uint8_t* data, size_t size, uint16_t interval) = 0;
+
+  /// @brief Replace the data of the running advertiser without stopping it.
+  /// @return false if the stack cannot swap this data while advertising; the
+  /// caller then restarts with start()
+  virtual bool update(const uint8_t* data, size_t size) = 0;
+
+  /// @brief Stop advertising.
+  virtual void stop() = 0;
+
+  /// @brief Advertise from a random static address from the next start() on,
+  /// e.g. for several identities on one controller.
+  /// The address is passed most significant byte first; its two top bits
+  /// must be set (random static).
+  /// @return false if the backend always uses the controller address
+  virtual bool setAddress(const uint8_t[6]) { return false; }
+};
+
+#endif  // BT_HOME_RADIO_H
@@ -0,0 +1,330 @@
+/**
+ * @file BtHomeReceiver.h
+ * @brief Platform independent receive pipeline of a BTHome gateway.
+ *
+ * BasicBtHomeReceiver takes raw advertisements (from a scanner or a recorded
+ * stream), keeps those with BTHome service data (UUID 0xFCD2) and stores the
+ * latest service data of every sender in a fixed-size, open-addressed hash
+ * table keyed by MAC address. Repeated advertisements of the same packet are
+ * dropped:
+ *
+ * - encrypted packets unless their counter increased (also stops replays)
+ * - packets with a packet id (object 0x00) unless the id changed
+ * - other packets unless their bytes changed
+ *
+ * Nothing is allocated after construction, and the caller passes the time,
+ * so the whole pipeline runs unchanged on host.
+ *
+ * @code
+ * BtHomeReceiver receiver;
+ * receiver.process(mac, advertisement, length, rssi, millis());
+ * const BtHomeReceiver::Entry* entry = receiver.find(mac);
+ * BtHomeObject temperature;
+ * if (entry && entry->serviceData().find(0x02, temperature)) { ... }
+ * @endcode
+ */
+
+#ifndef BT_HOME_RECEIVER_H
+#define BT_HOME_RECEIVER_H
+
+#include <Arduino.h>
+
+#include "BtHomeDecoder.h"
+
+/// Receivers keep addresses most significant byte first, as printed.
+static const size_t BLE_ADDRESS_LENGTH = 6;
+/// Service data of a legacy advertisement: 31 bytes minus the flags (3) and
+/// the service data header (length, type, UUID).
+static const size_t MAX_LEGACY_SERVICE_DATA = 24;
+static const size_t DEFAULT_RECEIVER_CAPACITY = 256;
+
+/// @brief Outcome of BasicBtHomeReceiver::process().
+enum BtHomeReceiveResult {
+  BtHome_Receive_New,        ///< First packet of a device, stored
+  BtHome_Receive_Updated,    ///< New packet of a known device, stored
+  BtHome_Receive_Duplicate,  ///< Same packet again (or a replayed counter)
+  BtHome_Receive_Ignored,    ///< No BTHome v2 service data
+  BtHome_Receive_Malformed,  ///< BTHome service data that does not decode
+  BtHome_Receive_Too_Long,   ///< Service data larger than ServiceDataSize
+  BtHome_Receive_Table_Full  ///< New device, but the table is full
+};
+
+/// @brief Consumer of raw advertisements; lets the platform scanners feed
+/// receivers of any size.
+class BtHomeAdvertisementSink {
+ public:
+  virtual ~BtHomeAdvertisementSink() {}
+
+  /// @brief Feed one received advertisement.
+  /// @param mac Sender address, most significant byte first
+  /// @param advertisement Raw advertising data (AD structures)
+  /// @param now Receive time in ms, e.g. millis()
+  virtual BtHomeReceiveResult process(const uint8_t mac[BLE_ADDRESS_LENGTH],
+                                      const uint8_t* advertisement,
+                                      size_t length, int8_t rssi,
+                                      uint32_t now) = 0;
+};
+
+/// @brief Receive pipeline and device table.
+/// @tparam Capacity Table slots, a power of two; at most 7/8 of them are
+/// used so probe sequences stay short
+/// @tparam ServiceDataSize Service data bytes stored per device
+template <size_t Capacity = DEFAULT_RECEIVER_CAPACITY,
+          size_t ServiceDataSize = MAX_LEGACY_SERVICE_DATA>
+class BasicBtHomeReceiver : public BtHomeAdvertisementSink {
+ public:
+  static_assert(Capacity >= 8 && (Capacity & (Capacity - 1)) == 0,
+                "Capacity must be a power of two");
+  static_assert(ServiceDataSize >= 1 && ServiceDataSize <= 255,
+                "Service data is stored with an 8 bit length");
+
+  static const size_t MAX_DEVICES = Capacity - Capacity / 8;
+
+  /// @brief Latest state of one sender.
+  struct Entry {
+    uint8_t mac[BLE_ADDRESS_LENGTH];
+    bool used;
+    bool hasPacketId;
+    uint8_t packetId;
+    bool hasCounter;
+    uint32_t counter;
+    int8_t rssi;
+    uint32_t firstSeen;
+    uint32_t lastSeen;    // Last advertisement, duplicates included
+    uint32_t lastUpdate;  // Last stored packet
+    uint32_t packets;     // Stored packets
+    uint32_t duplicates;  // Dropped repetitions
+    uint8_t length;
+    uint8_t data[ServiceDataSize];
+
+    /// @brief Decoder view of the stored service data.
+    BtHomeServiceData serviceData() const {
+      return BtHomeServiceData(data, length);
+    }
+  };
+
+  /// Called for every stored packet (New and Updated).
+  typedef void (*Callback)(const Entry& entry, void* context);
+
+  BasicBtHomeReceiver() { clear(); }
+
+  void setCallback(Callback callback, void* context = nullptr) {
+    _callback = callback;
+    _context = context;
+  }
+
+  BtHomeReceiveResult process(const uint8_t mac[BLE_ADDRESS_LENGTH],
+                              const uint8_t* advertisement, size_t length,
+                              int8_t rssi, uint32_t now) override {
+    BtHomeServiceData serviceData;
+    if (!BtHomeServiceData::fromAdvertisement(advertisement, length,
+                                              serviceData) ||
+        !serviceData.isValid()) {
+      _ignored++;
+      return BtHome_Receive_Ignored;
+    }
+
+    // Encrypted: ciphertext, counter, MIC. Plain: the packet id is the
+    // first object because objects are ordered by id.
+    bool encrypted = serviceData.isEncrypted();
+    uint32_t counter = 0;
+    bool hasPacketId = false;
+    uint8_t packetId = 0;
+    if (encrypted) {
+      if (serviceData.payloadLength() < COUNTER_AND_MIC_SIZE) {
+        _malformed++;
+        return BtHome_Receive_Malformed;
+      }
+      const uint8_t* trailer = serviceData.payload() +
+                               serviceData.payloadLength() -
+                               COUNTER_AND_MIC_SIZE;
+      counter = (uint32_t)trailer[0] | ((uint32_t)trailer[1] << 8) |
+                ((uint32_t)trailer[2] << 16) | ((uint32_t)trailer[3] << 24);
+    } else {
+      if (!serviceData.isWellFormed()) {
+        _malformed++;
+        return BtHome_Receive_Malformed;
+      }
+      BtHomeObjectIterator first = serviceData.begin();
+      if (first != serviceData.end() && first->id == packet_id.id) {
+        hasPacketId = true;
+        packetId = first->data[0];
+      }
+    }
+
+    size_t size = serviceData.payloadLength() + 1;
+    if (size > ServiceDataSize) {
+      _tooLong++;
+      return BtHome_Receive_Too_Long;
+    }
+
+    bool created = false;
+    Entry* entry = findOrInsert(mac, created);
+    if (!entry) {
+      _tableFull++;
+      return BtHome_Receive_Table_Full;
+    }
+    entry->lastSeen = now;
+    entry->rssi = rssi;
+
+    if (created) {
+      entry->firstSeen = now;
+    } else {
+      const uint8_t* bytes = serviceData.payload() - 1;
+      bool duplicate =
+          encrypted ? entry->hasCounter && counter <= entry->counter
+          : hasPacketId
+              ? entry->hasPacketId && packetId == entry->packetId
+              : !entry->hasPacketId && entry->length == size &&
+                    memcmp(entry->data, bytes, size) == 0;
+      if (duplicate) {
+        entry->duplicates++;
+        _duplicates++;
+        return BtHome_Receive_Duplicate;
+      }
+    }
+
+    entry->hasCounter = encrypted;
+    entry->counter = counter;
+    entry->hasPacketId = hasPacketId;
+    entry->packetId = packetId;
+    entry->length = size;
+    memcpy(entry->data, serviceData.payload() - 1, size);
+    entry->lastUpdate = now;
+    entry->packets++;
+    _stored++;
+    if (_callback) {
+      _callback(*entry, _context);
+    }
+    return created ? BtHome_Receive_New : BtHome_Receive_Updated;
+  }
+
+  /// @brief Device with mac, or nullptr.
+  const Entry* find(const uint8_t mac[BLE_ADDRESS_LENGTH]) const {
+    size_t slot = slotOf(mac);
+    return _entries[slot].used ? &_entries[slot] : nullptr;
+  }
+
+  /// @brief Drop devices not heard for longer than maxAge ms.
+  /// @return Number of removed devices
+  size_t expire(uint32_t now, uint32_t maxAge) {
+    size_t removed = 0;
+    size_t slot = 0;
+    while (slot < Capacity) {
+      Entry& entry = _entries[slot];
+      if (entry.used && now - entry.lastSeen > maxAge) {
+        // The slot is refilled by a shifted entry, so look at it again
+        remove(slot);
+        removed++;
+      } else {
+        slot++;
+      }
+    }
+    return removed;
+  }
+
+  /// @brief Call f(const Entry&) for every device.
+  template <typename Function>
+  void forEach(Function f) const {
+    for (size_t slot = 0; slot < Capacity; slot++) {
+      if (_entries[slot].used) {
+        f(_entries[slot]);
+      }
+    }
+  }
+
+  void clear() {
+    for (size_t slot = 0; slot < Capacity; slot++) {
+      _entries[slot].used = false;
+    }
+    _size = 0;
+  }
+
+  size_t size() const { return _size; }
+
+  /// Advertisements per BtHomeReceiveResult since construction.
+  uint32_t getStoredCount() const { return _stored; }
+  uint32_t getDuplicateCount() const { return _duplicates; }
+  uint32_t getIgnoredCount() const { return _ignored; }
+  uint32_t getMalformedCount() const { return _malformed; }
+  uint32_t getTooLongCount() const { return _tooLong; }
+  uint32_t getTableFullCount() const { return _tableFull; }
+
+ private:
+  static const size_t COUNTER_AND_MIC_SIZE = 8;
+  static const size_t MASK = Capacity - 1;
+
+  static size_t hash(const uint8_t mac[BLE_ADDRESS_LENGTH]) {
+    // FNV-1a; vendor prefixes repeat, so all six bytes are mixed in
+    uint32_t value = 2166136261u;
+    for (uint8_t i = 0; i < BLE_ADDRESS_LENGTH; i++) {
+      value = (value ^ mac[i]) * 16777619u;
+    }
+    return value ^ (value >> 16);
+  }
+
+  /// @brief Slot holding mac, or the free slot ending its probe sequence.
+  size_t slotOf(const uint8_t mac[BLE_ADDRESS_LENGTH]) const {
+    size_t slot = hash(mac) & MASK;
+    while (_entries[slot].used &&
+           memcmp(_entries[slot].mac, mac, BLE_ADDRESS_LENGTH) != 0) {
+      slot = (slot + 1) & MASK;
+    }
+    return slot;
+  }
+
+  Entry* findOrInsert(const uint8_t mac[BLE_ADDRESS_LENGTH], bool& created) {
+    size_t slot = slotOf(mac);
+    Entry& entry = _entries[slot];
+    if (entry.used) {
+      created = false;
+      return &entry;
+    }
+    if (_size >= MAX_DEVICES) {
+      return nullptr;
+    }
+    memset(&entry, 0, sizeof(entry));
+    memcpy(entry.mac, mac, BLE_ADDRESS_LENGTH);
+    entry.used = true;
+    _size++;
+    created = true;
+    return &entry;
+  }
+
+  /// @brief Backward-shift deletion: moves later entries of the probe
+  /// sequence up so lookups need no tombstones.
+  void remove(size_t slot) {
+    size_t hole = slot;
+    size_t next = (slot + 1) & MASK;
+    while (_entries[next].used) {
+      size_t home = hash(_entries[next].mac) & MASK;
+      // Move the entry if its home slot is not between hole and next
+      if (((next - home) & MASK) >= ((next - hole) & MASK)) {
+        _entries[hole] = _entries[next];
+        hole = next;
+      }
+      next = (next + 1) & MASK;
+    }
+    _entries[hole].used = false;
+    _size--;
+  }
+
+  Entry _entries[Capacity];
+  size_t _size = 0;
+  Callback _callback = nullptr;
+  void* _context = nullptr;
+  uint32_t _stored = 0;
+  uint32_t _duplicates = 0;
+  uint32_t _ignored = 0;
+  uint32_t _malformed = 0;
+  uint32_t _tooLong = 0;
+  uint32_t _tableFull = 0;
+};
+
+template <size_t Capacity, size_t ServiceDataSize>
+const size_t BasicBtHomeReceiver<Capacity, ServiceDataSize>::MAX_DEVICES;
+
+/// Receiver for up to 224 legacy advertisers.
+typedef BasicBtHomeReceiver<> BtHomeReceiver;
+
+#endif  // BT_HOME_RECEIVER_H
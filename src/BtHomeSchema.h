@@ -0,0 +1,202 @@
+/**
+ * @file BtHomeSchema.h
+ * @brief Compile-time packet layouts for sensors that always send the same
+ * set of objects.
+ *
+ * The object order, the offset of every value and the total packet size are
+ * computed by the compiler, so an update is a plain little-endian store into
+ * the advertisement buffer without space checks, scaling or sorting.
+ *
+ * @code
+ * typedef BtHomeSchema<false, BTHOME_FIELD(temperature_int16_scale_0_01),
+ *                      BTHOME_FIELD(humidity_uint16),
+ *                      BTHOME_FIELD(battery_percentage)>
+ *     ClimatePacket;
+ *
+ * ClimatePacket packet;
+ * packet.set<0>(2137);  // 21.37 °C in 0.01 °C steps
+ * packet.set<1>(5555);  // 55.55 % in 0.01 % steps
+ * packet.set<2>(87);    // 87 %
+ * radio.send(packet.data(), packet.size());
+ * @endcode
+ */
+
+#ifndef BT_HOME_SCHEMA_H
+#define BT_HOME_SCHEMA_H
+
+#include <Arduino.h>
+
+#include "BaseDevice.h"
+
+/// @brief Compile-time descriptor of a single object in a schema.
+template <uint8_t Id, uint8_t ByteCount>
+struct BtHomeField {
+  static constexpr uint8_t id = Id;
+  static constexpr uint8_t byteCount = ByteCount;
+};
+
+/// @brief Turns a descriptor from data_types.h into a schema field.
+#define BTHOME_FIELD(descriptor) \
+  BtHomeField<(descriptor).id, (descriptor).byteCount>
+
+namespace bthome_schema {
+
+template <size_t Index, typename... Fields>
+struct FieldAt;
+
+template <typename Field, typename... Rest>
+struct FieldAt<0, Field, Rest...> {
+  typedef Field type;
+};
+
+template <size_t Index, typename Field, typename... Rest>
+struct FieldAt<Index, Field, Rest...> {
+  typedef typename FieldAt<Index - 1, Rest...>::type type;
+};
+
+template <typename... Fields>
+struct TotalSize;
+
+template <>
+struct TotalSize<> {
+  static constexpr size_t value = 0;
+};
+
+template <typename Field, typename... Rest>
+struct TotalSize<Field, Rest...> {
+  static constexpr size_t value =
+      TYPE_INDICATOR_SIZE + Field::byteCount + TotalSize<Rest...>::value;
+};
+
+/// Bytes of all fields that go in front of the field (Id, Index) on the wire.
+/// Fields are ordered by object id; equal ids keep their declaration order.
+template <uint8_t Id, size_t Index, size_t Position, typename... Fields>
+struct SortedOffset;
+
+template <uint8_t Id, size_t Index, size_t Position>
+struct SortedOffset<Id, Index, Position> {
+  static constexpr size_t value = 0;
+};
+
+template <uint8_t Id, size_t Index, size_t Position, typename Field,
+          typename... Rest>
+struct SortedOffset<Id, Index, Position, Field, Rest...> {
+  static constexpr bool before =
+      Field::id < Id || (Field::id == Id && Position < Index);
+  static constexpr size_t value =
+      (before ? TYPE_INDICATOR_SIZE + Field::byteCount : 0) +
+      SortedOffset<Id, Index, Position + 1, Rest...>::value;
+};
+
+}  // namespace bthome_schema
+
+/// @brief Fixed-layout BTHome advertisement of at most MaxSize bytes.
+/// @tparam MaxSize Largest advertisement the schema may take, see
+/// BasicBaseDevice; a larger layout fails to compile
+/// @tparam Encrypted Reserve room for the counter and MIC of encrypted packets
+/// @tparam Fields BTHOME_FIELD() descriptors in any order
+template <size_t MaxSize, bool Encrypted, typename... Fields>
+class BasicBtHomeSchema {
+ public:
+  static constexpr size_t FIELD_COUNT = sizeof...(Fields);
+  static constexpr size_t MEASUREMENT_SIZE =
+      bthome_schema::TotalSize<Fields...>::value;
+  static constexpr size_t PAYLOAD_SIZE =
+      MEASUREMENT_SIZE + (Encrypted ? ENCRYPTION_TRAILER_SIZE : 0);
+  static constexpr size_t PACKET_SIZE = MEASUREMENT_OFFSET + PAYLOAD_SIZE;
+
+  static_assert(FIELD_COUNT > 0, "A schema needs at least one field");
+  static_assert(MaxSize >= MAX_ADVERTISEMENT_SIZE &&
+                    MaxSize <= MAX_EXTENDED_ADVERTISEMENT_SIZE,
+                "Advertisements hold 31 to 255 bytes");
+  static_assert(PACKET_SIZE <= MaxSize,
+                "Schema does not fit into MaxSize advertisement bytes");
+
+  /// @brief Offset of the value bytes of field Index in the packet.
+  template <size_t Index>
+  static constexpr size_t offset() {
+    return MEASUREMENT_OFFSET +
+           bthome_schema::SortedOffset<
+               bthome_schema::FieldAt<Index, Fields...>::type::id, Index, 0,
+               Fields...>::value +
+           TYPE_INDICATOR_SIZE;
+  }
+
+  explicit BasicBtHomeSchema(bool isTriggerBased = false) {
+    uint8_t indicatorByte = FLAG_VERSION;
+    if (isTriggerBased) {
+      indicatorByte |= FLAG_TRIGGER;
+    }
+    if (Encrypted) {
+      indicatorByte |= FLAG_ENCRYPT;
+    }
+
+    _buffer[0] = FLAG1;
+    _buffer[1] = FLAG2;
+    _buffer[2] = FLAG3;
+    _buffer[3] = PACKET_SIZE - 4;
+    _buffer[4] = SERVICE_DATA;
+    _buffer[5] = UUID1;
+    _buffer[6] = UUID2;
+    _buffer[7] = indicatorByte;
+    writeIds<0, Fields...>();
+  }
+
+  /// @brief Stores the wire value of field Index (already in the resolution
+  /// of its descriptor, e.g. 2137 for 21.37 °C at 0.01 °C).
+  template <size_t Index, typename T>
+  void set(T value) {
+    static_assert(Index < FIELD_COUNT, "Schema field index out of range");
+    typedef typename bthome_schema::FieldAt<Index, Fields...>::type Field;
+    uint32_t bits = static_cast<uint32_t>(value);
+    uint8_t* target = &_buffer[offset<Index>()];
+    for (uint8_t i = 0; i < Field::byteCount; i++) {
+      target[i] = static_cast<uint8_t>(bits >> (8 * i));
+    }
+  }
+
+  /// @brief Plaintext advertisement, ready for the radio when not encrypted.
+  /// Packets larger than MAX_ADVERTISEMENT_SIZE need extended advertising.
+  const uint8_t* data() const { return _buffer; }
+  size_t size() const { return PACKET_SIZE; }
+
+  /// @brief Copies the packet into buffer and encrypts the measurements with
+  /// the key and counter of device. The nonce takes the trigger flag from
+  /// device, so both have to be created with the same isTriggerBased.
+  /// @return Number of bytes written to buffer, 0 if the counter of device
+  /// cannot advance or encryption fails
+  template <size_t DeviceSize>
+  size_t getAdvertisementData(uint8_t buffer[PACKET_SIZE],
+                              BasicBaseDevice<DeviceSize>& device) {
+    static_assert(Encrypted, "Only encrypted schemas need a BaseDevice");
+    memcpy(buffer, _buffer, MEASUREMENT_OFFSET);
+    size_t encryptedLength = device.encryptMeasurements(
+        &_buffer[MEASUREMENT_OFFSET], MEASUREMENT_SIZE,
+        &buffer[MEASUREMENT_OFFSET]);
+    return encryptedLength == 0 ? 0 : MEASUREMENT_OFFSET + encryptedLength;
+  }
+
+ private:
+  template <size_t Index>
+  void writeIds() {}
+
+  template <size_t Index, typename Field, typename... Rest>
+  void writeIds() {
+    _buffer[offset<Index>() - TYPE_INDICATOR_SIZE] = Field::id;
+    writeIds<Index + 1, Rest...>();
+  }
+
+  uint8_t _buffer[PACKET_SIZE] = {0};
+};
+
+/// Schema of a legacy advertisement (31 bytes).
+template <bool Encrypted, typename... Fields>
+using BtHomeSchema =
+    BasicBtHomeSchema<MAX_ADVERTISEMENT_SIZE, Encrypted, Fields...>;
+
+/// Schema of a BLE 5 extended advertisement (255 bytes).
+template <bool Encrypted, typename... Fields>
+using ExtendedBtHomeSchema =
+    BasicBtHomeSchema<MAX_EXTENDED_ADVERTISEMENT_SIZE, Encrypted, Fields...>;
+
+#endif  // BT_HOME_SCHEMA_H
@@ -0,0 +1,70 @@
+/**
+ * @file BtHomeSleep.cpp
+ * @brief Retained state and advertising burst of BtHomeSleepCycle
+ */
+
+#include "BtHomeSleep.h"
+
+#include "BtHomeTrace.h"
+
+const uint16_t BtHomeSleepCycle::DEFAULT_BURST_EVENTS;
+const uint32_t BtHomeSleepCycle::ADV_DELAY_MAX_MS;
+
+bool BtHomeSleepCycle::startBurst(BtHomeRadio& radio, uint32_t now,
+                                  uint16_t events, uint16_t interval) {
+  if (_size == 0 || events == 0) {
+    return false;
+  }
+  if (interval < MIN_ADVERTISING_INTERVAL_UNITS) {
+    interval = MIN_ADVERTISING_INTERVAL_UNITS;
+  } else if (interval > MAX_ADVERTISING_INTERVAL_UNITS) {
+    interval = MAX_ADVERTISING_INTERVAL_UNITS;
+  }
+  _bursting = radio.start(_data, _size, interval);
+  BTHOME_TRACE_EVENT(BtHome_Trace_RadioStart, _bursting ? _size : 0);
+  // Every event can be pushed back by up to ADV_DELAY_MAX_MS
+  uint32_t intervalMs = (interval * 5u + 7) / 8;
+  _burstMs = events * (intervalMs + ADV_DELAY_MAX_MS);
+  _burstStart = now;
+  return _bursting;
+}
+
+uint32_t BtHomeSleepCycle::remainingMs(uint32_t now) const {
+  uint32_t elapsed = now - _burstStart;
+  return _bursting && elapsed < _burstMs ? _burstMs - elapsed : 0;
+}
+
+void BtHomeSleepCycle::finish(BtHomeRadio& radio) {
+  if (_bursting) {
+    radio.stop();
+    BTHOME_TRACE_EVENT(BtHome_Trace_RadioStop, 0);
+    _bursting = false;
+  }
+}
+
+bool BtHomeSleepCycle::isValid() const {
+  return _state.magic == BTHOME_RETAINED_MAGIC &&
+         _state.checksum == checksum(_state);
+}
+
+void BtHomeSleepCycle::save(uint32_t counter, uint8_t packetId) {
+  memset(&_state, 0, sizeof(_state));
+  _state.magic = BTHOME_RETAINED_MAGIC;
+  _state.counter = counter;
+  _state.counterLimit =
+      _persistentCounter ? _persistentCounter->getLimit() : 0;
+  _state.wakeups = _wakeups;
+  _state.packetId = packetId;
+  _state.checksum = checksum(_state);
+}
+
+/// @brief FNV-1a over the state in front of the checksum, to tell a saved
+/// state from RTC memory that lost power.
+uint32_t BtHomeSleepCycle::checksum(const BtHomeRetainedState& state) {
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&state);
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < offsetof(BtHomeRetainedState, checksum); i++) {
+    hash = (hash ^ bytes[i]) * 16777619u;
+  }
+  return hash;
+}
@@ -0,0 +1,163 @@
+/**
+ * @file BtHomeSleep.h
+ * @brief Wake, advertise a short burst and go back to deep sleep.
+ *
+ * A sensor that deep sleeps between readings spends most of its battery
+ * while it is awake, and most of that time goes to starting the BLE stack.
+ * BtHomeSleepCycle keeps the awake time short:
+ *
+ * - The encoder state (encryption counter, the counter block reserved in
+ *   flash and the packet id) is kept in a BtHomeRetainedState in RTC memory.
+ *   A wake-up restores it without reading or writing flash; only a cold boot
+ *   goes to the CounterStorage.
+ * - prepare() encodes and encrypts the advertisement before the radio is
+ *   started, so the stack only has to send finished bytes.
+ * - startBurst() sends a fixed number of advertising events, and
+ *   safeToSleep() reports when they are out.
+ *
+ * @code
+ * RTC_DATA_ATTR BtHomeRetainedState retained;  // Survives deep sleep
+ *
+ * void setup() {
+ *   BtHomeV2Device device("Sleepy", "Sleepy", false, KEY, MAC);
+ *   BtHomeSleepCycle cycle(retained);
+ *   cycle.restore(device, &counter);
+ *   device.addTemperature_neg327_to_327_Resolution_0_01(readTemperature());
+ *   cycle.prepare(device);  // Radio still off
+ *
+ *   BLE.begin();
+ *   ArduinoBleRadio radio;
+ *   cycle.startBurst(radio, millis());
+ *   delay(cycle.remainingMs(millis()));
+ *   cycle.finish(radio);
+ *   esp_deep_sleep(60 * 1000000ULL);
+ * }
+ * @endcode
+ *
+ * Everything except the radio runs on host; bthome_sleep simulates wake
+ * cycles with a MockRadio.
+ */
+
+#ifndef BT_HOME_SLEEP_H
+#define BT_HOME_SLEEP_H
+
+#include <Arduino.h>
+
+#include "BtHomeAdvertisingScheduler.h"
+#include "BtHomeRadio.h"
+#include "BtHomeV2Device.h"
+#include "CounterStorage.h"
+
+/// Value of BtHomeRetainedState::magic once a state was saved.
+static const uint32_t BTHOME_RETAINED_MAGIC = 0x32485442;  // "BTH2"
+
+/// @brief Encoder state that survives deep sleep. Place it in memory that is
+/// kept while sleeping (RTC_DATA_ATTR on ESP32, retained RAM on nRF52); it
+/// is invalid after power loss and BtHomeSleepCycle then starts cold.
+struct BtHomeRetainedState {
+  uint32_t magic;
+  uint32_t counter;       // Next encryption counter
+  uint32_t counterLimit;  // End of the block in storage, 0 if none
+  uint32_t wakeups;       // Since the last cold boot
+  uint8_t packetId;
+  uint8_t reserved[3];
+  uint32_t checksum;  // Over the fields above
+};
+
+/// @brief One wake-advertise-sleep cycle of a sleepy sensor.
+class BtHomeSleepCycle {
+ public:
+  /// Events per wake-up if startBurst() is not told otherwise.
+  static const uint16_t DEFAULT_BURST_EVENTS = 3;
+  /// Random advDelay the controller adds to every advertising event.
+  static const uint32_t ADV_DELAY_MAX_MS = 10;
+
+  explicit BtHomeSleepCycle(BtHomeRetainedState& state) : _state(state) {}
+
+  /// @brief Continue the counter and packet id of the last cycle.
+  ///
+  /// After a cold boot a PersistentCounter is started from its storage (one
+  /// write); without one the device keeps its constructor counter, which
+  /// receivers reject until it passes the last one they saw.
+  /// @param counter PersistentCounter of the device, or nullptr
+  /// @return true if the state came from RTC memory (warm wake-up)
+  template <size_t MaxSize>
+  bool restore(BasicBtHomeV2Device<MaxSize>& device,
+               PersistentCounter* counter = nullptr) {
+    _warm = isValid();
+    _persistentCounter = counter;
+    if (counter) {
+      bool resumed = _warm && _state.counterLimit != 0 &&
+                     counter->resume(_state.counter, _state.counterLimit);
+      if (!resumed) {
+        counter->begin();
+      }
+      device.setPersistentCounter(counter);
+    } else if (_warm) {
+      device.setCounter(_state.counter);
+    }
+    if (_warm) {
+      device.setPacketId(_state.packetId);
+    }
+    _wakeups = _warm ? _state.wakeups + 1 : 0;
+    return _warm;
+  }
+
+  /// @brief Encode (and encrypt) the advertisement with the radio still off
+  /// and save the state for the next cycle.
+  /// @return Advertisement size, 0 if encryption failed
+  template <size_t MaxSize>
+  size_t prepare(BasicBtHomeV2Device<MaxSize>& device) {
+    _size = device.getAdvertisementData(_data);
+    save(_persistentCounter ? _persistentCounter->getNext()
+                            : device.getCounter(),
+         device.getPacketId());
+    return _size;
+  }
+
+  /// @brief Advertise the prepared data for a burst of events.
+  /// @param now millis()
+  /// @param events Advertising events to send
+  /// @param interval Advertising interval in 0.625 ms units
+  /// @return false if nothing was prepared or the radio did not start
+  bool startBurst(BtHomeRadio& radio, uint32_t now,
+                  uint16_t events = DEFAULT_BURST_EVENTS,
+                  uint16_t interval = MIN_ADVERTISING_INTERVAL_UNITS);
+
+  /// @brief Milliseconds until the burst is out, 0 when it is safe to sleep.
+  uint32_t remainingMs(uint32_t now) const;
+
+  /// @brief true once the burst is out (or none was started) and the state
+  /// for the next cycle is saved.
+  bool safeToSleep(uint32_t now) const { return remainingMs(now) == 0; }
+
+  /// @brief Stop the advertiser before going to sleep.
+  void finish(BtHomeRadio& radio);
+
+  /// @brief true if restore() found a saved state.
+  bool isWarm() const { return _warm; }
+
+  /// @brief Wake-ups since the last cold boot.
+  uint32_t getWakeups() const { return _wakeups; }
+
+  /// @brief Advertisement built by prepare().
+  const uint8_t* data() const { return _data; }
+  size_t size() const { return _size; }
+
+ private:
+  bool isValid() const;
+  void save(uint32_t counter, uint8_t packetId);
+  static uint32_t checksum(const BtHomeRetainedState& state);
+
+  BtHomeRetainedState& _state;
+  PersistentCounter* _persistentCounter = nullptr;
+  bool _warm = false;
+  uint32_t _wakeups = 0;
+  uint8_t _data[MAX_EXTENDED_ADVERTISEMENT_SIZE];
+  size_t _size = 0;
+  bool _bursting = false;
+  uint32_t _burstStart = 0;
+  uint32_t _burstMs = 0;
+};
+
+#endif  // BT_HOME_SLEEP_H
@@ -0,0 +1,17 @@
+/**
+ * @file BtHomeTrace.cpp
+ * @brief Binary trace ring of timestamped pipeline events.
+ */
+
+#include "BtHomeTrace.h"
+
+#if BTHOME_TRACE
+BtHomeTrace bthomeTrace;
+#endif
+
+const char* btHomeTraceEventName(uint8_t event) {
+  static const char* const NAMES[] = {
+      "encode_begin", "encode_end",   "encrypt_begin", "encrypt_end",
+      "radio_start",  "radio_update", "radio_stop"};
+  return event < BtHome_Trace_User ? NAMES[event] : "user";
+}
@@ -0,0 +1,127 @@
+/**
+ * @file BtHomeTrace.h
+ * @brief Binary trace ring of timestamped pipeline events.
+ *
+ * With BTHOME_TRACE=1 the library records encode, encrypt and radio events
+ * into the global bthomeTrace: a timestamp, an event id and a 16 bit value
+ * (bytes, frame) written into a fixed ring, which costs a clock read and
+ * three stores and never blocks. The ring is read on demand, e.g. from a
+ * serial command, instead of printing in the hot path:
+ *
+ * @code
+ * // platformio.ini: build_flags = -DBTHOME_TRACE=1
+ * if (Serial.read() == 't') {
+ *   bthomeTrace.dump();  // Oldest first: "<time> <event> <value>"
+ * }
+ * @endcode
+ *
+ * Without BTHOME_TRACE the BTHOME_TRACE_EVENT() calls compile to nothing.
+ * BtHomeTrace itself is always available for own rings. Recording is not
+ * synchronized: trace from one task (or guard record() yourself).
+ */
+
+#ifndef BT_HOME_TRACE_H
+#define BT_HOME_TRACE_H
+
+#include <Arduino.h>
+
+#ifndef BTHOME_TRACE
+#define BTHOME_TRACE 0
+#endif
+
+/// Entries of the global ring, a power of two (8 bytes each).
+#ifndef BTHOME_TRACE_CAPACITY
+#define BTHOME_TRACE_CAPACITY 256
+#endif
+
+/// Timestamp source; a cycle counter gives finer steps where available.
+#ifndef BTHOME_TRACE_CLOCK
+#define BTHOME_TRACE_CLOCK() micros()
+#endif
+
+/// @brief What happened; the value of an entry depends on it.
+enum BtHomeTraceEvent : uint8_t {
+  BtHome_Trace_EncodeBegin,   // Frame number
+  BtHome_Trace_EncodeEnd,     // Advertisement bytes, 0 if unchanged
+  BtHome_Trace_EncryptBegin,  // Plaintext bytes
+  BtHome_Trace_EncryptEnd,    // Encrypted bytes, 0 on error
+  BtHome_Trace_RadioStart,    // Advertisement bytes, 0 if the start failed
+  BtHome_Trace_RadioUpdate,   // Advertisement bytes swapped in
+  BtHome_Trace_RadioStop,
+  BtHome_Trace_User  // First id free for application events
+};
+
+struct BtHomeTraceEntry {
+  uint32_t time;  // BTHOME_TRACE_CLOCK()
+  uint16_t value;
+  uint8_t event;
+};
+
+/// @brief Name of a library event, "user" for application ids.
+const char* btHomeTraceEventName(uint8_t event);
+
+/// @brief Ring of the last Capacity trace entries.
+template <size_t Capacity>
+class BasicBtHomeTrace {
+ public:
+  static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                "trace capacity must be a power of two");
+  static const size_t CAPACITY = Capacity;
+
+  void record(uint8_t event, uint16_t value = 0) {
+    BtHomeTraceEntry& entry = _entries[_recorded++ & (Capacity - 1)];
+    entry.time = BTHOME_TRACE_CLOCK();
+    entry.value = value;
+    entry.event = event;
+  }
+
+  /// @brief Entries recorded since the last clear(), overwritten ones
+  /// included.
+  uint32_t recorded() const { return _recorded; }
+
+  /// @brief Entries in the ring.
+  size_t size() const { return _recorded < Capacity ? _recorded : Capacity; }
+
+  /// @brief Copy up to count of the newest entries, oldest first.
+  /// @return Number of entries copied
+  size_t snapshot(BtHomeTraceEntry* output, size_t count) const {
+    size_t available = size();
+    if (count > available) {
+      count = available;
+    }
+    uint32_t first = _recorded - count;
+    for (size_t i = 0; i < count; i++) {
+      output[i] = _entries[(first + i) & (Capacity - 1)];
+    }
+    return count;
+  }
+
+  void clear() { _recorded = 0; }
+
+  /// @brief Print the ring to Serial, oldest first, one
+  /// "<time> <event> <value>" line per entry.
+  void dump() const {
+    uint32_t first = _recorded - size();
+    for (uint32_t i = first; i != _recorded; i++) {
+      const BtHomeTraceEntry& entry = _entries[i & (Capacity - 1)];
+      Serial.printf("%lu %s %u\n", static_cast<unsigned long>(entry.time),
+                    btHomeTraceEventName(entry.event),
+                    static_cast<unsigned int>(entry.value));
+    }
+  }
+
+ private:
+  BtHomeTraceEntry _entries[Capacity];
+  uint32_t _recorded = 0;
+};
+
+typedef BasicBtHomeTrace<BTHOME_TRACE_CAPACITY> BtHomeTrace;
+
+#if BTHOME_TRACE
+extern BtHomeTrace bthomeTrace;
+#define BTHOME_TRACE_EVENT(event, value) bthomeTrace.record(event, value)
+#else
+#define BTHOME_TRACE_EVENT(event, value) ((void)0)
+#endif
+
+#endif  // BT_HOME_TRACE_H
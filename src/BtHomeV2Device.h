@@ -23,22 +23,58 @@
 /// @brief Battery state options
 enum BATTERY_STATE { BATTERY_STATE_NORMAL = 0, BATTERY_STATE_LOW = 1 };
 
-class BtHomeV2Device {
+/// @brief BTHome v2 device for advertisements of up to MaxSize bytes.
+/// @tparam MaxSize See BasicBaseDevice
+template <size_t MaxSize>
+class BasicBtHomeV2Device {
  public:
+  /// Measurement bytes available per advertisement.
+  static const size_t MEASUREMENT_CAPACITY =
+      BasicBaseDevice<MaxSize>::ARENA_SIZE;
   /// @brief
   /// @param shortName Short name of the device - sent when space is limited.
   /// Max 10 characters
   /// @param completeName  Full name of the device - sent when space is
   /// available. Max 20 characters
   /// @param isTriggerDevice - If the device sends data when triggered
-  BtHomeV2Device(const char* shortName, const char* completeName,
-                 bool isTriggerDevice);
-  BtHomeV2Device(const char* shortName, const char* completeName,
-                 bool isTriggerBased, uint8_t const* const key,
-                 const uint8_t macAddress[BLE_MAC_ADDRESS_LENGTH],
-                 uint32_t counter = 1);
-
-  size_t getAdvertisementData(uint8_t buffer[MAX_ADVERTISEMENT_SIZE]);
+  BasicBtHomeV2Device(const char* shortName, const char* completeName,
+                      bool isTriggerDevice);
+  /// @brief Encrypting device.
+  /// @param key Bind key, 16 bytes
+  /// @param macAddress Bluetooth MAC of the sender, least significant byte
+  /// first (AA:BB:CC:DD:EE:FF is {0xFF, 0xEE, 0xDD, 0xCC, 0xBB, 0xAA})
+  /// @param counter Counter of the first encrypted packet
+  BasicBtHomeV2Device(const char* shortName, const char* completeName,
+                      bool isTriggerBased, uint8_t const* const key,
+                      const uint8_t macAddress[BLE_MAC_ADDRESS_LENGTH],
+                      uint32_t counter = 1);
+
+  size_t getAdvertisementData(uint8_t buffer[MaxSize]);
+
+  /// @brief Check whether the measurement data differs from the last
+  /// advertisement built with getAdvertisementData().
+  bool hasChanged() const;
+
+  /// @brief Send a packet id (object 0x00) that increments only when the
+  /// measurement data changes, so receivers can drop repeated packets.
+  /// @return false if the current measurements leave no room for the id
+  bool setPacketIdEnabled(bool enabled);
+
+  /// @brief Take encryption counters from a PersistentCounter so they keep
+  /// increasing across reboots and deep sleep.
+  /// @param counter Started counter, or nullptr to count in RAM
+  void setPersistentCounter(PersistentCounter* counter);
+
+  /// @brief Encrypt with a custom AES-CCM backend instead of DefaultCcm.
+  /// @param backend Backend with the bind key already set, or nullptr for the
+  /// default
+  void setCcmBackend(CcmBackend* backend);
+
+  /// @brief Compute the keystream of the next encrypted packet while idle, so
+  /// a trigger packet with the same measurement layout only needs the
+  /// CBC-MAC over its bytes.
+  /// @return false if encryption is off or the backend cannot precompute
+  bool precomputeEncryption();
 
   void clearMeasurementData();
 
@@ -64,6 +100,17 @@ class BtHomeV2Device {
   bool addTemperature_neg3276_to_3276_Resolution_0_1(float degreesCelsius);
   bool addTemperature_neg327_to_327_Resolution_0_01(float degreesCelsius);
 
+  /**
+   * @brief Integer-only variants for targets without an FPU. Values are
+   * rounded to the resolution of the object and saturated to its range.
+   * @param centiDegreesCelsius Temperature in 0.01 °C (2137 = 21.37 °C)
+   */
+  bool addTemperatureCentiDegrees(int32_t centiDegreesCelsius);
+  bool addHumidityCentiPercent(uint32_t centiPercent);
+  bool addPressurePascal(uint32_t pascal);
+  bool addIlluminanceCentiLux(uint32_t centiLux);
+  bool addVoltageMillivolts(uint32_t millivolts);
+
   /**
    * @brief Set the distance measurement value in the packet.
    * @param distanceMillimetres Distance in metres.
@@ -86,6 +133,38 @@ class BtHomeV2Device {
 
   bool addRaw(uint8_t* bytes, uint8_t size);
 
+  /// @brief Add an object whose value bytes are already in wire format
+  /// @param objectId BTHome object id
+  /// @param value Little endian, scaled value bytes
+  /// @param size Number of value bytes
+  bool addEncoded(uint8_t objectId, const uint8_t* value, uint8_t size);
+
+  /// @brief Overwrite the value of an object added before, in place
+  /// @param objectId BTHome object id
+  /// @param occurrence Which of the objects with this id, 0 for the first
+  /// @param value Little endian, scaled value bytes
+  /// @param size Number of value bytes, as added
+  /// @return false if there is no such object of that size
+  bool updateEncoded(uint8_t objectId, uint8_t occurrence,
+                     const uint8_t* value, uint8_t size);
+
+  /// @brief Number of objects in the measurement data.
+  uint8_t getObjectCount() const;
+
+  /// @brief Packets built, dropped objects and encryption time, see
+  /// BtHomeEncoderStats.
+  const BtHomeEncoderStats& getStats() const;
+  void resetStats();
+  /// @brief Counter of the next encrypted packet.
+  uint32_t getCounter() const;
+  /// @brief Continue counting at counter, e.g. after deep sleep. Ignored
+  /// while a PersistentCounter is set.
+  void setCounter(uint32_t counter);
+  /// @brief Packet id of the last advertisement.
+  uint8_t getPacketId() const;
+  /// @brief Continue the packet id sequence after packetId.
+  void setPacketId(uint8_t packetId);
+
   bool setBatteryState(BATTERY_STATE batteryState);
   bool setBatteryChargingState(
       Battery_Charging_Sensor_Status batteryChargingState);
@@ -208,7 +287,619 @@ class BtHomeV2Device {
   bool addWaterLitres(float value);
 
  private:
-  BaseDevice _baseDevice;
+  BasicBaseDevice<MaxSize> _baseDevice;
 };
 
+template <size_t MaxSize>
+const size_t BasicBtHomeV2Device<MaxSize>::MEASUREMENT_CAPACITY;
+
+template <size_t MaxSize>
+void BasicBtHomeV2Device<MaxSize>::clearMeasurementData() {
+  return _baseDevice.resetMeasurement();
+}
+
+/// @brief Builds an outgoing wrapper for the current measurement data.
+/// @param payload
+/// @return
+template <size_t MaxSize>
+size_t BasicBtHomeV2Device<MaxSize>::getAdvertisementData(
+    uint8_t buffer[MaxSize]) {
+  return _baseDevice.getAdvertisementData(buffer);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::hasChanged() const {
+  return _baseDevice.hasChanged();
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::setPacketIdEnabled(bool enabled) {
+  return _baseDevice.setPacketIdEnabled(enabled);
+}
+
+template <size_t MaxSize>
+void BasicBtHomeV2Device<MaxSize>::setPersistentCounter(
+    PersistentCounter* counter) {
+  _baseDevice.setPersistentCounter(counter);
+}
+
+template <size_t MaxSize>
+void BasicBtHomeV2Device<MaxSize>::setCcmBackend(CcmBackend* backend) {
+  _baseDevice.setCcmBackend(backend);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::precomputeEncryption() {
+  return _baseDevice.precomputeEncryption();
+}
+
+template <size_t MaxSize>
+BasicBtHomeV2Device<MaxSize>::BasicBtHomeV2Device(const char* shortName,
+                                                  const char* completeName,
+                                                  bool isTriggerDevice)
+    : _baseDevice(shortName, completeName,
+                  isTriggerDevice)  // Initialize with default device name and
+                                    // trigger-based device flag
+{}
+
+template <size_t MaxSize>
+BasicBtHomeV2Device<MaxSize>::BasicBtHomeV2Device(
+    const char* shortName, const char* completeName, bool isTriggerBased,
+    uint8_t const* const key, const uint8_t macAddress[BLE_MAC_ADDRESS_LENGTH],
+    uint32_t counter)
+    : _baseDevice(shortName, completeName, isTriggerBased, key, macAddress,
+                  counter) {}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addTemperature_neg44_to_44_Resolution_0_35(
+    float degreesCelsius) {
+  return _baseDevice.addFloat(temperature_int8_scale_0_35, degreesCelsius);
+}
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addTemperature_neg127_to_127_Resolution_1(
+    int8_t degreesCelsius) {
+  return _baseDevice.addFloat(temperature_int8, degreesCelsius);
+}
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addTemperature_neg3276_to_3276_Resolution_0_1(
+    float degreesCelsius) {
+  return _baseDevice.addFloat(temperature_int16_scale_0_1, degreesCelsius);
+}
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addTemperature_neg327_to_327_Resolution_0_01(
+    float degreesCelsius) {
+  return _baseDevice.addFloat(temperature_int16_scale_0_01, degreesCelsius);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addTemperatureCentiDegrees(
+    int32_t centiDegreesCelsius) {
+  return _baseDevice.addFixedPoint(temperature_int16_scale_0_01,
+                                   centiDegreesCelsius, 100);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addHumidityCentiPercent(
+    uint32_t centiPercent) {
+  return _baseDevice.addFixedPoint(humidity_uint16, centiPercent, 100);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addPressurePascal(uint32_t pascal) {
+  return _baseDevice.addFixedPoint(pressure, pascal, 100);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addIlluminanceCentiLux(uint32_t centiLux) {
+  return _baseDevice.addFixedPoint(illuminance, centiLux, 100);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addVoltageMillivolts(uint32_t millivolts) {
+  return _baseDevice.addFixedPoint(voltage_0_001, millivolts, 1000);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addDistanceMetres(float metres) {
+  return _baseDevice.addFloat(distance_metre, metres);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addDistanceMillimetres(
+    uint16_t millimetres) {
+  return _baseDevice.addUnsignedInteger(distance_millimetre, millimetres);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addCount_0_4294967295(uint32_t count) {
+  return _baseDevice.addUnsignedInteger(count_uint32, count);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addCount_0_255(uint8_t count) {
+  return _baseDevice.addUnsignedInteger(count_uint8, count);
+}
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addCount_0_65535(uint16_t count) {
+  return _baseDevice.addUnsignedInteger(count_uint16, count);
+}
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addCount_neg128_127(int8_t count) {
+  return _baseDevice.addSignedInteger(count_int8, static_cast<uint64_t>(count));
+}
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addCount_neg32768_32767(int16_t count) {
+  return _baseDevice.addSignedInteger(count_int16,
+                                      static_cast<uint64_t>(count));
+}
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addCount_neg2147483648_2147483647(
+    int32_t count) {
+  return _baseDevice.addSignedInteger(count_int32,
+                                      static_cast<uint64_t>(count));
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addHumidityPercent_Resolution_0_01(
+    float humidityPercent) {
+  return _baseDevice.addFloat(humidity_uint16, humidityPercent);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addHumidityPercent_Resolution_1(
+    uint8_t humidityPercent) {
+  return _baseDevice.addFloat(humidity_uint8, humidityPercent);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addText(const char text[]) {
+  return _baseDevice.addRaw(0x53, (uint8_t*)text, strlen(text));
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addTime(uint32_t secondsSinceEpoch) {
+  return _baseDevice.addUnsignedInteger(timestamp, secondsSinceEpoch);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addRaw(uint8_t* bytes, uint8_t size) {
+  return _baseDevice.addRaw(0x54, bytes, size);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addEncoded(uint8_t objectId,
+                                             const uint8_t* value,
+                                             uint8_t size) {
+  return _baseDevice.addEncoded(objectId, value, size);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::updateEncoded(uint8_t objectId,
+                                                uint8_t occurrence,
+                                                const uint8_t* value,
+                                                uint8_t size) {
+  return _baseDevice.updateEncoded(objectId, occurrence, value, size);
+}
+
+template <size_t MaxSize>
+uint8_t BasicBtHomeV2Device<MaxSize>::getObjectCount() const {
+  return _baseDevice.getEntryCount();
+}
+
+template <size_t MaxSize>
+const BtHomeEncoderStats& BasicBtHomeV2Device<MaxSize>::getStats() const {
+  return _baseDevice.getStats();
+}
+
+template <size_t MaxSize>
+void BasicBtHomeV2Device<MaxSize>::resetStats() {
+  _baseDevice.resetStats();
+}
+
+template <size_t MaxSize>
+uint32_t BasicBtHomeV2Device<MaxSize>::getCounter() const {
+  return _baseDevice.getCounter();
+}
+
+template <size_t MaxSize>
+void BasicBtHomeV2Device<MaxSize>::setCounter(uint32_t counter) {
+  _baseDevice.setCounter(counter);
+}
+
+template <size_t MaxSize>
+uint8_t BasicBtHomeV2Device<MaxSize>::getPacketId() const {
+  return _baseDevice.getPacketId();
+}
+
+template <size_t MaxSize>
+void BasicBtHomeV2Device<MaxSize>::setPacketId(uint8_t packetId) {
+  _baseDevice.setPacketId(packetId);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addBatteryPercentage(
+    uint8_t batteryPercentage) {
+  return _baseDevice.addUnsignedInteger(battery_percentage, batteryPercentage);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::setBatteryState(BATTERY_STATE batteryState) {
+  return _baseDevice.addState(battery_state, batteryState);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::setBatteryChargingState(
+    Battery_Charging_Sensor_Status batteryChargingState) {
+  return _baseDevice.addState(battery_charging, batteryChargingState);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::setCarbonMonoxideState(
+    Carbon_Monoxide_Sensor_Status carbonMonoxideState) {
+  return _baseDevice.addState(carbon_monoxide, carbonMonoxideState);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::setColdState(Cold_Sensor_Status coldState) {
+  return _baseDevice.addState(cold, coldState);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::setConnectivityState(
+    Connectivity_Sensor_Status connectivityState) {
+  return _baseDevice.addState(connectivity, connectivityState);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::setDoorState(Door_Sensor_Status doorState) {
+  return _baseDevice.addState(door, doorState);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::setGarageDoorState(
+    Garage_Door_Sensor_Status garageDoorState) {
+  return _baseDevice.addState(garage_door, garageDoorState);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::setGasState(Gas_Sensor_Status gasState) {
+  return _baseDevice.addState(gas, gasState);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::setGenericState(
+    Generic_Sensor_Status genericState) {
+  return _baseDevice.addState(generic_boolean, genericState);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::setHeatState(Heat_Sensor_Status heatState) {
+  return _baseDevice.addState(heat, heatState);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::setLightState(
+    Light_Sensor_Status lightState) {
+  return _baseDevice.addState(light, lightState);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::setLockState(Lock_Sensor_Status lockState) {
+  return _baseDevice.addState(lock, lockState);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::setMoistureState(
+    Moisture_Sensor_Status moistureState) {
+  return _baseDevice.addState(moisture, moistureState);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::setMotionState(
+    Motion_Sensor_Status motionState) {
+  return _baseDevice.addState(motion, motionState);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::setMovingState(
+    Moving_Sensor_Status movingState) {
+  return _baseDevice.addState(moving, movingState);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::setOccupancyState(
+    Occupancy_Sensor_Status occupancyState) {
+  return _baseDevice.addState(occupancy, occupancyState);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::setOpeningState(
+    Opening_Sensor_Status openingState) {
+  return _baseDevice.addState(opening, openingState);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::setPlugState(Plug_Sensor_Status plugState) {
+  return _baseDevice.addState(plug, plugState);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::setPowerState(
+    Power_Sensor_Status powerState) {
+  return _baseDevice.addState(power, powerState);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::setPresenceState(
+    Presence_Sensor_Status presenceState) {
+  return _baseDevice.addState(presence, presenceState);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::setProblemState(
+    Problem_Sensor_Status problemState) {
+  return _baseDevice.addState(problem, problemState);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::setRunningState(
+    Running_Sensor_Status runningState) {
+  return _baseDevice.addState(running, runningState);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::setSafetyState(
+    Safety_Sensor_Status safetyState) {
+  return _baseDevice.addState(safety, safetyState);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::setSmokeState(
+    Smoke_Sensor_Status smokeState) {
+  return _baseDevice.addState(smoke, smokeState);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::setSoundState(
+    Sound_Sensor_Status soundState) {
+  return _baseDevice.addState(sound, soundState);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::setTamperState(
+    Tamper_Sensor_Status tamperState) {
+  return _baseDevice.addState(tamper, tamperState);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::setVibrationState(
+    Vibration_Sensor_Status vibrationState) {
+  return _baseDevice.addState(vibration, vibrationState);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::setWindowState(
+    Window_Sensor_Status windowState) {
+  return _baseDevice.addState(window, windowState);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::setButtonEvent(
+    Button_Event_Status buttonEvent) {
+  return _baseDevice.addState(button, buttonEvent);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::setDimmerEvent(
+    Dimmer_Event_Status dimmerEvent, uint8_t steps) {
+  return _baseDevice.addState(dimmer, dimmerEvent, steps);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addAccelerationMs2(float value) {
+  return _baseDevice.addFloat(acceleration, value);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addChannel(uint8_t value) {
+  return _baseDevice.addUnsignedInteger(channel, value);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addCo2Ppm(uint16_t value) {
+  return _baseDevice.addUnsignedInteger(co2, value);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addConductivityMicrosecondsPerCm(
+    float value) {
+  return _baseDevice.addFloat(conductivity, value);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addCurrentAmps_neg32_to_32_Resolution_0_001(
+    float value) {
+  return _baseDevice.addFloat(current_int16, value);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addCurrentAmps_0_65_Resolution_0_001(
+    float value) {
+  return _baseDevice.addFloat(current_uint16, value);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addDewPointDegreesCelsius(float value) {
+  return _baseDevice.addFloat(dewpoint, value);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addDirectionDegrees(float value) {
+  return _baseDevice.addFloat(direction, value);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addDurationSeconds(float value) {
+  return _baseDevice.addFloat(duration_uint24, value);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addEnergyKwh_0_to_16777(float value) {
+  return _baseDevice.addFloat(energy_uint24, value);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addEnergyKwh_0_to_4294967(float value) {
+  return _baseDevice.addFloat(energy_uint32, value);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addGasM3_0_to_16777(float value) {
+  return _baseDevice.addFloat(gas_uint24, value);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addGasM3_0_to_4294967(float value) {
+  return _baseDevice.addFloat(gas_uint32, value);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addGyroscopeDegreeSeconds(float value) {
+  return _baseDevice.addFloat(gyroscope, value);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addIlluminanceLux(float value) {
+  return _baseDevice.addFloat(illuminance, value);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addMassKg(float value) {
+  return _baseDevice.addFloat(mass_kg, value);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addMassLb(float value) {
+  return _baseDevice.addFloat(mass_lb, value);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addMoisturePercent_Resolution_1(
+    uint8_t value) {
+  return _baseDevice.addUnsignedInteger(moisture_uint8, value);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addMoisturePercent_Resolution_0_01(
+    float value) {
+  return _baseDevice.addFloat(moisture_uint16, value);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addPm2_5UgM3(uint16_t value) {
+  return _baseDevice.addUnsignedInteger(pm2_5, value);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addPm10UgM3(uint16_t value) {
+  return _baseDevice.addUnsignedInteger(pm10, value);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addPower_neg21474836_to_21474836_resolution_0_01(
+    float value) {
+  return _baseDevice.addFloat(power_int32, value);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addPower_0_to_167772_resolution_0_01(
+    float value) {
+  return _baseDevice.addFloat(power_uint24, value);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addPrecipitationMm(float value) {
+  return _baseDevice.addFloat(precipitation, value);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addPressureHpa(float value) {
+  return _baseDevice.addFloat(pressure, value);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addRotationDegrees(float value) {
+  return _baseDevice.addFloat(rotation, value);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addSpeedMs(float value) {
+  return _baseDevice.addFloat(speed, value);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addTvocUgm3(uint16_t value) {
+  return _baseDevice.addUnsignedInteger(tvoc, value);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addVoltage_0_to_6550_resolution_0_1(
+    float value) {
+  return _baseDevice.addFloat(voltage_0_1, value);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addVoltage_0_to_65_resolution_0_001(
+    float value) {
+  return _baseDevice.addFloat(voltage_0_001, value);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addVolumeLitres_0_to_6555_resolution_0_1(
+    float value) {
+  return _baseDevice.addFloat(volume_uint16_scale_0_1, value);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addVolumeLitres_0_to_65550_resolution_1(
+    uint16_t value) {
+  return _baseDevice.addUnsignedInteger(volume_uint16_scale_1, value);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addVolumeLitres_0_to_4294967_resolution_0_001(
+    float value) {
+  return _baseDevice.addFloat(volume_uint32, value);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addVolumeStorageLitres(float value) {
+  return _baseDevice.addFloat(volume_storage, value);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addVolumeFlowRateM3hr(float value) {
+  return _baseDevice.addFloat(volume_flow_rate, value);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addUvIndex(float value) {
+  return _baseDevice.addFloat(UV_index, value);
+}
+
+template <size_t MaxSize>
+bool BasicBtHomeV2Device<MaxSize>::addWaterLitres(float value) {
+  return _baseDevice.addFloat(water_litre, value);
+}
+
+// Legacy and extended devices are compiled once, in BtHomeV2Device.cpp
+extern template class BasicBtHomeV2Device<MAX_ADVERTISEMENT_SIZE>;
+extern template class BasicBtHomeV2Device<MAX_EXTENDED_ADVERTISEMENT_SIZE>;
+
+/// Device for legacy advertisements (31 bytes).
+typedef BasicBtHomeV2Device<MAX_ADVERTISEMENT_SIZE> BtHomeV2Device;
+/// Device for BLE 5 extended advertisements (255 bytes).
+typedef BasicBtHomeV2Device<MAX_EXTENDED_ADVERTISEMENT_SIZE>
+    ExtendedBtHomeV2Device;
+
 #endif  // BT_HOME_H
@@ -0,0 +1,134 @@
+/**
+ * @file CcmBackend.h
+ * @brief AES-128-CCM backends for encrypted BTHome advertisements.
+ *
+ * BTHome encrypts with AES-128-CCM using a 13 byte nonce, a 4 byte MIC and
+ * no additional authenticated data. BaseDevice uses mbedtls where the core
+ * ships it (ESP32, ESP8266) and the portable SoftwareCcm everywhere else, so
+ * encryption also works on nRF52. A different backend (for example a
+ * hardware AES peripheral) can be plugged in with setCcmBackend().
+ *
+ * Everything except the CBC-MAC over the plaintext depends only on the key,
+ * nonce and message length. precompute() does that work ahead of time, so
+ * encryptPrecomputed() costs one AES block per 16 plaintext bytes plus XORs.
+ */
+
+#ifndef CCM_BACKEND_H
+#define CCM_BACKEND_H
+
+#include <Arduino.h>
+
+#if defined(ESP32) || defined(ESP8266)
+#include "mbedtls/aes.h"
+#include "mbedtls/ccm.h"
+#define BTHOME_HAS_MBEDTLS 1
+#else
+#define BTHOME_HAS_MBEDTLS 0
+#endif
+
+static const size_t CCM_KEY_LENGTH = 16;
+static const size_t CCM_NONCE_LENGTH = 13;
+static const size_t CCM_TAG_LENGTH = 4;
+static const size_t AES_BLOCK_SIZE = 16;
+
+/// @brief AES-128-CCM as used by BTHome (13 byte nonce, 4 byte tag, no
+/// additional data).
+class CcmBackend {
+ public:
+  virtual ~CcmBackend() {}
+
+  /// @brief Set the 128 bit bind key.
+  /// @return false if the key could not be loaded
+  virtual bool setKey(const uint8_t key[CCM_KEY_LENGTH]) = 0;
+
+  /// @brief Encrypt and authenticate length bytes.
+  /// @param ciphertext Receives length bytes; may alias plaintext
+  /// @param tag Receives the MIC
+  /// @return false if encryption failed
+  virtual bool encrypt(const uint8_t nonce[CCM_NONCE_LENGTH],
+                       const uint8_t* plaintext, size_t length,
+                       uint8_t* ciphertext, uint8_t tag[CCM_TAG_LENGTH]) = 0;
+
+  /// @brief Encrypt a single block with the key (AES-128-ECB).
+  /// @param output May alias input
+  /// @return false if the backend has no block access, which also disables
+  /// precompute()
+  virtual bool encryptBlock(const uint8_t input[AES_BLOCK_SIZE],
+                            uint8_t output[AES_BLOCK_SIZE]) {
+    (void)input;
+    (void)output;
+    return false;
+  }
+
+  /// @brief Compute the plaintext independent part of encrypt(): the first
+  /// CBC-MAC block and the CTR keystream.
+  /// @param state Receives the CBC-MAC state after B0
+  /// @param keystream Receives CCM_TAG_LENGTH + length bytes
+  /// @return false if length is too long or encryptBlock() fails
+  bool precompute(const uint8_t nonce[CCM_NONCE_LENGTH], size_t length,
+                  uint8_t state[AES_BLOCK_SIZE], uint8_t* keystream);
+
+  /// @brief Finish a message prepared with precompute() for the same length.
+  /// @param ciphertext Receives length bytes; may alias plaintext
+  /// @param tag Receives the MIC
+  /// @return false if encryptBlock() fails
+  bool encryptPrecomputed(const uint8_t state[AES_BLOCK_SIZE],
+                          const uint8_t* keystream, const uint8_t* plaintext,
+                          size_t length, uint8_t* ciphertext,
+                          uint8_t tag[CCM_TAG_LENGTH]);
+};
+
+/// @brief Portable table-driven AES-128-CCM without platform dependencies.
+class SoftwareCcm : public CcmBackend {
+ public:
+  bool setKey(const uint8_t key[CCM_KEY_LENGTH]) override;
+  bool encrypt(const uint8_t nonce[CCM_NONCE_LENGTH], const uint8_t* plaintext,
+               size_t length, uint8_t* ciphertext,
+               uint8_t tag[CCM_TAG_LENGTH]) override;
+  bool encryptBlock(const uint8_t input[AES_BLOCK_SIZE],
+                    uint8_t output[AES_BLOCK_SIZE]) override;
+
+ private:
+  void cipher(const uint8_t input[AES_BLOCK_SIZE],
+              uint8_t output[AES_BLOCK_SIZE]) const;
+
+  // 11 round keys of four big-endian words each.
+  uint32_t _roundKeys[44] = {0};
+};
+
+#if BTHOME_HAS_MBEDTLS
+
+/// @brief AES-128-CCM from the mbedtls library of the core.
+class MbedTlsCcm : public CcmBackend {
+ public:
+  MbedTlsCcm();
+  // The mbedtls contexts own heap memory, so copies load the key again.
+  MbedTlsCcm(const MbedTlsCcm& other);
+  MbedTlsCcm& operator=(const MbedTlsCcm& other);
+  ~MbedTlsCcm() override;
+
+  bool setKey(const uint8_t key[CCM_KEY_LENGTH]) override;
+  bool encrypt(const uint8_t nonce[CCM_NONCE_LENGTH], const uint8_t* plaintext,
+               size_t length, uint8_t* ciphertext,
+               uint8_t tag[CCM_TAG_LENGTH]) override;
+  bool encryptBlock(const uint8_t input[AES_BLOCK_SIZE],
+                    uint8_t output[AES_BLOCK_SIZE]) override;
+
+ private:
+  mbedtls_ccm_context _context;
+  mbedtls_aes_context _aes;
+  uint8_t _key[CCM_KEY_LENGTH];
+  bool _hasKey = false;
+};
+
+/// Backend BaseDevice uses unless another one is set.
+typedef MbedTlsCcm DefaultCcm;
+
+#else
+
+/// Backend BaseDevice uses unless another one is set.
+typedef SoftwareCcm DefaultCcm;
+
+#endif
+
+#endif  // CCM_BACKEND_H
@@ -0,0 +1,109 @@
+/**
+ * @file CounterStorage.cpp
+ * @brief Block reservation of the persistent encryption counter and the host
+ * file storage
+ */
+
+#include "CounterStorage.h"
+
+#if defined(BTHOME_HOST)
+#include <stdio.h>
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+#endif
+
+const uint32_t PersistentCounter::DEFAULT_BLOCK_SIZE;
+
+PersistentCounter::PersistentCounter(CounterStorage& storage,
+                                     uint32_t blockSize)
+    : _storage(storage), _blockSize(blockSize > 0 ? blockSize : 1) {}
+
+bool PersistentCounter::begin(uint32_t initial) {
+  uint32_t stored = 0;
+  _next = _storage.load(stored) ? stored : initial;
+  _limit = _next;
+  _ready = reserve();
+  return _ready;
+}
+
+bool PersistentCounter::resume(uint32_t next, uint32_t limit) {
+  if (next > limit) {
+    return false;
+  }
+  _next = next;
+  _limit = limit;
+  _ready = true;
+  return true;
+}
+
+bool PersistentCounter::next(uint32_t& counter) {
+  if (!_ready || (_next == _limit && !reserve())) {
+    return false;
+  }
+  counter = _next++;
+  return true;
+}
+
+/// @brief Stores the end of the next block before any of its counters is
+/// handed out.
+bool PersistentCounter::reserve() {
+  uint32_t remaining = UINT32_MAX - _limit;
+  if (remaining == 0) {
+    return false;
+  }
+  uint32_t limit = _limit + (remaining < _blockSize ? remaining : _blockSize);
+  if (!_storage.store(limit)) {
+    return false;
+  }
+  _limit = limit;
+  return true;
+}
+
+#if defined(BTHOME_HOST)
+
+FileCounterStorage::FileCounterStorage(const char* path) : _path(path) {}
+
+bool FileCounterStorage::load(uint32_t& value) {
+  FILE* file = fopen(_path, "rb");
+  if (!file) {
+    return false;
+  }
+  uint8_t bytes[4];
+  bool complete = fread(bytes, 1, sizeof(bytes), file) == sizeof(bytes);
+  fclose(file);
+  if (complete) {
+    value = (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) |
+            ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+  }
+  return complete;
+}
+
+bool FileCounterStorage::store(uint32_t value) {
+  // Write a temporary file and rename it over the old one: a crash leaves
+  // either the old or the new counter, never a truncated file
+  char temporary[FILENAME_MAX];
+  int length = snprintf(temporary, sizeof(temporary), "%s.tmp", _path);
+  if (length < 0 || (size_t)length >= sizeof(temporary)) {
+    return false;
+  }
+  FILE* file = fopen(temporary, "wb");
+  if (!file) {
+    return false;
+  }
+  uint8_t bytes[4] = {(uint8_t)value, (uint8_t)(value >> 8),
+                      (uint8_t)(value >> 16), (uint8_t)(value >> 24)};
+  bool complete = fwrite(bytes, 1, sizeof(bytes), file) == sizeof(bytes) &&
+                  fflush(file) == 0;
+#if !defined(_WIN32)
+  complete = complete && fsync(fileno(file)) == 0;
+#endif
+  complete = fclose(file) == 0 && complete;
+  if (!complete || rename(temporary, _path) != 0) {
+    remove(temporary);
+    return false;
+  }
+  return true;
+}
+
+#endif  // BTHOME_HOST
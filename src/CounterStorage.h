@@ -0,0 +1,152 @@
+/**
+ * @file CounterStorage.h
+ * @brief Persistent encryption counter for BTHome devices.
+ *
+ * Receivers reject encrypted packets whose counter is not larger than the
+ * last one they accepted, so the counter has to survive reboots and deep
+ * sleep. PersistentCounter reserves counters in blocks and only writes the
+ * end of the current block to storage, which costs one flash write per block
+ * instead of one per packet. After a reset counting resumes at the end of the
+ * last reserved block, skipping the unused rest of it.
+ *
+ * @code
+ * NvsCounterStorage storage;
+ * PersistentCounter counter(storage);
+ * counter.begin();
+ * device.setPersistentCounter(&counter);
+ * @endcode
+ */
+
+#ifndef COUNTER_STORAGE_H
+#define COUNTER_STORAGE_H
+
+#include <Arduino.h>
+
+/// @brief Non-volatile storage for a single counter value.
+class CounterStorage {
+ public:
+  virtual ~CounterStorage() {}
+
+  /// @brief Read the stored value.
+  /// @return false if nothing was stored yet or reading failed
+  virtual bool load(uint32_t& value) = 0;
+
+  /// @brief Replace the stored value.
+  /// @return false if writing failed
+  virtual bool store(uint32_t value) = 0;
+};
+
+/// @brief Volatile stand-in for tests and simulations.
+class RamCounterStorage : public CounterStorage {
+ public:
+  bool load(uint32_t& value) override {
+    value = _value;
+    return _stored;
+  }
+
+  bool store(uint32_t value) override {
+    _value = value;
+    _stored = true;
+    _writes++;
+    return true;
+  }
+
+  /// @brief Number of store() calls so far.
+  uint32_t getWriteCount() const { return _writes; }
+
+ private:
+  uint32_t _value = 0;
+  uint32_t _writes = 0;
+  bool _stored = false;
+};
+
+/// @brief Monotonic counter that reserves blocks of values in a
+/// CounterStorage.
+class PersistentCounter {
+ public:
+  static const uint32_t DEFAULT_BLOCK_SIZE = 1024;
+
+  /// @param storage Keeps the end of the reserved block
+  /// @param blockSize Counters reserved per storage write
+  explicit PersistentCounter(CounterStorage& storage,
+                             uint32_t blockSize = DEFAULT_BLOCK_SIZE);
+
+  /// @brief Resume after the last reserved block and reserve the next one.
+  /// @param initial First counter if the storage holds no value yet
+  /// @return false if the reservation could not be stored
+  bool begin(uint32_t initial = 1);
+
+  /// @brief Continue inside a block reserved before, e.g. after deep sleep
+  /// with next and limit kept in RTC memory, without touching the storage.
+  /// @return false if next lies outside the block
+  bool resume(uint32_t next, uint32_t limit);
+
+  /// @brief Hand out the next counter, reserving a new block when the current
+  /// one is used up.
+  /// @param counter Receives the counter value
+  /// @return false if storage failed or the 32 bit counter is exhausted
+  bool next(uint32_t& counter);
+
+  /// @brief Counter next() hands out next.
+  uint32_t getNext() const { return _next; }
+
+  /// @brief End of the reserved block, as stored.
+  uint32_t getLimit() const { return _limit; }
+
+ private:
+  bool reserve();
+
+  CounterStorage& _storage;
+  uint32_t _blockSize;
+  uint32_t _next = 0;
+  uint32_t _limit = 0;
+  bool _ready = false;
+};
+
+#if defined(ESP32)
+
+/// @brief Counter storage in the ESP32 NVS partition (Preferences library).
+class NvsCounterStorage : public CounterStorage {
+ public:
+  /// @param nvsNamespace NVS namespace, max 15 characters
+  explicit NvsCounterStorage(const char* nvsNamespace = "bthome");
+  bool load(uint32_t& value) override;
+  bool store(uint32_t value) override;
+
+ private:
+  const char* _namespace;
+};
+
+#elif defined(NRF52) || defined(NRF52840_XXAA) || \
+    defined(ARDUINO_NRF52_ADAFRUIT)
+
+/// @brief Counter storage in a file on the nRF52 internal LittleFS.
+class LittleFsCounterStorage : public CounterStorage {
+ public:
+  explicit LittleFsCounterStorage(const char* path = "/bthome_counter");
+  bool load(uint32_t& value) override;
+  bool store(uint32_t value) override;
+
+ private:
+  const char* _path;
+};
+
+#elif defined(BTHOME_HOST)
+
+/// @brief Counter storage in a file, for host simulations.
+///
+/// store() writes `<path>.tmp` and renames it over the file, so a crash
+/// keeps the previous counter instead of leaving an empty file.
+class FileCounterStorage : public CounterStorage {
+ public:
+  explicit FileCounterStorage(const char* path);
+  bool load(uint32_t& value) override;
+  bool store(uint32_t value) override;
+
+ private:
+  const char* _path;
+};
+
+#endif
+
+#endif  // COUNTER_STORAGE_H
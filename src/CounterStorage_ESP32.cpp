@@ -0,0 +1,41 @@
+/**
+ * @file CounterStorage_ESP32.cpp
+ * @brief ESP32 NVS storage for the persistent encryption counter
+ */
+
+#if defined(ESP32)
+
+#include <Preferences.h>
+
+#include "CounterStorage.h"
+
+static const char* COUNTER_KEY = "counter";
+
+NvsCounterStorage::NvsCounterStorage(const char* nvsNamespace)
+    : _namespace(nvsNamespace) {}
+
+bool NvsCounterStorage::load(uint32_t& value) {
+  Preferences preferences;
+  // Read-only begin() fails while the namespace does not exist yet
+  if (!preferences.begin(_namespace, true)) {
+    return false;
+  }
+  bool found = preferences.isKey(COUNTER_KEY);
+  if (found) {
+    value = preferences.getUInt(COUNTER_KEY);
+  }
+  preferences.end();
+  return found;
+}
+
+bool NvsCounterStorage::store(uint32_t value) {
+  Preferences preferences;
+  if (!preferences.begin(_namespace, false)) {
+    return false;
+  }
+  size_t written = preferences.putUInt(COUNTER_KEY, value);
+  preferences.end();
+  return written == sizeof(value);
+}
+
+#endif  // ESP32
@@ -0,0 +1,45 @@
+/**
+ * @file CounterStorage_nRF52.cpp
+ * @brief nRF52 LittleFS storage for the persistent encryption counter
+ */
+
+#if defined(NRF52) || defined(NRF52840_XXAA) || defined(ARDUINO_NRF52_ADAFRUIT)
+
+#include <InternalFileSystem.h>
+
+#include "CounterStorage.h"
+
+using namespace Adafruit_LittleFS_Namespace;
+
+LittleFsCounterStorage::LittleFsCounterStorage(const char* path)
+    : _path(path) {}
+
+bool LittleFsCounterStorage::load(uint32_t& value) {
+  if (!InternalFS.begin()) {
+    return false;
+  }
+  File file = InternalFS.open(_path, FILE_O_READ);
+  if (!file) {
+    return false;
+  }
+  bool complete = file.read(&value, sizeof(value)) == sizeof(value);
+  file.close();
+  return complete;
+}
+
+bool LittleFsCounterStorage::store(uint32_t value) {
+  if (!InternalFS.begin()) {
+    return false;
+  }
+  // FILE_O_WRITE opens at the end; overwrite the value in place
+  File file = InternalFS.open(_path, FILE_O_WRITE);
+  if (!file) {
+    return false;
+  }
+  file.seek(0);
+  size_t written = file.write((const uint8_t*)&value, sizeof(value));
+  file.close();
+  return written == sizeof(value);
+}
+
+#endif  // NRF52
@@ -23,117 +23,135 @@ struct BtHomeState {
   uint8_t byteCount;
 };
 
+// Exact resolution of a value as numerator / denominator (0.01 is {1, 100}),
+// so values can be scaled with integer arithmetic only.
+struct BtHomeScale {
+  uint16_t numerator;
+  uint16_t denominator;
+};
+
 struct BtHomeType : public BtHomeState {
   float scale;        // Multiplier to apply before serializing
   bool signed_value;  // true if value is signed, false if unsigned
+  // Exact form of scale; numerator is 0 for types built from a float scale.
+  BtHomeScale exactScale;
+
+  constexpr BtHomeType(uint8_t id, float scale, uint8_t byteCount,
+                       bool signed_value)
+      : BtHomeState{id, byteCount},
+        scale(scale),
+        signed_value(signed_value),
+        exactScale{0, 0} {}
 
-  BtHomeType(uint8_t id, float scale, uint8_t byteCount, bool signed_value) {
-    this->id = id;
-    this->scale = scale;
-    this->byteCount = byteCount;
-    this->signed_value = signed_value;
-  }
+  constexpr BtHomeType(uint8_t id, BtHomeScale scale, uint8_t byteCount,
+                       bool signed_value)
+      : BtHomeState{id, byteCount},
+        scale(static_cast<float>(scale.numerator) / scale.denominator),
+        signed_value(signed_value),
+        exactScale(scale) {}
 };
 
 // Now BtHomeType has 'id' from BtHomeState, plus its own fields.
 
-const BtHomeType temperature_int8 = {0x57, 1.0f, 1, true};
-const BtHomeType temperature_int8_scale_0_35 = {0x58, 0.35f, 1, true};
-const BtHomeType temperature_int16_scale_0_1 = {0x45, 0.1f, 2, true};
-const BtHomeType temperature_int16_scale_0_01 = {0x02, 0.01f, 2, true};
-
-const BtHomeType count_uint8 = {0x09, 1.0f, 1, false};
-const BtHomeType count_uint16 = {0x3D, 1.0f, 2, false};
-const BtHomeType count_uint32 = {0x3E, 1.0f, 4, true};
-const BtHomeType count_int8 = {0x59, 1.0f, 1, true};
-const BtHomeType count_int16 = {0x5A, 1.0f, 2, true};
-const BtHomeType count_int32 = {0x5B, 1.0f, 4, true};
-
-const BtHomeType voltage_0_001 = {0x0C, 0.001f, 2, false};
-const BtHomeType voltage_0_1 = {0x4A, 0.1f, 2, false};
-
-const BtHomeType battery_percentage = {0x01, 1.0f, 1, false};
-
-const BtHomeType distance_millimetre = {0x40, 1.0f, 2, false};
-const BtHomeType distance_metre = {0x41, 0.1f, 2, false};
-
-const BtHomeType acceleration = {0x51, 0.001f, 2, false};
-const BtHomeType channel = {0x60, 1.0f, 1, false};
-const BtHomeType co2 = {0x12, 1.0f, 2, false};
-const BtHomeType conductivity = {0x56, 1.0f, 2, false};
-
-const BtHomeType current_uint16 = {0x43, 0.001f, 2, false};
-const BtHomeType current_int16 = {0x5D, 0.001f, 2, true};
-const BtHomeType dewpoint = {0x08, 0.01f, 2, true};
-const BtHomeType direction = {0x5E, 0.01f, 2, false};
-const BtHomeType duration_uint24 = {0x42, 0.001f, 3, false};
-const BtHomeType energy_uint32 = {0x4D, 0.001f, 4, true};
-const BtHomeType energy_uint24 = {0x0A, 0.001f, 3, false};
-const BtHomeType gas_uint24 = {0x4B, 0.001f, 3, false};
-const BtHomeType gas_uint32 = {0x4C, 0.001f, 4, true};
-const BtHomeType gyroscope = {0x52, 0.001f, 2, false};
-const BtHomeType humidity_uint16 = {0x03, 0.01f, 2, false};
-const BtHomeType humidity_uint8 = {0x2E, 1.0f, 1, false};
-const BtHomeType illuminance = {0x05, 0.01f, 3, false};
-const BtHomeType mass_kg = {0x06, 0.01f, 2, false};
-const BtHomeType mass_lb = {0x07, 0.01f, 2, false};
-const BtHomeType moisture_uint16 = {0x14, 0.01f, 2, false};
-const BtHomeType moisture_uint8 = {0x2F, 1.0f, 1, false};
-const BtHomeType pm2_5 = {0x0D, 1.0f, 2, false};
-const BtHomeType pm10 = {0x0E, 1.0f, 2, false};
-const BtHomeType power_uint24 = {0x0B, 0.01f, 3, false};
-const BtHomeType power_int32 = {0x5C, 0.01f, 4, true};
+constexpr BtHomeType temperature_int8 = {0x57, {1, 1}, 1, true};
+constexpr BtHomeType temperature_int8_scale_0_35 = {0x58, {7, 20}, 1, true};
+constexpr BtHomeType temperature_int16_scale_0_1 = {0x45, {1, 10}, 2, true};
+constexpr BtHomeType temperature_int16_scale_0_01 = {0x02, {1, 100}, 2, true};
+
+constexpr BtHomeType count_uint8 = {0x09, {1, 1}, 1, false};
+constexpr BtHomeType count_uint16 = {0x3D, {1, 1}, 2, false};
+constexpr BtHomeType count_uint32 = {0x3E, {1, 1}, 4, false};
+constexpr BtHomeType count_int8 = {0x59, {1, 1}, 1, true};
+constexpr BtHomeType count_int16 = {0x5A, {1, 1}, 2, true};
+constexpr BtHomeType count_int32 = {0x5B, {1, 1}, 4, true};
+
+constexpr BtHomeType voltage_0_001 = {0x0C, {1, 1000}, 2, false};
+constexpr BtHomeType voltage_0_1 = {0x4A, {1, 10}, 2, false};
+
+constexpr BtHomeType packet_id = {0x00, {1, 1}, 1, false};
+
+constexpr BtHomeType battery_percentage = {0x01, {1, 1}, 1, false};
+
+constexpr BtHomeType distance_millimetre = {0x40, {1, 1}, 2, false};
+constexpr BtHomeType distance_metre = {0x41, {1, 10}, 2, false};
+
+constexpr BtHomeType acceleration = {0x51, {1, 1000}, 2, false};
+constexpr BtHomeType channel = {0x60, {1, 1}, 1, false};
+constexpr BtHomeType co2 = {0x12, {1, 1}, 2, false};
+constexpr BtHomeType conductivity = {0x56, {1, 1}, 2, false};
+
+constexpr BtHomeType current_uint16 = {0x43, {1, 1000}, 2, false};
+constexpr BtHomeType current_int16 = {0x5D, {1, 1000}, 2, true};
+constexpr BtHomeType dewpoint = {0x08, {1, 100}, 2, true};
+constexpr BtHomeType direction = {0x5E, {1, 100}, 2, false};
+constexpr BtHomeType duration_uint24 = {0x42, {1, 1000}, 3, false};
+constexpr BtHomeType energy_uint32 = {0x4D, {1, 1000}, 4, false};
+constexpr BtHomeType energy_uint24 = {0x0A, {1, 1000}, 3, false};
+constexpr BtHomeType gas_uint24 = {0x4B, {1, 1000}, 3, false};
+constexpr BtHomeType gas_uint32 = {0x4C, {1, 1000}, 4, false};
+constexpr BtHomeType gyroscope = {0x52, {1, 1000}, 2, false};
+constexpr BtHomeType humidity_uint16 = {0x03, {1, 100}, 2, false};
+constexpr BtHomeType humidity_uint8 = {0x2E, {1, 1}, 1, false};
+constexpr BtHomeType illuminance = {0x05, {1, 100}, 3, false};
+constexpr BtHomeType mass_kg = {0x06, {1, 100}, 2, false};
+constexpr BtHomeType mass_lb = {0x07, {1, 100}, 2, false};
+constexpr BtHomeType moisture_uint16 = {0x14, {1, 100}, 2, false};
+constexpr BtHomeType moisture_uint8 = {0x2F, {1, 1}, 1, false};
+constexpr BtHomeType pm2_5 = {0x0D, {1, 1}, 2, false};
+constexpr BtHomeType pm10 = {0x0E, {1, 1}, 2, false};
+constexpr BtHomeType power_uint24 = {0x0B, {1, 100}, 3, false};
+constexpr BtHomeType power_int32 = {0x5C, {1, 100}, 4, true};
 ;
-const BtHomeType precipitation = {0x5F, 0.1f, 2, false};
-const BtHomeType pressure = {0x04, 0.01f, 3, false};
-const BtHomeType rotation = {0x3F, 0.1f, 2, true};
-const BtHomeType speed = {0x44, 0.01f, 2, false};
-const BtHomeType timestamp = {0x50, 1.0f, 4, false};
-const BtHomeType tvoc = {0x13, 1.0f, 2, false};
-
-const BtHomeType volume_uint32 = {0x4E, 0.001f, 4, true};
-const BtHomeType volume_uint16_scale_0_1 = {0x47, 0.1f, 2, false};
-const BtHomeType volume_uint16_scale_1 = {0x48, 1.0f, 2, false};
-const BtHomeType volume_storage = {0x55, 0.001f, 4, true};
-const BtHomeType volume_flow_rate = {0x49, 0.001f, 2, false};
-const BtHomeType UV_index = {0x46, 0.1f, 1, false};
-const BtHomeType water_litre = {0x4F, 0.001f, 4, true};
-const BtHomeType time_type = {0x50, 1.0f, 4, false};
+constexpr BtHomeType precipitation = {0x5F, {1, 10}, 2, false};
+constexpr BtHomeType pressure = {0x04, {1, 100}, 3, false};
+constexpr BtHomeType rotation = {0x3F, {1, 10}, 2, true};
+constexpr BtHomeType speed = {0x44, {1, 100}, 2, false};
+constexpr BtHomeType timestamp = {0x50, {1, 1}, 4, false};
+constexpr BtHomeType tvoc = {0x13, {1, 1}, 2, false};
+
+constexpr BtHomeType volume_uint32 = {0x4E, {1, 1000}, 4, false};
+constexpr BtHomeType volume_uint16_scale_0_1 = {0x47, {1, 10}, 2, false};
+constexpr BtHomeType volume_uint16_scale_1 = {0x48, {1, 1}, 2, false};
+constexpr BtHomeType volume_storage = {0x55, {1, 1000}, 4, false};
+constexpr BtHomeType volume_flow_rate = {0x49, {1, 1000}, 2, false};
+constexpr BtHomeType UV_index = {0x46, {1, 10}, 1, false};
+constexpr BtHomeType water_litre = {0x4F, {1, 1000}, 4, false};
+constexpr BtHomeType time_type = {0x50, {1, 1}, 4, false};
 
 // raw (0x54)  require custom serialization
 
-const BtHomeState battery_state = {
+constexpr BtHomeState battery_state = {
     0x15, 1};  // Battery state, 1 byte, 0 = normal, 1 = low
-const BtHomeState battery_charging = {0x16, 1};
-const BtHomeState carbon_monoxide = {0x17, 1};
-const BtHomeState cold = {0x18, 1};
-const BtHomeState connectivity = {0x19, 1};
-const BtHomeState door = {0x1A, 1};
-const BtHomeState garage_door = {0x1B, 1};
-const BtHomeState gas = {0x1C, 1};
-const BtHomeState generic_boolean = {0x0F, 1};
-const BtHomeState heat = {0x1D, 1};
-const BtHomeState light = {0x1E, 1};
-const BtHomeState lock = {0x1F, 1};
-const BtHomeState moisture = {0x20, 1};
-const BtHomeState motion = {0x21, 1};
-const BtHomeState moving = {0x22, 1};
-const BtHomeState occupancy = {0x23, 1};
-const BtHomeState opening = {0x11, 1};
-const BtHomeState plug = {0x24, 1};
-const BtHomeState power = {0x10, 1};
-const BtHomeState presence = {0x25, 1};
-const BtHomeState problem = {0x26, 1};
-const BtHomeState running = {0x27, 1};
-const BtHomeState safety = {0x28, 1};
-const BtHomeState smoke = {0x29, 1};
-const BtHomeState sound = {0x2A, 1};
-const BtHomeState tamper = {0x2B, 1};
-const BtHomeState vibration = {0x2C, 1};
-const BtHomeState window = {0x2D, 1};
-
-const BtHomeState button = {0x3A, 1};
-const BtHomeState dimmer = {0x3C, 2};  // Dimmer = state + steps
+constexpr BtHomeState battery_charging = {0x16, 1};
+constexpr BtHomeState carbon_monoxide = {0x17, 1};
+constexpr BtHomeState cold = {0x18, 1};
+constexpr BtHomeState connectivity = {0x19, 1};
+constexpr BtHomeState door = {0x1A, 1};
+constexpr BtHomeState garage_door = {0x1B, 1};
+constexpr BtHomeState gas = {0x1C, 1};
+constexpr BtHomeState generic_boolean = {0x0F, 1};
+constexpr BtHomeState heat = {0x1D, 1};
+constexpr BtHomeState light = {0x1E, 1};
+constexpr BtHomeState lock = {0x1F, 1};
+constexpr BtHomeState moisture = {0x20, 1};
+constexpr BtHomeState motion = {0x21, 1};
+constexpr BtHomeState moving = {0x22, 1};
+constexpr BtHomeState occupancy = {0x23, 1};
+constexpr BtHomeState opening = {0x11, 1};
+constexpr BtHomeState plug = {0x24, 1};
+constexpr BtHomeState power = {0x10, 1};
+constexpr BtHomeState presence = {0x25, 1};
+constexpr BtHomeState problem = {0x26, 1};
+constexpr BtHomeState running = {0x27, 1};
+constexpr BtHomeState safety = {0x28, 1};
+constexpr BtHomeState smoke = {0x29, 1};
+constexpr BtHomeState sound = {0x2A, 1};
+constexpr BtHomeState tamper = {0x2B, 1};
+constexpr BtHomeState vibration = {0x2C, 1};
+constexpr BtHomeState window = {0x2D, 1};
+
+constexpr BtHomeState button = {0x3A, 1};
+constexpr BtHomeState dimmer = {0x3C, 2};  // Dimmer = state + steps
 
 enum Button_Event_Status {
   Button_Event_Status_None = 0x00,
@@ -28,6 +28,12 @@ DEVICE_NAME_FILTER = "MAKE"
 # Global variable for verbose mode
 VERBOSE = False
 
+# Global variable: also print repeated packets (same BThome packet id)
+SHOW_DUPLICATES = False
+
+# Last BThome packet id (object 0x00) seen per device address
+LAST_PACKET_IDS: dict[str, int] = {}
+
 
 def get_version() -> str:
     """Get the package version"""
@@ -352,6 +358,37 @@ def parse_bthome_packet(data: bytes) -> dict:
     return result
 
 
+def is_duplicate_packet(address: str, parsed: Optional[dict]) -> bool:
+    """
+    Checks whether a packet repeats the last packet of the same device
+
+    Devices that send a packet id (object 0x00) change it only when their
+    measurements change, so an unchanged id carries no new values. Packets
+    without packet id are never treated as duplicates.
+
+    Args:
+        address: Device address
+        parsed: Result of parse_bthome_packet()
+
+    Returns:
+        True if the packet should be dropped
+    """
+    if SHOW_DUPLICATES or not parsed:
+        return False
+
+    packet_id = next(
+        (v["raw_value"] for v in parsed["values"] if v["object_id"] == 0x00),
+        None,
+    )
+    if packet_id is None:
+        return False
+
+    if LAST_PACKET_IDS.get(address) == packet_id:
+        return True
+    LAST_PACKET_IDS[address] = packet_id
+    return False
+
+
 def format_timestamp() -> str:
     """Formats the current timestamp"""
     return datetime.now().strftime("%H:%M:%S.%f")[:-3]
@@ -461,6 +498,11 @@ def _advertisement_callback_inner(
     if raw_data is None:
         return
 
+    # Parse BThome packet; repeated packets carry no new values
+    parsed = parse_bthome_packet(raw_data)
+    if is_duplicate_packet(device.address, parsed):
+        return
+
     # Reconstruct full AD value including UUID/company-ID prefix (like nRF Connect shows)
     if data_source == "service_data":
         prefix_bytes = bytes(
@@ -514,9 +556,6 @@ def _advertisement_callback_inner(
         f"  {Colors.GRAY}({hex_data}){Colors.RESET}"
     )
 
-    # Parse BThome packet
-    parsed = parse_bthome_packet(raw_data)
-
     if parsed:
         # Device Info
         encrypted_str = (
@@ -793,6 +832,16 @@ def _print_raw_adv_report(report: dict) -> None:
     ):
         return
 
+    # Repeated BThome packets carry no new values
+    for _, ad_type, value in ad_structs:
+        if ad_type != 0x16 or len(value) < 3:
+            continue
+        if value[0] | (value[1] << 8) != BTHOME_COMPANY_ID:
+            continue
+        if is_duplicate_packet(report["address"], parse_bthome_packet(value[2:])):
+            return
+        break
+
     rssi = report["rssi"]
     rssi_color = (
         Colors.GREEN if rssi > -70 else (Colors.YELLOW if rssi > -85 else Colors.RED)
@@ -1131,6 +1180,12 @@ def main(
         "-a",
         help="HCI adapter index to use in raw mode (default: 0 → hci0)",
     ),
+    show_duplicates: bool = typer.Option(
+        False,
+        "--show-duplicates",
+        "-d",
+        help="Also show repeated packets of a device (same BThome packet id)",
+    ),
     list_hci: bool = typer.Option(
         False,
         "--list-hci",
@@ -1178,9 +1233,10 @@ def main(
         list_hci_adapters()
         return
 
-    global DEVICE_NAME_FILTER, VERBOSE
+    global DEVICE_NAME_FILTER, VERBOSE, SHOW_DUPLICATES
     DEVICE_NAME_FILTER = device_filter
     VERBOSE = verbose
+    SHOW_DUPLICATES = show_duplicates
 
     # Print header after filter is set
     print_header()